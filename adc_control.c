@@ -0,0 +1,210 @@
+/**
+ * \brief Runtime ADC configuration requests (see adc_control.h).
+ *
+ * A request is a set of fields followed by a pending flag. The CC3200 has a
+ * single in-order core and the acquisition task runs at a higher priority
+ * than the requesting task, so it either sees the flag after the fields are
+ * written or not at all.
+ */
+
+#include "adc_control.h"
+#include "adc_stream.h"
+#include "benchmark.h"
+#include "log_ring.h"
+
+
+
+//****************************************************************************
+//
+// Internal variables
+//
+//****************************************************************************
+
+// Data rate request; written by any task, consumed by the acquisition task
+static volatile uint16_t    requestedOsr;
+static volatile uint16_t    requestedPowerMode;
+static volatile bool        dataRatePending = false;
+
+// Channel enable request; same protocol as the data rate request
+static volatile uint8_t     requestedChannelMask;
+static volatile bool        channelMaskPending = false;
+
+// Synthetic /DRDY rate request; same protocol as the data rate request
+static volatile uint32_t    requestedDrdyRate_Hz;
+static volatile bool        drdyRatePending = false;
+
+
+
+//****************************************************************************
+//
+// Internal function prototypes
+//
+//****************************************************************************
+
+static void publishTiming(void);
+
+
+
+//*****************************************************************************
+//
+//! Publishes the timing of the ADC configuration set up by adcStartup().
+//!
+//! \fn void adcControlInit(void)
+//!
+//! Call from the acquisition task after InitADC(), before the first conversion.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void adcControlInit(void)
+{
+    dataRatePending = false;
+    channelMaskPending = false;
+    drdyRatePending = false;
+    publishTiming();
+}
+
+
+
+//*****************************************************************************
+//
+//! Requests a new oversampling ratio and power mode.
+//!
+//! \fn void adcControlRequestDataRate(uint16_t osr, uint16_t powerMode)
+//!
+//! \param osr oversampling ratio: 128, 256, 512, ... 8192, or 16256.
+//! \param powerMode one of the CLOCK_PWR_* field values.
+//!
+//! The request replaces any request not yet serviced; invalid values are
+//! rejected by setDataRate() when the request is serviced.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void adcControlRequestDataRate(uint16_t osr, uint16_t powerMode)
+{
+    requestedOsr        = osr;
+    requestedPowerMode  = powerMode;
+    dataRatePending     = true;
+}
+
+
+
+//*****************************************************************************
+//
+//! Requests a new set of enabled channels.
+//!
+//! \fn void adcControlRequestChannelMask(uint8_t channelMask)
+//!
+//! \param channelMask has bit n set to enable channel n.
+//!
+//! The request replaces any request not yet serviced; a mask with no channel
+//! or with channels the device does not have is rejected when the request is
+//! serviced.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void adcControlRequestChannelMask(uint8_t channelMask)
+{
+    requestedChannelMask    = channelMask;
+    channelMaskPending      = true;
+}
+
+
+
+//*****************************************************************************
+//
+//! Requests a synthetic /DRDY source, for benchmarking.
+//!
+//! \fn void adcControlRequestDrdyRate(uint32_t rate_Hz)
+//!
+//! \param rate_Hz conversions per second, or 0 to follow the nDRDY pin.
+//!
+//! Servicing the request also restarts the benchmark statistics.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void adcControlRequestDrdyRate(uint32_t rate_Hz)
+{
+    requestedDrdyRate_Hz    = rate_Hz;
+    drdyRatePending         = true;
+}
+
+
+
+//*****************************************************************************
+//
+//! Applies pending requests to the ADC.
+//!
+//! \fn bool adcControlService(void)
+//!
+//! Call from the acquisition task between two conversions.
+//!
+//! \return true if the ADC configuration (and its timing) changed.
+//
+//*****************************************************************************
+bool adcControlService(void)
+{
+    bool changed = false;
+
+    if (dataRatePending)
+    {
+        uint16_t osr = requestedOsr;
+        uint16_t powerMode = requestedPowerMode;
+        dataRatePending = false;
+
+        if (setDataRate(osr, powerMode))
+        {
+            LOG_PRINT("Data rate rejected: OSR %u, power mode %u\r\n", osr, powerMode);
+        }
+
+        // Publish whatever the device ended up with, even if the request failed
+        publishTiming();
+        changed = true;
+    }
+
+    if (channelMaskPending)
+    {
+        uint8_t channelMask = requestedChannelMask;
+        channelMaskPending = false;
+
+        // readData() reports the new mask, which the stream and the scaling follow
+        if ((channelMask != 0) && ((channelMask & ~ALL_CHANNELS_MASK) == 0))
+        {
+            setChannelEnableMask(channelMask);
+            commitRegisters();
+            changed = true;
+        }
+    }
+
+    if (drdyRatePending)
+    {
+        uint32_t rate_Hz = requestedDrdyRate_Hz;
+        drdyRatePending = false;
+
+        if (setSyntheticDRDYrate(rate_Hz))
+        {
+            LOG_PRINT("Synthetic DRDY at %u Hz: no timer available\r\n", rate_Hz);
+        }
+        BENCH_RESET();
+    }
+
+    return changed;
+}
+
+
+
+//*****************************************************************************
+//
+//! Passes the current conversion timing on to the modules that depend on it.
+//
+//*****************************************************************************
+static void publishTiming(void)
+{
+    adc_timing timing;
+    getAdcTiming(&timing);
+
+    streamSetDataRate(timing.dataRate_Hz);
+}
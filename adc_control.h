@@ -0,0 +1,32 @@
+/**
+ * \brief Runtime ADC configuration requests.
+ *
+ * Only the acquisition task talks to the ADC, so other tasks (the websocket
+ * command handler) post requests here and the acquisition task applies them
+ * between two conversions with adcControlService(). Derived settings, such as
+ * the stream batch size, are updated in the same place.
+ */
+
+#ifndef ADC_CONTROL_H_
+#define ADC_CONTROL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ads131m0x.h"
+
+
+//****************************************************************************
+//
+// Function prototypes
+//
+//****************************************************************************
+
+void        adcControlInit(void);
+void        adcControlRequestDataRate(uint16_t osr, uint16_t powerMode);
+void        adcControlRequestChannelMask(uint8_t channelMask);
+void        adcControlRequestDrdyRate(uint32_t rate_Hz);
+bool        adcControlService(void);
+
+
+#endif /* ADC_CONTROL_H_ */
@@ -0,0 +1,1213 @@
+/**
+ * \brief Encoder for the binary sample stream format (see adc_stream.h).
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "adc_stream.h"
+#include "sample_ring.h"
+
+
+
+//****************************************************************************
+//
+// Internal data structures
+//
+//****************************************************************************
+
+typedef struct
+{
+    uint8_t    *dst;                // Next byte to write
+    uint32_t    bits;               // Bits not written yet, in the low count bits
+    uint32_t    count;              // Fewer than 8 between calls
+} bit_writer;
+
+
+
+//****************************************************************************
+//
+// Internal variables
+//
+//****************************************************************************
+
+// Flush policy; written by the command handler, read by the acquisition loop
+static volatile uint16_t    batchRecordsSetting = STREAM_DEFAULT_BATCH_RECORDS;
+static volatile uint32_t    batchLatencySetting = STREAM_DEFAULT_BATCH_LATENCY_MS;
+
+// Flush policy resolved for the data rate and the link
+static volatile uint16_t    batchRecords        = 1;
+static volatile uint32_t    batchLatency_ms     = STREAM_DEFAULT_BATCH_LATENCY_MS;
+
+// Link adaptation; 0 is STREAM_MODE_NORMAL, 1 STREAM_MODE_BATCHED, and each
+// level above that doubles the decimation. Written by the sender task
+static volatile uint8_t     linkLevel           = 0;
+static uint16_t             quietIntervals      = 0;
+
+// Encoding of the packets sent; written by the command handler, read by the sender task
+static volatile uint8_t     encodingSetting     = STREAM_DEFAULT_ENCODING;
+
+// Encoded packet, copied back into the batch; used by the sender task only
+static uint8_t              encodeBuffer[STREAM_MAX_PACKET_BYTES];
+
+// Output data rate of the ADC, for STREAM_BATCH_RECORDS_AUTO
+static volatile uint32_t    streamDataRate_Hz   = 0;
+
+// Nanoseconds per getTimestamp() tick in 16.16 fixed point, 0 until first used
+static uint32_t             nanosecondsPerTick_q16 = 0;
+
+// Loss counters; the first three are written by the acquisition task, sendFailures by the network side
+static volatile uint32_t    missedDrdy          = 0;
+static volatile uint32_t    crcErrors           = 0;
+static volatile uint32_t    sendFailures        = 0;
+
+// Sequence number expected from the next conversion read
+static uint32_t             expectedSequence    = 0;
+static bool                 sequenceTracked     = false;
+
+
+
+//****************************************************************************
+//
+// Internal function prototypes
+//
+//****************************************************************************
+
+static void     updateBatchRecords(void);
+static int32_t  divideRounded(int32_t sum, uint16_t count);
+static uint8_t  countChannels(uint8_t channelMask);
+static uint64_t ticksToNanoseconds(uint64_t ticks);
+static uint8_t *putU16(uint8_t *dst, uint16_t value);
+static uint8_t *putU32(uint8_t *dst, uint32_t value);
+static uint8_t *putU64(uint8_t *dst, uint64_t value);
+static uint8_t *putCode(uint8_t *dst, int32_t code);
+static uint16_t getU16(const uint8_t *src);
+static int32_t  getCode(const uint8_t *src);
+static void     putBits(bit_writer *writer, uint32_t value, uint32_t count);
+static bool     encodeChannel(bit_writer *writer, const uint8_t *codes, uint16_t count, uint16_t stride,
+                              const uint8_t *limit);
+
+
+
+//*****************************************************************************
+//
+//! Sets the batch flush policy.
+//!
+//! \fn void streamSetFlushPolicy(uint16_t maxRecords, uint32_t maxLatency_ms)
+//!
+//! \param maxRecords number of records after which a batch is sent (clamped
+//! to STREAM_MAX_RECORDS), or STREAM_BATCH_RECORDS_AUTO to size batches from
+//! the data rate and maxLatency_ms.
+//! \param maxLatency_ms time after which a partially filled batch is sent.
+//! Zero sends every batch as soon as it has one record.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void streamSetFlushPolicy(uint16_t maxRecords, uint32_t maxLatency_ms)
+{
+    if (maxRecords > STREAM_MAX_RECORDS) { maxRecords = STREAM_MAX_RECORDS; }
+
+    batchRecordsSetting = maxRecords;
+    batchLatencySetting = maxLatency_ms;
+    updateBatchRecords();
+}
+
+
+
+//*****************************************************************************
+//
+//! Tells the stream the output data rate of the ADC.
+//!
+//! \fn void streamSetDataRate(uint32_t dataRate_Hz)
+//!
+//! \param dataRate_Hz conversions per second.
+//!
+//! With STREAM_BATCH_RECORDS_AUTO, a batch holds the conversions of one flush
+//! latency period, so fast rates send full packets and slow rates still meet
+//! the latency.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void streamSetDataRate(uint32_t dataRate_Hz)
+{
+    streamDataRate_Hz = dataRate_Hz;
+    updateBatchRecords();
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the number of records after which a batch is sent (resolved for
+//! STREAM_BATCH_RECORDS_AUTO and the link mode).
+//!
+//! \fn uint16_t streamGetBatchRecords(void)
+//!
+//! \return Records per batch.
+//
+//*****************************************************************************
+uint16_t streamGetBatchRecords(void)
+{
+    return batchRecords;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the time after which a partially filled batch is sent (resolved
+//! for the link mode).
+//!
+//! \fn uint32_t streamGetBatchLatency(void)
+//!
+//! \return Maximum batch latency in milliseconds.
+//
+//*****************************************************************************
+uint32_t streamGetBatchLatency(void)
+{
+    return batchLatency_ms;
+}
+
+
+
+//*****************************************************************************
+//
+//! Steps the link mode down or up from the link statistics of the last
+//! interval. Call once per STREAM_ADAPT_INTERVAL_MS from the sender task.
+//!
+//! \fn bool streamAdaptToLink(const stream_link_stats *link)
+//!
+//! \param link statistics of the data frames sent during the interval.
+//!
+//! A lost frame or a busy link steps down at once: from STREAM_MODE_NORMAL to
+//! STREAM_MODE_BATCHED, then to decimation by 2, 4, ... STREAM_MAX_DECIMATION.
+//! STREAM_LINK_RECOVER_INTERVALS quiet intervals in a row step back up by one.
+//! The batch size and latency follow (see streamGetBatchRecords()).
+//!
+//! \return true if the link mode or decimation changed.
+//
+//*****************************************************************************
+bool streamAdaptToLink(const stream_link_stats *link)
+{
+    uint32_t busyPercent = 0;
+    uint8_t level = linkLevel;
+
+    if (link->interval_us > 0)
+    {
+        busyPercent = (uint32_t) (((uint64_t) link->busy_us * 100u) / link->interval_us);
+    }
+
+    if ((link->lostFrames > 0) || (busyPercent >= STREAM_LINK_BUSY_HIGH_PERCENT))
+    {
+        quietIntervals = 0;
+        if (streamGetDecimation() < STREAM_MAX_DECIMATION) { level++; }
+    }
+    else if (busyPercent < STREAM_LINK_BUSY_LOW_PERCENT)
+    {
+        if ((level > 0) && (++quietIntervals >= STREAM_LINK_RECOVER_INTERVALS))
+        {
+            quietIntervals = 0;
+            level--;
+        }
+    }
+    else
+    {
+        quietIntervals = 0;
+    }
+
+    if (level == linkLevel) { return false; }
+
+    linkLevel = level;
+    updateBatchRecords();
+    return true;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the current link mode.
+//!
+//! \fn uint8_t streamGetMode(void)
+//!
+//! \return STREAM_MODE_NORMAL, STREAM_MODE_BATCHED or STREAM_MODE_DECIMATED.
+//
+//*****************************************************************************
+uint8_t streamGetMode(void)
+{
+    uint8_t level = linkLevel;
+
+    return (level > STREAM_MODE_DECIMATED) ? STREAM_MODE_DECIMATED : level;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the current decimation factor.
+//!
+//! \fn uint8_t streamGetDecimation(void)
+//!
+//! \return Conversions averaged per record: 1 unless STREAM_MODE_DECIMATED.
+//
+//*****************************************************************************
+uint8_t streamGetDecimation(void)
+{
+    uint8_t level = linkLevel;
+
+    return (level < STREAM_MODE_DECIMATED) ? 1u : (uint8_t) (1u << (level - 1u));
+}
+
+
+
+//*****************************************************************************
+//
+//! Sets the encoding of the packets sent.
+//!
+//! \fn void streamSetEncoding(uint8_t encoding)
+//!
+//! \param encoding STREAM_ENCODING_RAW, or STREAM_ENCODING_RICE to compress
+//! the packets that get smaller.
+//!
+//! Takes effect with the next packet sent (see streamBatchEncode()).
+//!
+//! \return None.
+//
+//*****************************************************************************
+void streamSetEncoding(uint8_t encoding)
+{
+    encodingSetting = (encoding == STREAM_ENCODING_RICE) ? STREAM_ENCODING_RICE : STREAM_ENCODING_RAW;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the encoding of the packets sent.
+//!
+//! \fn uint8_t streamGetEncoding(void)
+//!
+//! \return STREAM_ENCODING_RAW or STREAM_ENCODING_RICE.
+//
+//*****************************************************************************
+uint8_t streamGetEncoding(void)
+{
+    return encodingSetting;
+}
+
+
+
+//*****************************************************************************
+//
+//! Empties a decimator.
+//!
+//! \fn void streamDecimatorReset(stream_decimator *decimator)
+//!
+//! \param decimator pointer to the decimator.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void streamDecimatorReset(stream_decimator *decimator)
+{
+    decimator->group.conversions = 0;
+}
+
+
+
+//*****************************************************************************
+//
+//! Checks whether a conversion belongs to the record being formed.
+//!
+//! \fn bool streamDecimatorAccepts(const stream_decimator *decimator, const sample_record *record)
+//!
+//! \param decimator pointer to the decimator.
+//! \param record conversion to add.
+//!
+//! A conversion belongs to the record if it is in the same group of
+//! decimation sequence numbers and has the same channel mask. Otherwise the
+//! record has to be taken first. A new decimation factor applies from the next
+//! group on, so groups always start at multiples of their factor.
+//!
+//! \return true if the conversion can be added.
+//
+//*****************************************************************************
+bool streamDecimatorAccepts(const stream_decimator *decimator, const sample_record *record)
+{
+    const stream_record *group = &decimator->group;
+    uint32_t groupMask = ~((uint32_t) group->decimation - 1u);
+
+    if (group->conversions == 0)                                        { return true; }
+    if (record->data.channelMask != group->data.channelMask)            { return false; }
+
+    return ((record->sequence & groupMask) == (group->sequence & groupMask));
+}
+
+
+
+//*****************************************************************************
+//
+//! Adds a conversion to the record being formed.
+//!
+//! \fn void streamDecimatorAdd(stream_decimator *decimator, const sample_record *record)
+//!
+//! \param decimator pointer to the decimator.
+//! \param record conversion to add.
+//!
+//! NOTE: The caller must check streamDecimatorAccepts() first.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void streamDecimatorAdd(stream_decimator *decimator, const sample_record *record)
+{
+    stream_record *group = &decimator->group;
+    uint8_t channel;
+
+    assert(streamDecimatorAccepts(decimator, record));
+
+    if (group->conversions == 0)
+    {
+        group->timestamp        = record->timestamp;
+        group->sequence         = record->sequence;
+        group->mode             = streamGetMode();
+        group->decimation       = streamGetDecimation();
+        group->data.channelMask = record->data.channelMask;
+        group->data.crc         = 0;
+        for (channel = 0; channel < CHANNEL_COUNT; channel++)
+        {
+            decimator->sum[channel] = 0;
+        }
+    }
+
+    // 24-bit codes: the sum of STREAM_MAX_DECIMATION of them fits in 32 bits
+    for (channel = 0; channel < CHANNEL_COUNT; channel++)
+    {
+        decimator->sum[channel] += record->data.channel[channel];
+    }
+    group->data.response = record->data.response;
+    group->conversions++;
+    decimator->lastSequence = record->sequence;
+}
+
+
+
+//*****************************************************************************
+//
+//! Checks whether the record being formed has reached the end of its group.
+//!
+//! \fn bool streamDecimatorComplete(const stream_decimator *decimator)
+//!
+//! \param decimator pointer to the decimator.
+//!
+//! \return true if the record can be taken without waiting for the next
+//! conversion.
+//
+//*****************************************************************************
+bool streamDecimatorComplete(const stream_decimator *decimator)
+{
+    const stream_record *group = &decimator->group;
+
+    if (group->conversions == 0) { return false; }
+
+    return (((decimator->lastSequence + 1u) & (group->decimation - 1u)) == 0);
+}
+
+
+
+//*****************************************************************************
+//
+//! Takes the record formed so far and empties the decimator.
+//!
+//! \fn bool streamDecimatorTake(stream_decimator *decimator, stream_record *record)
+//!
+//! \param decimator pointer to the decimator.
+//! \param record receives the average of the conversions added.
+//!
+//! \return true if a record was taken, false if the decimator was empty.
+//
+//*****************************************************************************
+bool streamDecimatorTake(stream_decimator *decimator, stream_record *record)
+{
+    stream_record *group = &decimator->group;
+    uint8_t channel;
+
+    if (group->conversions == 0) { return false; }
+
+    *record = *group;
+    for (channel = 0; channel < CHANNEL_COUNT; channel++)
+    {
+        record->data.channel[channel] = divideRounded(decimator->sum[channel], group->conversions);
+    }
+
+    group->conversions = 0;
+    return true;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the sequence number of a record of a packet.
+//!
+//! \fn uint32_t streamRecordSequence(uint32_t firstSequence, uint16_t index, uint8_t decimation)
+//!
+//! \param firstSequence sequence number of the first record of the packet.
+//! \param index index of the record in the packet; the record count gives
+//! the sequence number expected at the start of the next packet.
+//! \param decimation decimation factor of the packet.
+//!
+//! \return The sequence number of the first conversion the record averages.
+//
+//*****************************************************************************
+uint32_t streamRecordSequence(uint32_t firstSequence, uint16_t index, uint8_t decimation)
+{
+    if (index == 0) { return firstSequence; }
+
+    // Only the first record can start within its group
+    return (firstSequence & ~((uint32_t) decimation - 1u)) + ((uint32_t) index * decimation);
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the size of a packet from its header, for clients that read the
+//! stream from a byte stream such as a TCP connection (see tcp_stream.h).
+//!
+//! \fn uint16_t streamPacketBytes(const uint8_t *header)
+//!
+//! \param header the first STREAM_HEADER_BYTES bytes of the packet.
+//!
+//! \return Size of the packet including its header, or 0 if the header is
+//! not that of a STREAM_VERSION packet.
+//
+//*****************************************************************************
+uint16_t streamPacketBytes(const uint8_t *header)
+{
+    uint16_t count = getU16(&header[2]);
+    uint16_t bytes = getU16(&header[24]);
+
+    if ((header[0] != STREAM_VERSION) || (header[1] == 0) || (count == 0)) { return 0; }
+    if ((bytes <= STREAM_HEADER_BYTES) || (bytes > STREAM_MAX_PACKET_BYTES)) { return 0; }
+
+    switch (header[22])
+    {
+        case STREAM_ENCODING_RAW:
+            if (bytes != (STREAM_HEADER_BYTES + ((uint32_t) count * STREAM_RECORD_BYTES(countChannels(header[1])))))
+            {
+                return 0;
+            }
+            return bytes;
+
+        case STREAM_ENCODING_RICE:
+            return bytes;
+
+        default:
+            return 0;
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Compresses a raw packet (see STREAM_ENCODING_RICE in adc_stream.h).
+//!
+//! \fn uint16_t streamEncodePacket(const uint8_t *packet, uint8_t *encoded)
+//!
+//! \param packet STREAM_ENCODING_RAW packet.
+//! \param encoded destination of the compressed packet, header included;
+//! STREAM_MAX_PACKET_BYTES long.
+//!
+//! Each channel gets the fixed predictor of order 0, 1 or 2 whose residuals
+//! add up to the least, and the Rice parameter that suits their mean. Two
+//! passes over the codes of a channel, of a few operations per code each,
+//! make this cheap enough for the sender task at full data rate.
+//!
+//! \return Size of the compressed packet, or 0 if it would not be smaller
+//! than the raw one, whose size is then the limit of what was written.
+//
+//*****************************************************************************
+uint16_t streamEncodePacket(const uint8_t *packet, uint8_t *encoded)
+{
+    uint16_t rawBytes = streamPacketBytes(packet);
+    uint16_t count = getU16(&packet[2]);
+    uint8_t channelMask = packet[1];
+    uint16_t recordBytes;
+    uint16_t status;
+    uint16_t bytes;
+    uint16_t i;
+    uint8_t channel;
+    const uint8_t *limit;
+    const uint8_t *codes;
+    bit_writer writer;
+
+    if ((rawBytes == 0) || (packet[22] != STREAM_ENCODING_RAW)) { return 0; }
+
+    recordBytes = STREAM_RECORD_BYTES(countChannels(channelMask));
+    writer.dst = &encoded[STREAM_HEADER_BYTES];
+    writer.bits = 0;
+    writer.count = 0;
+
+    // Give up once the output is no smaller than the packet; a code writes at most 7 bytes
+    limit = &encoded[rawBytes - 8];
+
+    // Status words rarely change within a packet
+    status = getU16(&packet[STREAM_HEADER_BYTES]);
+    putBits(&writer, status, 16);
+    for (i = 1; (i < count) && (writer.dst <= limit); i++)
+    {
+        uint16_t next = getU16(&packet[STREAM_HEADER_BYTES + (i * recordBytes)]);
+
+        if (next == status)
+        {
+            putBits(&writer, 0, 1);
+        }
+        else
+        {
+            putBits(&writer, 0x10000u | next, 17);
+            status = next;
+        }
+    }
+
+    codes = &packet[STREAM_HEADER_BYTES + 2];
+    for (channel = 0; channel < CHANNEL_COUNT; channel++)
+    {
+        if (!(channelMask & (1u << channel))) { continue; }
+
+        if (writer.dst > limit) { return 0; }
+        if (!encodeChannel(&writer, codes, count, recordBytes, limit)) { return 0; }
+        codes += STREAM_CODE_BYTES;
+    }
+    if (writer.count > 0)
+    {
+        putBits(&writer, 0, 8u - writer.count);
+    }
+
+    bytes = (uint16_t) (writer.dst - encoded);
+    if (bytes >= rawBytes) { return 0; }
+
+    memcpy(encoded, packet, STREAM_HEADER_BYTES);
+    encoded[22] = STREAM_ENCODING_RICE;
+    putU16(&encoded[24], bytes);
+    return bytes;
+}
+
+
+
+//*****************************************************************************
+//
+//! Empties a batch.
+//!
+//! \fn void streamBatchReset(stream_batch *batch)
+//!
+//! \param batch pointer to the batch.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void streamBatchReset(stream_batch *batch)
+{
+    batch->length       = STREAM_HEADER_BYTES;
+    batch->count        = 0;
+    batch->conversions  = 0;
+    batch->encoding     = STREAM_ENCODING_RAW;
+}
+
+
+
+//*****************************************************************************
+//
+//! Checks whether a record can be appended to a batch.
+//!
+//! \fn bool streamBatchAccepts(const stream_batch *batch, const stream_record *record)
+//!
+//! \param batch pointer to the batch.
+//! \param record record to append (see streamDecimatorTake()).
+//!
+//! Records in a packet must have sequence numbers one decimation factor
+//! apart, the same channel mask, link mode and decimation, and span less than
+//! 2^32 ns. If a conversion was lost or any of these changed, the batch has
+//! to be flushed before the next record is added.
+//!
+//! \return true if the record can be appended.
+//
+//*****************************************************************************
+bool streamBatchAccepts(const stream_batch *batch, const stream_record *record)
+{
+    if (batch->count == 0)                                                  { return true; }
+    if (batch->encoding != STREAM_ENCODING_RAW)                             { return false; }
+    if (record->data.channelMask != batch->channelMask)                     { return false; }
+    if ((record->mode != batch->mode) || (record->decimation != batch->decimation)) { return false; }
+    if ((batch->length + batch->recordBytes) > STREAM_MAX_PACKET_BYTES)     { return false; }
+    if ((record->timestamp < batch->firstTimestamp) ||
+        (ticksToNanoseconds(record->timestamp - batch->firstTimestamp) > UINT32_MAX))  { return false; }
+
+    return (record->sequence == streamRecordSequence(batch->firstSequence, batch->count, batch->decimation));
+}
+
+
+
+//*****************************************************************************
+//
+//! Appends a record to a batch.
+//!
+//! \fn void streamBatchAdd(stream_batch *batch, const stream_record *record, uint32_t now_ms)
+//!
+//! \param batch pointer to the batch.
+//! \param record record to append (see streamDecimatorTake()).
+//! \param now_ms current time in milliseconds.
+//!
+//! NOTE: The caller must check streamBatchAccepts() first.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void streamBatchAdd(stream_batch *batch, const stream_record *record, uint32_t now_ms)
+{
+    const adc_channel_data *sample = &record->data;
+
+    assert(streamBatchAccepts(batch, record));
+
+    if (batch->count == 0)
+    {
+        batch->firstSequence    = record->sequence;
+        batch->firstTimestamp   = record->timestamp;
+        batch->startTime_ms     = now_ms;
+        batch->channelMask      = sample->channelMask;
+        batch->mode             = record->mode;
+        batch->decimation       = record->decimation;
+        batch->recordBytes      = STREAM_RECORD_BYTES(countChannels(sample->channelMask));
+    }
+
+    uint8_t *dst = &batch->buffer[batch->length];
+
+    dst = putU16(dst, sample->response);
+    uint8_t channel;
+    for (channel = 0; channel < CHANNEL_COUNT; channel++)
+    {
+        if (batch->channelMask & (1u << channel))
+        {
+            dst = putCode(dst, sample->channel[channel]);
+        }
+    }
+
+    batch->count++;
+    batch->conversions += record->conversions;
+    batch->length = (uint16_t) (dst - batch->buffer);
+
+    // Keep the header current, so the buffer can be sent at any time
+    dst = batch->buffer;
+    *dst++ = STREAM_VERSION;
+    *dst++ = batch->channelMask;
+    dst = putU16(dst, batch->count);
+    dst = putU32(dst, batch->firstSequence);
+    if (batch->count == 1)
+    {
+        dst = putU64(dst, ticksToNanoseconds(batch->firstTimestamp));
+    }
+    else
+    {
+        dst += 8;
+    }
+    dst = putU32(dst, (uint32_t) ticksToNanoseconds(record->timestamp - batch->firstTimestamp));
+    *dst++ = batch->mode;
+    *dst++ = batch->decimation;
+    *dst++ = STREAM_ENCODING_RAW;
+    *dst++ = 0;
+    dst = putU16(dst, batch->length);
+}
+
+
+
+//*****************************************************************************
+//
+//! Checks whether a batch should be sent according to the flush policy.
+//!
+//! \fn bool streamBatchFlushDue(const stream_batch *batch, uint32_t now_ms)
+//!
+//! \param batch pointer to the batch.
+//! \param now_ms current time in milliseconds.
+//!
+//! \return true if the batch is non-empty and full or old enough.
+//
+//*****************************************************************************
+bool streamBatchFlushDue(const stream_batch *batch, uint32_t now_ms)
+{
+    if (batch->count == 0)                                                  { return false; }
+    if (batch->count >= batchRecords)                                       { return true; }
+    if ((batch->length + batch->recordBytes) > STREAM_MAX_PACKET_BYTES)     { return true; }
+
+    return ((uint32_t) (now_ms - batch->startTime_ms) >= batchLatency_ms);
+}
+
+
+
+//*****************************************************************************
+//
+//! Encodes a batch about to be sent as set by streamSetEncoding().
+//!
+//! \fn void streamBatchEncode(stream_batch *batch)
+//!
+//! \param batch pointer to the batch; its buffer and length then hold the
+//! packet to send. No record can be added afterwards.
+//!
+//! NOTE: Uses a static buffer; call from the sender task only.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void streamBatchEncode(stream_batch *batch)
+{
+    uint16_t bytes;
+
+    if ((batch->count == 0) || (batch->encoding != STREAM_ENCODING_RAW)) { return; }
+    if (encodingSetting != STREAM_ENCODING_RICE) { return; }
+
+    bytes = streamEncodePacket(batch->buffer, encodeBuffer);
+    if (bytes == 0) { return; }
+
+    memcpy(batch->buffer, encodeBuffer, bytes);
+    batch->length = bytes;
+    batch->encoding = STREAM_ENCODING_RICE;
+}
+
+
+
+//*****************************************************************************
+//
+//! Counts the conversions skipped before a conversion read.
+//!
+//! \fn void streamTrackSequence(uint32_t sequence)
+//!
+//! \param sequence sequence number of the conversion read (see getDRDYtime()).
+//!
+//! Call from the acquisition task for every conversion read, including those
+//! with CRC errors. Skipped sequence numbers are /DRDY interrupts the task
+//! was too late for.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void streamTrackSequence(uint32_t sequence)
+{
+    if (sequenceTracked && ((int32_t) (sequence - expectedSequence) > 0))
+    {
+        missedDrdy += sequence - expectedSequence;
+    }
+    expectedSequence    = sequence + 1;
+    sequenceTracked     = true;
+}
+
+
+
+//*****************************************************************************
+//
+//! Counts a conversion discarded for a CRC error.
+//!
+//! \fn void streamCountCrcError(void)
+//!
+//! \return None.
+//
+//*****************************************************************************
+void streamCountCrcError(void)
+{
+    crcErrors++;
+}
+
+
+
+//*****************************************************************************
+//
+//! Counts the conversions of a packet the network did not accept, or that a
+//! client did not get because its queue was full.
+//!
+//! \fn void streamCountSendFailure(uint32_t conversions)
+//!
+//! \param conversions number of conversions in the packet, averaged ones included.
+//!
+//! NOTE: Not atomic; callers in different tasks must serialize their calls.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void streamCountSendFailure(uint32_t conversions)
+{
+    sendFailures += conversions;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the conversions lost at each stage since start-up.
+//!
+//! \fn void streamGetLossStats(stream_loss_stats *stats)
+//!
+//! \param stats pointer to the statistics to fill.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void streamGetLossStats(stream_loss_stats *stats)
+{
+    sample_ring_stats ringStats;
+
+    sampleRingGetStats(&ringStats);
+
+    stats->missedDrdy       = missedDrdy;
+    stats->crcErrors        = crcErrors;
+    stats->ringOverflows    = ringStats.overflows;
+    stats->sendFailures     = sendFailures;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the conversions lost at all stages.
+//!
+//! \fn uint32_t streamLossTotal(const stream_loss_stats *stats)
+//!
+//! \param stats statistics filled by streamGetLossStats().
+//!
+//! \return Sum of the loss counters; a client that saw every packet counts
+//! the same number of skipped sequence numbers.
+//
+//*****************************************************************************
+uint32_t streamLossTotal(const stream_loss_stats *stats)
+{
+    return stats->missedDrdy + stats->crcErrors + stats->ringOverflows + stats->sendFailures;
+}
+
+
+
+//*****************************************************************************
+//
+//! Formats the loss counters as the text frame sent to clients.
+//!
+//! \fn uint16_t streamFormatLossReport(const stream_loss_stats *stats, char *buffer, uint16_t size)
+//!
+//! \param stats statistics filled by streamGetLossStats().
+//! \param buffer destination of the null-terminated line, without line ending.
+//! \param size size of buffer; STREAM_LOSS_REPORT_BYTES holds any report.
+//!
+//! \return Length of the line.
+//
+//*****************************************************************************
+uint16_t streamFormatLossReport(const stream_loss_stats *stats, char *buffer, uint16_t size)
+{
+    int length = snprintf(buffer, size, "loss: drdy %lu, crc %lu, ring %lu, send %lu",
+                          (unsigned long) stats->missedDrdy, (unsigned long) stats->crcErrors,
+                          (unsigned long) stats->ringOverflows, (unsigned long) stats->sendFailures);
+
+    if (length < 0)     { length = 0; }
+    if (length >= size) { length = size - 1; }
+    return (uint16_t) length;
+}
+
+
+
+//****************************************************************************
+//
+// Internal functions
+//
+//****************************************************************************
+
+
+//*****************************************************************************
+//
+//! Resolves the number of records per batch from the flush policy.
+//
+//*****************************************************************************
+static void updateBatchRecords(void)
+{
+    uint32_t records = batchRecordsSetting;
+    uint32_t latency = batchLatencySetting;
+
+    // A degraded link gets fewer, larger packets of the decimated records
+    if ((linkLevel > STREAM_MODE_NORMAL) && (latency < STREAM_BATCHED_LATENCY_MS))
+    {
+        latency = STREAM_BATCHED_LATENCY_MS;
+    }
+    if ((records == STREAM_BATCH_RECORDS_AUTO) || (linkLevel > STREAM_MODE_NORMAL))
+    {
+        uint32_t automatic = (uint32_t) (((uint64_t) (streamDataRate_Hz / streamGetDecimation()) * latency) / 1000u);
+
+        if (automatic > records) { records = automatic; }
+    }
+
+    if (records < 1)                  { records = 1; }
+    if (records > STREAM_MAX_RECORDS) { records = STREAM_MAX_RECORDS; }
+
+    batchRecords    = (uint16_t) records;
+    batchLatency_ms = latency;
+}
+
+
+
+//*****************************************************************************
+//
+//! Divides a sum of codes by their number, rounding half away from zero.
+//
+//*****************************************************************************
+static int32_t divideRounded(int32_t sum, uint16_t count)
+{
+    int32_t half = (int32_t) (count / 2u);
+
+    return ((sum < 0) ? (sum - half) : (sum + half)) / (int32_t) count;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the number of channels set in a channel mask.
+//
+//*****************************************************************************
+static uint8_t countChannels(uint8_t channelMask)
+{
+    uint8_t channels = 0;
+
+    while (channelMask)
+    {
+        channelMask &= (uint8_t) (channelMask - 1);
+        channels++;
+    }
+    return channels;
+}
+
+
+
+//*****************************************************************************
+//
+//! Converts getTimestamp() ticks to nanoseconds.
+//
+//*****************************************************************************
+static uint64_t ticksToNanoseconds(uint64_t ticks)
+{
+    if (nanosecondsPerTick_q16 == 0)
+    {
+        nanosecondsPerTick_q16 = (uint32_t) ((1000000000ull << 16) / getTimestampFrequency());
+    }
+
+    // Split so that neither product overflows for any time that fits in 64 bits of nanoseconds
+    return ((ticks >> 16) * nanosecondsPerTick_q16) + (((ticks & 0xFFFF) * nanosecondsPerTick_q16) >> 16);
+}
+
+
+
+//*****************************************************************************
+//
+//! Writes a 16-bit value in little-endian byte order.
+//!
+//! \return Pointer to the byte following the value.
+//
+//*****************************************************************************
+static uint8_t *putU16(uint8_t *dst, uint16_t value)
+{
+    dst[0] = (uint8_t) (value >> 0);
+    dst[1] = (uint8_t) (value >> 8);
+    return dst + 2;
+}
+
+
+
+//*****************************************************************************
+//
+//! Writes a 32-bit value in little-endian byte order.
+//!
+//! \return Pointer to the byte following the value.
+//
+//*****************************************************************************
+static uint8_t *putU32(uint8_t *dst, uint32_t value)
+{
+    dst[0] = (uint8_t) (value >> 0);
+    dst[1] = (uint8_t) (value >> 8);
+    dst[2] = (uint8_t) (value >> 16);
+    dst[3] = (uint8_t) (value >> 24);
+    return dst + 4;
+}
+
+
+
+//*****************************************************************************
+//
+//! Writes a 64-bit value in little-endian byte order.
+//!
+//! \return Pointer to the byte following the value.
+//
+//*****************************************************************************
+static uint8_t *putU64(uint8_t *dst, uint64_t value)
+{
+    dst = putU32(dst, (uint32_t) value);
+    return putU32(dst, (uint32_t) (value >> 32));
+}
+
+
+
+//*****************************************************************************
+//
+//! Writes the low 24 bits of a sign-extended ADC code in little-endian order.
+//!
+//! \return Pointer to the byte following the code.
+//
+//*****************************************************************************
+static uint8_t *putCode(uint8_t *dst, int32_t code)
+{
+    dst[0] = (uint8_t) (code >> 0);
+    dst[1] = (uint8_t) (code >> 8);
+    dst[2] = (uint8_t) (code >> 16);
+    return dst + 3;
+}
+
+
+
+//*****************************************************************************
+//
+//! Reads a 16-bit little-endian value.
+//
+//*****************************************************************************
+static uint16_t getU16(const uint8_t *src)
+{
+    return (uint16_t) (src[0] | (src[1] << 8));
+}
+
+
+
+//*****************************************************************************
+//
+//! Reads a 24-bit little-endian code and sign-extends it.
+//
+//*****************************************************************************
+static int32_t getCode(const uint8_t *src)
+{
+    uint32_t code = (uint32_t) src[0] | ((uint32_t) src[1] << 8) | ((uint32_t) src[2] << 16);
+
+    return ((int32_t) (code << 8)) >> 8;
+}
+
+
+
+//*****************************************************************************
+//
+//! Appends the low count bits of value, count at most 24, to a bit stream
+//! and writes out the bytes completed.
+//
+//*****************************************************************************
+static void putBits(bit_writer *writer, uint32_t value, uint32_t count)
+{
+    writer->bits = (writer->bits << count) | (value & ((1u << count) - 1u));
+    writer->count += count;
+
+    while (writer->count >= 8)
+    {
+        writer->count -= 8;
+        *writer->dst++ = (uint8_t) (writer->bits >> writer->count);
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Writes the codes of one channel of a raw packet as predictor order, Rice
+//! parameter, warm-up codes and Rice-coded residuals.
+//!
+//! \return false if the output went past limit.
+//
+//*****************************************************************************
+static bool encodeChannel(bit_writer *writer, const uint8_t *codes, uint16_t count, uint16_t stride,
+                          const uint8_t *limit)
+{
+    uint64_t sum[STREAM_RICE_MAX_ORDER + 1] = { 0, 0, 0 };
+    uint32_t mean;
+    int32_t x;
+    int32_t x1 = 0;
+    int32_t x2 = 0;
+    int32_t residual;
+    uint32_t folded;
+    uint32_t quotient;
+    uint8_t order;
+    uint8_t parameter;
+    uint16_t i;
+
+    // Magnitudes of the residuals of every order from the third code on, as FLAC's
+    // fixed predictors compare them
+    for (i = 0; i < count; i++)
+    {
+        x = getCode(&codes[i * stride]);
+        if (i >= STREAM_RICE_MAX_ORDER)
+        {
+            sum[0] += (uint32_t) ((x < 0) ? -x : x);
+            residual = x - x1;
+            sum[1] += (uint32_t) ((residual < 0) ? -residual : residual);
+            residual = x - (2 * x1) + x2;
+            sum[2] += (uint32_t) ((residual < 0) ? -residual : residual);
+        }
+        x2 = x1;
+        x1 = x;
+    }
+
+    if (count <= STREAM_RICE_MAX_ORDER)
+    {
+        // Too short to compare: the code, or one warm-up code and a difference
+        order = (uint8_t) (count - 1u);
+        residual = (count > 1) ? (getCode(&codes[stride]) - getCode(codes)) : getCode(codes);
+        mean = (uint32_t) ((residual < 0) ? -residual : residual);
+    }
+    else
+    {
+        order = 0;
+        if (sum[1] < sum[order]) { order = 1; }
+        if (sum[2] < sum[order]) { order = 2; }
+        mean = (uint32_t) (sum[order] / (uint32_t) (count - STREAM_RICE_MAX_ORDER));
+    }
+
+    // The folded residuals average twice the magnitude, which Rice codes best
+    // with about that many low bits
+    parameter = 0;
+    while ((parameter < STREAM_RICE_MAX_PARAMETER) && ((mean >> parameter) != 0)) { parameter++; }
+
+    putBits(writer, order, 2);
+    putBits(writer, parameter, 5);
+
+    x1 = 0;
+    x2 = 0;
+    for (i = 0; i < count; i++)
+    {
+        x = getCode(&codes[i * stride]);
+
+        if (i < order)
+        {
+            putBits(writer, (uint32_t) x, 24);
+        }
+        else
+        {
+            residual = (order == 0) ? x : ((order == 1) ? (x - x1) : (x - (2 * x1) + x2));
+            folded = ((uint32_t) residual << 1) ^ (uint32_t) (residual >> 31);
+            quotient = folded >> parameter;
+
+            if (quotient < STREAM_RICE_ESCAPE_QUOTIENT)
+            {
+                putBits(writer, (2u << quotient) - 2u, quotient + 1u);
+                putBits(writer, folded, parameter);
+            }
+            else
+            {
+                putBits(writer, (1u << STREAM_RICE_ESCAPE_QUOTIENT) - 1u, STREAM_RICE_ESCAPE_QUOTIENT);
+                putBits(writer, folded >> (STREAM_RICE_ESCAPE_BITS / 2), STREAM_RICE_ESCAPE_BITS / 2);
+                putBits(writer, folded, STREAM_RICE_ESCAPE_BITS / 2);
+            }
+        }
+        x2 = x1;
+        x1 = x;
+
+        if (writer->dst > limit) { return false; }
+    }
+    return true;
+}
@@ -0,0 +1,274 @@
+/**
+ * \brief Binary sample stream format used to send ADS131M0x conversions to clients.
+ *
+ * All multi-byte fields are little-endian. A packet is a fixed header followed
+ * by one record per conversion, as laid out below (STREAM_ENCODING_RAW) or
+ * compressed (STREAM_ENCODING_RICE):
+ *
+ * -----------------------------------------------------------------------------
+ * | Offset | Size | Field                                                      |
+ * -----------------------------------------------------------------------------
+ * |   0    |  1   | Format version (STREAM_VERSION)                            |
+ * |   1    |  1   | Channel mask: bit n set if channel n is in the records     |
+ * |   2    |  2   | Number of records in this packet (N)                       |
+ * |   4    |  4   | Sequence number of the first record                        |
+ * |   8    |  8   | Timestamp of the first record in nanoseconds               |
+ * |  16    |  4   | Nanoseconds from the first to the last record              |
+ * |  20    |  1   | Link mode (STREAM_MODE_*)                                  |
+ * |  21    |  1   | Decimation D: conversions averaged per record, 1 to        |
+ * |        |      | STREAM_MAX_DECIMATION                                      |
+ * |  22    |  1   | Encoding of the records (STREAM_ENCODING_*)                |
+ * |  23    |  1   | Reserved, 0                                                |
+ * |  24    |  2   | Size of the packet in bytes, header included               |
+ * -----------------------------------------------------------------------------
+ * |  26    |  2   | Record 0: response (STATUS) word                           |
+ * |  28    | 3*C  | Record 0: codes of the C channels in the mask, lowest      |
+ * |        |      | channel first, 24-bit two's complement                     |
+ * |  ...   |      | Records 1..N-1, same layout                                |
+ * -----------------------------------------------------------------------------
+ *
+ * A STREAM_ENCODING_RICE packet has the same header and carries the same
+ * records losslessly in fewer bytes, as a bit stream written from the most
+ * significant bit of each byte on and padded with zeros to a whole byte:
+ *
+ *  - The status words: 16 bits for record 0, then for each further record a
+ *    0 bit if its status word is that of the record before, or a 1 bit and
+ *    the 16-bit word.
+ *  - Each channel in the mask, lowest first:
+ *      2 bits   predictor order P, 0 to STREAM_RICE_MAX_ORDER
+ *      5 bits   Rice parameter K, 0 to STREAM_RICE_MAX_PARAMETER
+ *      24 bits  code of each of the first P records, two's complement
+ *      then the residual of each further record: its code minus the
+ *      prediction from the records before, 0 for P = 0, x[i-1] for P = 1 and
+ *      2 * x[i-1] - x[i-2] for P = 2. A residual e is mapped to
+ *      u = 2e for e >= 0 and u = -2e - 1 otherwise, and u is written as
+ *      q = u >> K one bits, a zero bit and the low K bits of u. If q is
+ *      STREAM_RICE_ESCAPE_QUOTIENT or more, STREAM_RICE_ESCAPE_QUOTIENT one
+ *      bits and u in STREAM_RICE_ESCAPE_BITS bits are written instead.
+ *
+ * The encoder picks P and K per channel and per packet, from the sums of the
+ * residuals of each order (see streamEncodePacket()). A packet is sent raw
+ * when compression would not make it smaller.
+ *
+ * Sequence numbers are assigned by the /DRDY interrupt and increase by one
+ * per conversion, so a client can detect missing records by comparing the
+ * sequence of consecutive packets, wherever they were lost. Records within
+ * one packet always have the same channel mask; disabled channels are left
+ * out rather than sent as zeros. Record i > 0 of a packet whose first record
+ * has sequence number S averages the D conversions from (S & ~(D - 1)) + i * D
+ * on (see streamRecordSequence()), and the next packet is expected to start at
+ * (S & ~(D - 1)) + N * D.
+ *
+ * Over a websocket, each packet is one binary frame. Over a raw TCP
+ * connection (see tcp_stream.h), packets follow each other without framing,
+ * and a client finds the size of each one from its header with
+ * streamPacketBytes(). Over UDP (see udp_stream.h), each packet is one
+ * datagram.
+ *
+ * The firmware counts losses per stage (stream_loss_stats) and sends them to
+ * the clients as a text frame, "loss: drdy <n>, crc <n>, ring <n>, send <n>",
+ * whenever they change (see streamFormatLossReport()). With several clients
+ * connected, "send" adds up the conversions each of them missed.
+ *
+ * Timestamps are the times of the /DRDY interrupts, from a free-running
+ * device timer (see getDRDYtime()), since the device started. Conversions are
+ * evenly spaced by the ADC clock, so record i of N is stamped
+ * first + (span * i) / (N - 1); only the first and last timestamps are sent.
+ *
+ * Conversions are aggregated into packets by a stream_batch. A batch is
+ * flushed when it holds the configured number of records, or when its oldest
+ * record has waited for the configured latency, whichever comes first.
+ *
+ * The stream adapts to the capacity of the link (see streamAdaptToLink()).
+ * When the network falls behind, it first sends fewer, larger packets
+ * (STREAM_MODE_BATCHED), then averages D = 2, 4, ... conversions into each
+ * record (STREAM_MODE_DECIMATED), so that clients get a continuous stream at
+ * a lower rate instead of one with holes. A decimated record is stamped with
+ * the sequence number and time of the first conversion it averages. Groups of
+ * D start at sequence numbers that are multiples of D, and a new D applies
+ * from the next group on, so only the first record of a packet can start
+ * within its group, after lost conversions. Conversions lost after the start
+ * of a group are not visible to clients: the record averages the others.
+ * The stream steps back up once the link has been idle enough for a while.
+ */
+
+#ifndef ADC_STREAM_H_
+#define ADC_STREAM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ads131m0x.h"
+#include "sample_ring.h"
+
+
+//****************************************************************************
+//
+// Constants
+//
+//****************************************************************************
+
+#define STREAM_VERSION                  ((uint8_t) 5)
+
+#define STREAM_HEADER_BYTES             ((uint16_t) 26)
+#define STREAM_CODE_BYTES               ((uint16_t) 3)
+#define STREAM_RECORD_BYTES(channels)   ((uint16_t) (2 + ((channels) * STREAM_CODE_BYTES)))
+
+/* Largest packet handed to the network in one send. A packet holds up to
+ * STREAM_MAX_RECORDS records with one channel enabled, fewer with more.
+ * Without a cast, so that the transports can check it with #if.
+ */
+#define STREAM_MAX_PACKET_BYTES         (1024U)
+#define STREAM_MAX_RECORDS              ((uint16_t) ((STREAM_MAX_PACKET_BYTES - STREAM_HEADER_BYTES) / STREAM_RECORD_BYTES(1)))
+
+/* Batch size that sends one batch per flush latency at the current data rate
+ * (see streamSetDataRate()) */
+#define STREAM_BATCH_RECORDS_AUTO       ((uint16_t) 0)
+
+/* Default flush policy */
+#define STREAM_DEFAULT_BATCH_RECORDS    (STREAM_BATCH_RECORDS_AUTO)
+#define STREAM_DEFAULT_BATCH_LATENCY_MS ((uint32_t) 20)
+
+/* Link modes, from the best link to the worst */
+#define STREAM_MODE_NORMAL              ((uint8_t) 0)   // Batches as set by the flush policy
+#define STREAM_MODE_BATCHED             ((uint8_t) 1)   // Batches of at least STREAM_BATCHED_LATENCY_MS
+#define STREAM_MODE_DECIMATED           ((uint8_t) 2)   // Larger batches of averaged conversions
+
+/* Encodings of the records (header byte 22) */
+#define STREAM_ENCODING_RAW             ((uint8_t) 0)   // Status words and 24-bit codes
+#define STREAM_ENCODING_RICE            ((uint8_t) 1)   // Predicted per channel and Rice coded
+
+/* Encoding of the packets sent when the "encoding" command was not used */
+#define STREAM_DEFAULT_ENCODING         (STREAM_ENCODING_RAW)
+
+/* Rice coding: highest predictor order and parameter, and escape for
+ * residuals far off the prediction */
+#define STREAM_RICE_MAX_ORDER           ((uint8_t) 2)
+#define STREAM_RICE_MAX_PARAMETER       ((uint8_t) 24)
+#define STREAM_RICE_ESCAPE_QUOTIENT     ((uint8_t) 16)
+#define STREAM_RICE_ESCAPE_BITS         ((uint8_t) 26)
+
+/* Largest decimation factor; a power of two */
+#define STREAM_MAX_DECIMATION           ((uint8_t) 16)
+
+/* Shortest flush latency when the link is degraded */
+#define STREAM_BATCHED_LATENCY_MS       ((uint32_t) 100)
+
+/* Link adaptation: the link is evaluated once per STREAM_ADAPT_INTERVAL_MS.
+ * The stream steps down when a data frame was lost or the busiest client
+ * spent STREAM_LINK_BUSY_HIGH_PERCENT of the interval sending, and steps up
+ * after STREAM_LINK_RECOVER_INTERVALS intervals in a row below
+ * STREAM_LINK_BUSY_LOW_PERCENT. Stepping up at most doubles the traffic, so
+ * the low mark is below half the high one. */
+#define STREAM_ADAPT_INTERVAL_MS        ((uint32_t) 500)
+#define STREAM_LINK_BUSY_HIGH_PERCENT   ((uint32_t) 75)
+#define STREAM_LINK_BUSY_LOW_PERCENT    ((uint32_t) 30)
+#define STREAM_LINK_RECOVER_INTERVALS   ((uint16_t) 4)
+
+/* Longest line written by streamFormatLossReport(), including the terminator */
+#define STREAM_LOSS_REPORT_BYTES        ((uint16_t) 96)
+
+/* WebSocket frame opcodes */
+#define STREAM_WS_OPCODE_TEXT           ((uint8_t) 0x01)
+#define STREAM_WS_OPCODE_BINARY         ((uint8_t) 0x02)
+
+
+//****************************************************************************
+//
+// Batch data structure
+//
+//****************************************************************************
+
+typedef struct
+{
+    uint64_t            timestamp;      // /DRDY time of the first conversion averaged
+    uint32_t            sequence;       // Sequence number of the first conversion averaged
+    uint16_t            conversions;    // Conversions averaged, 1 to decimation
+    uint8_t             mode;           // Link mode and decimation factor the record
+    uint8_t             decimation;     // was formed with
+    adc_channel_data    data;           // Average of the conversions
+} stream_record;
+
+typedef struct
+{
+    int32_t             sum[CHANNEL_COUNT];
+    stream_record       group;          // Record being formed; data.channel[] unused
+    uint32_t            lastSequence;   // Sequence number of the last conversion added
+} stream_decimator;
+
+typedef struct
+{
+    uint8_t  buffer[STREAM_MAX_PACKET_BYTES];
+    uint16_t length;            // Bytes used in buffer[], including the header
+    uint16_t count;             // Records in buffer[]
+    uint16_t recordBytes;       // Size of one record for channelMask
+    uint8_t  channelMask;       // Channels in every record of the batch
+    uint8_t  mode;              // Link mode the batch was started in
+    uint8_t  decimation;        // Decimation factor of every record of the batch
+    uint8_t  encoding;          // STREAM_ENCODING_RAW until streamBatchEncode()
+    uint32_t conversions;       // Conversions averaged into the records
+    uint32_t firstSequence;     // Sequence number of the first record
+    uint64_t firstTimestamp;    // getTimestamp() ticks of the first record
+    uint32_t startTime_ms;      // Time at which the first record was added
+} stream_batch;
+
+typedef struct
+{
+    uint32_t interval_us;       // Time the statistics cover
+    uint32_t busy_us;           // Time the busiest client spent sending data
+    uint32_t lostFrames;        // Data frames not delivered: queue full or send failed
+} stream_link_stats;
+
+typedef struct
+{
+    uint32_t missedDrdy;        // Conversions signalled by /DRDY but never read
+    uint32_t crcErrors;         // Conversions read with a CRC error and discarded
+    uint32_t ringOverflows;     // Conversions dropped by a full sample ring
+    uint32_t sendFailures;      // Conversions not delivered, once per client that missed them
+} stream_loss_stats;
+
+
+
+//****************************************************************************
+//
+// Function prototypes
+//
+//****************************************************************************
+
+void        streamSetFlushPolicy(uint16_t maxRecords, uint32_t maxLatency_ms);
+void        streamSetDataRate(uint32_t dataRate_Hz);
+uint16_t    streamGetBatchRecords(void);
+uint32_t    streamGetBatchLatency(void);
+
+bool        streamAdaptToLink(const stream_link_stats *link);
+uint8_t     streamGetMode(void);
+uint8_t     streamGetDecimation(void);
+
+void        streamDecimatorReset(stream_decimator *decimator);
+bool        streamDecimatorAccepts(const stream_decimator *decimator, const sample_record *record);
+void        streamDecimatorAdd(stream_decimator *decimator, const sample_record *record);
+bool        streamDecimatorComplete(const stream_decimator *decimator);
+bool        streamDecimatorTake(stream_decimator *decimator, stream_record *record);
+
+void        streamSetEncoding(uint8_t encoding);
+uint8_t     streamGetEncoding(void);
+
+uint32_t    streamRecordSequence(uint32_t firstSequence, uint16_t index, uint8_t decimation);
+uint16_t    streamPacketBytes(const uint8_t *header);
+uint16_t    streamEncodePacket(const uint8_t *packet, uint8_t *encoded);
+
+void        streamBatchReset(stream_batch *batch);
+bool        streamBatchAccepts(const stream_batch *batch, const stream_record *record);
+void        streamBatchAdd(stream_batch *batch, const stream_record *record, uint32_t now_ms);
+bool        streamBatchFlushDue(const stream_batch *batch, uint32_t now_ms);
+void        streamBatchEncode(stream_batch *batch);
+
+void        streamTrackSequence(uint32_t sequence);
+void        streamCountCrcError(void);
+void        streamCountSendFailure(uint32_t conversions);
+void        streamGetLossStats(stream_loss_stats *stats);
+uint32_t    streamLossTotal(const stream_loss_stats *stats);
+uint16_t    streamFormatLossReport(const stream_loss_stats *stats, char *buffer, uint16_t size);
+
+
+#endif /* ADC_STREAM_H_ */
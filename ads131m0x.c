@@ -31,7 +31,10 @@
  *
  */
 
+#include <string.h>
+
 #include "ads131m0x.h"
+#include "benchmark.h"
 
 
 
@@ -44,9 +47,163 @@
 // Array used to recall device register map configurations */
 static uint16_t             registerMap[NUM_REGISTERS];
 
+// Per-channel code-to-microvolt multipliers, kept in step with GAIN1/GAIN2
+static int32_t              channelScale[CHANNEL_COUNT];
+
+// Conversion timing and enabled channels, kept in step with CLOCK
+static adc_timing           timing;
+static uint8_t              channelEnableMask;
+
+// Buffers for multiple-register frames; kept off the stack because adcStartup()
+// runs from main() on the small system stack
+static uint16_t             registerWords[MAX_REGISTERS_PER_FRAME + 1];
+static uint8_t              registerFrameTx[MAX_REGISTER_FRAME_BYTES];
+static uint8_t              registerFrameRx[MAX_REGISTER_FRAME_BYTES];
+
+// Shadow register map: values staged for commitRegisters(), valid where the dirty bit is set
+static uint16_t             stagedMap[NUM_REGISTERS];
+static uint64_t             dirtyRegisters = 0;
+#define REGISTER_BIT(address)       ((uint64_t) 1 << (address))
+
+// Clean registers that commitRegisters() rewrites to avoid starting a new frame
+#define MAX_REWRITE_GAP             (2)
+
 // Array of SPI word lengths
 const static uint8_t        wlength_byte_values[] = {2, 3, 4, 4};
 
+// CRC lookup table: crcTable[n] is the CRC of byte n shifted through the selected polynomial
+#ifdef CRC_CCITT
+/* CCITT CRC polynomial = x^16 + x^12 + x^5 + 1 (0x1021) */
+const static uint16_t       crcTable[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+};
+#endif
+#ifdef CRC_ANSI
+/* ANSI CRC polynomial = x^16 + x^15 + x^2 + 1 (0x8005) */
+const static uint16_t       crcTable[256] = {
+    0x0000, 0x8005, 0x800F, 0x000A, 0x801B, 0x001E, 0x0014, 0x8011,
+    0x8033, 0x0036, 0x003C, 0x8039, 0x0028, 0x802D, 0x8027, 0x0022,
+    0x8063, 0x0066, 0x006C, 0x8069, 0x0078, 0x807D, 0x8077, 0x0072,
+    0x0050, 0x8055, 0x805F, 0x005A, 0x804B, 0x004E, 0x0044, 0x8041,
+    0x80C3, 0x00C6, 0x00CC, 0x80C9, 0x00D8, 0x80DD, 0x80D7, 0x00D2,
+    0x00F0, 0x80F5, 0x80FF, 0x00FA, 0x80EB, 0x00EE, 0x00E4, 0x80E1,
+    0x00A0, 0x80A5, 0x80AF, 0x00AA, 0x80BB, 0x00BE, 0x00B4, 0x80B1,
+    0x8093, 0x0096, 0x009C, 0x8099, 0x0088, 0x808D, 0x8087, 0x0082,
+    0x8183, 0x0186, 0x018C, 0x8189, 0x0198, 0x819D, 0x8197, 0x0192,
+    0x01B0, 0x81B5, 0x81BF, 0x01BA, 0x81AB, 0x01AE, 0x01A4, 0x81A1,
+    0x01E0, 0x81E5, 0x81EF, 0x01EA, 0x81FB, 0x01FE, 0x01F4, 0x81F1,
+    0x81D3, 0x01D6, 0x01DC, 0x81D9, 0x01C8, 0x81CD, 0x81C7, 0x01C2,
+    0x0140, 0x8145, 0x814F, 0x014A, 0x815B, 0x015E, 0x0154, 0x8151,
+    0x8173, 0x0176, 0x017C, 0x8179, 0x0168, 0x816D, 0x8167, 0x0162,
+    0x8123, 0x0126, 0x012C, 0x8129, 0x0138, 0x813D, 0x8137, 0x0132,
+    0x0110, 0x8115, 0x811F, 0x011A, 0x810B, 0x010E, 0x0104, 0x8101,
+    0x8303, 0x0306, 0x030C, 0x8309, 0x0318, 0x831D, 0x8317, 0x0312,
+    0x0330, 0x8335, 0x833F, 0x033A, 0x832B, 0x032E, 0x0324, 0x8321,
+    0x0360, 0x8365, 0x836F, 0x036A, 0x837B, 0x037E, 0x0374, 0x8371,
+    0x8353, 0x0356, 0x035C, 0x8359, 0x0348, 0x834D, 0x8347, 0x0342,
+    0x03C0, 0x83C5, 0x83CF, 0x03CA, 0x83DB, 0x03DE, 0x03D4, 0x83D1,
+    0x83F3, 0x03F6, 0x03FC, 0x83F9, 0x03E8, 0x83ED, 0x83E7, 0x03E2,
+    0x83A3, 0x03A6, 0x03AC, 0x83A9, 0x03B8, 0x83BD, 0x83B7, 0x03B2,
+    0x0390, 0x8395, 0x839F, 0x039A, 0x838B, 0x038E, 0x0384, 0x8381,
+    0x0280, 0x8285, 0x828F, 0x028A, 0x829B, 0x029E, 0x0294, 0x8291,
+    0x82B3, 0x02B6, 0x02BC, 0x82B9, 0x02A8, 0x82AD, 0x82A7, 0x02A2,
+    0x82E3, 0x02E6, 0x02EC, 0x82E9, 0x02F8, 0x82FD, 0x82F7, 0x02F2,
+    0x02D0, 0x82D5, 0x82DF, 0x02DA, 0x82CB, 0x02CE, 0x02C4, 0x82C1,
+    0x8243, 0x0246, 0x024C, 0x8249, 0x0258, 0x825D, 0x8257, 0x0252,
+    0x0270, 0x8275, 0x827F, 0x027A, 0x826B, 0x026E, 0x0264, 0x8261,
+    0x0220, 0x8225, 0x822F, 0x022A, 0x823B, 0x023E, 0x0234, 0x8231,
+    0x8213, 0x0216, 0x021C, 0x8219, 0x0208, 0x820D, 0x8207, 0x0202
+};
+#endif
+
+
+
+//****************************************************************************
+//
+// Internal macros
+//
+//****************************************************************************
+
+/* Sign-extends the channel data word at 'p' for the selected WORD_LENGTH mode */
+#if defined WORD_LENGTH_24BIT || defined WORD_LENGTH_32BIT_ZERO_PADDED
+#define DECODE_DATA_WORD(p)     (((int32_t) (((uint32_t) (p)[0] << 24) | ((uint32_t) (p)[1] << 16) | ((uint32_t) (p)[2] << 8))) >> 8)
+#elif defined WORD_LENGTH_32BIT_SIGN_EXTEND
+#define DECODE_DATA_WORD(p)     ((int32_t) (((uint32_t) (p)[0] << 24) | ((uint32_t) (p)[1] << 16) | ((uint32_t) (p)[2] << 8) | ((uint32_t) (p)[3] << 0)))
+#elif defined WORD_LENGTH_16BIT_TRUNCATED
+#define DECODE_DATA_WORD(p)     (((int32_t) (((uint32_t) (p)[0] << 24) | ((uint32_t) (p)[1] << 16))) >> 16)
+#endif
+
+/* Loads four bytes from any address as an MSB-first 32-bit value. On the
+ * Cortex-M4 this is one (unaligned) LDR followed by REV. The bytes are copied
+ * with memcpy() rather than read through a uint32_t pointer, so that the load
+ * neither breaks strict aliasing nor gets merged into an LDRD or LDM, which
+ * fault on unaligned addresses.
+ */
+#if defined(__TI_COMPILER_VERSION__)
+#define LOAD_BE32(p)            loadBE32(p)
+static inline uint32_t loadBE32(const uint8_t *p)
+{
+    uint32_t word;
+    memcpy(&word, p, sizeof(word));
+    return (uint32_t) _rev(word);
+}
+#elif defined(__GNUC__)
+#define LOAD_BE32(p)            loadBE32(p)
+static inline uint32_t loadBE32(const uint8_t *p)
+{
+    uint32_t word;
+    memcpy(&word, p, sizeof(word));
+    return __builtin_bswap32(word);
+}
+#else
+#define LOAD_BE32(p)            (((uint32_t) (p)[0] << 24) | ((uint32_t) (p)[1] << 16) | ((uint32_t) (p)[2] << 8) | ((uint32_t) (p)[3] << 0))
+#endif
+
+/* Same as DECODE_DATA_WORD(), but reads a whole 32-bit word; the bytes past
+ * the end of a shorter data word are shifted out. That is an LDR, a REV and
+ * an ASR per channel. SXTB16 does not help: it sign-extends 8-bit lanes into
+ * 16-bit halves, and a 24-bit code spans both halves. Nor does SSAT: every
+ * code already fits in an int32_t, so there is nothing to saturate.
+ */
+#if defined WORD_LENGTH_24BIT || defined WORD_LENGTH_32BIT_ZERO_PADDED
+#define DECODE_DATA_WORD_FAST(p)    (((int32_t) LOAD_BE32(p)) >> 8)
+#elif defined WORD_LENGTH_32BIT_SIGN_EXTEND
+#define DECODE_DATA_WORD_FAST(p)    ((int32_t) LOAD_BE32(p))
+#elif defined WORD_LENGTH_16BIT_TRUNCATED
+#define DECODE_DATA_WORD_FAST(p)    (((int32_t) LOAD_BE32(p)) >> 16)
+#endif
+
 
 
 //****************************************************************************
@@ -58,6 +215,10 @@ const static uint8_t        wlength_byte_values[] = {2, 3, 4, 4};
 uint8_t     buildSPIarray(const uint16_t opcodeArray[], uint8_t numberOpcodes, uint8_t byteArray[]);
 uint16_t    enforce_selected_device_modes(uint16_t data);
 uint8_t     getWordByteLength(void);
+void        updateDerivedSettings(uint8_t startAddress, uint8_t count);
+void        updateChannelScales(void);
+void        updateTiming(void);
+uint16_t    calculateRegisterMapCRC(void);
 
 
 
@@ -85,6 +246,22 @@ uint16_t getRegisterValue(uint8_t address)
 
 
 
+//*****************************************************************************
+//
+//! Getter function to access the channel enable mask.
+//!
+//! \fn uint8_t getChannelEnableMask(void)
+//!
+//! \return bit n set if channel n is enabled in registerMap[CLOCK_ADDRESS].
+//
+//*****************************************************************************
+uint8_t getChannelEnableMask(void)
+{
+    return channelEnableMask;
+}
+
+
+
 //*****************************************************************************
 //
 //! Example start up sequence for the ADS131M0x.
@@ -116,27 +293,30 @@ void adcStartup(void)
     /* (OPTIONAL) Validate first response word when beginning SPI communication: (0xFF20 | CHANCNT) */
 	//uint16_t response = sendCommand(OPCODE_NULL);
 
-	/* (OPTIONAL) Define your initial register settings here */
-	/* Setting CLOCK to 16KHz output rate and low-power mode */
-    writeSingleRegister(CLOCK_ADDRESS, (CLOCK_DEFAULT & ~CLOCK_OSR_MASK) | CLOCK_OSR_1024);
-    uint16_t currentClockValue = readSingleRegister(CLOCK_ADDRESS);
-    writeSingleRegister(CLOCK_ADDRESS, (currentClockValue & ~CLOCK_PWR_MASK) | CLOCK_PWR_LP);
-
-    /* Setting GAIN1 to a PGA gain of 8 for all channels */
-    writeSingleRegister(GAIN1_ADDRESS, (GAIN1_DEFAULT & ~GAIN1_PGAGAIN3_MASK) | GAIN1_PGAGAIN3_8);
-    uint16_t currentGain1Value = readSingleRegister(GAIN1_ADDRESS);
-    writeSingleRegister(GAIN1_ADDRESS, (currentGain1Value & ~GAIN1_PGAGAIN2_MASK) | GAIN1_PGAGAIN2_8);
-    currentGain1Value = readSingleRegister(GAIN1_ADDRESS);
-    writeSingleRegister(GAIN1_ADDRESS, (currentGain1Value & ~GAIN1_PGAGAIN1_MASK) | GAIN1_PGAGAIN1_8);
-    currentGain1Value = readSingleRegister(GAIN1_ADDRESS);
-    writeSingleRegister(GAIN1_ADDRESS, (currentGain1Value & ~GAIN1_PGAGAIN0_MASK) | GAIN1_PGAGAIN0_8);
+	/* (OPTIONAL) Define your initial register settings here; they are only staged until commitRegisters() */
+	/* Setting CLOCK to OSR 1024 (4 kSPS with an 8.192 MHz CLKIN) and high-resolution mode,
+	 * the only power mode specified at that CLKIN */
+	setOversamplingRatio(CLOCK_OSR_1024);
+	setPowerMode(CLOCK_PWR_HR);
+
+	/* Setting a PGA gain of 8 for all channels */
+	uint8_t channel;
+	for (channel = 0; channel < CHANNEL_COUNT; channel++)
+	{
+	    setChannelGain(channel, 8);
+	}
 
     /* (REQUIRED) Configure MODE register settings
-     * NOTE: This function call is required here for this particular code implementation to work.
-     * This function will enforce the MODE register settings as selected in the 'ads131m0x.h' header file.
+     * NOTE: This is required here for this particular code implementation to work.
+     * The MODE register settings selected in the 'ads131m0x.h' header file are enforced when staged.
      */
-    /* Setting MODE to 16-bit word length */
-    writeSingleRegister(MODE_ADDRESS, (MODE_DEFAULT & ~MODE_WLENGTH_MASK) | MODE_WLENGTH_16BIT);
+	stageRegister(MODE_ADDRESS, MODE_DEFAULT);
+
+	/* Write the changed registers in as few frames as possible and verify the register map */
+	if (commitRegisters())
+	{
+	    /* (OPTIONAL) Error handler: a register did not read back as written */
+	}
 }
 
 
@@ -174,6 +354,9 @@ uint16_t readSingleRegister(uint8_t address)
 	// [FRAME 2] Send NULL command to retrieve the register data
 	registerMap[address] = sendCommand(OPCODE_NULL);
 
+	// Keep the scaling and timing in step with the register settings
+	updateDerivedSettings(address, 1);
+
 	return registerMap[address];
 }
 
@@ -198,12 +381,12 @@ void writeSingleRegister(uint8_t address, uint16_t data)
     /* Check that the register address is in range */
     assert(address < NUM_REGISTERS);
 
-    // (OPTIONAL) Enforce certain register field values when
-    // writing to the MODE register to fix the operation mode
-    //if (MODE_ADDRESS == address)
-    //{
-    //    data = enforce_selected_device_modes(data);
-    //}
+    // (REQUIRED) Enforce certain register field values when writing to the
+    // MODE register; readData() is built for the modes selected in ads131m0x.h
+    if (MODE_ADDRESS == address)
+    {
+        data = enforce_selected_device_modes(data);
+    }
 
     // Build TX and RX byte array
 #ifdef ENABLE_CRC_IN
@@ -234,148 +417,507 @@ void writeSingleRegister(uint8_t address, uint16_t data)
 
 //*****************************************************************************
 //
-//! Reads ADC data.
+//! Reads a block of contiguous registers with one multiple-register RREG.
 //!
-//! \fn bool readData(adc_channel_data *DataStruct)
+//! \fn bool readMultipleRegisters(uint8_t startAddress, uint8_t count)
 //!
-//! \param *DataStruct points to an adc_channel_data type-defined structure/
+//! \param startAddress is the address of the first register to read.
+//! \param count is the number of registers to read (1 to MAX_REGISTERS_PER_FRAME).
 //!
-//! NOTE: Should be called after /DRDY goes low, and not during a /DRDY falling edge!
+//! The register values are stored in registerMap[] and can be retrieved with
+//! getRegisterValue(). They are left untouched if the response is invalid.
 //!
-//! \return Returns true if the CRC-OUT of the data read detects an error.
+//! \return true if the acknowledge word or the CRC of the response is wrong.
 //
 //*****************************************************************************
-bool readData(adc_channel_data *DataStruct)
+bool readMultipleRegisters(uint8_t startAddress, uint8_t count)
 {
-    int i;
-    uint8_t crcTx[4]                        = { 0 };
-    uint8_t dataRx[4]                       = { 0 };
-    uint8_t bytesPerWord                    = getWordByteLength();
+	/* Check that the register addresses are in range */
+	assert((count > 0) && (count <= MAX_REGISTERS_PER_FRAME));
+	assert((startAddress + count) <= NUM_REGISTERS);
 
-#ifdef ENABLE_CRC_IN
-    // Build CRC word (only if "RX_CRC_EN" register bit is enabled)
-    uint16_t crcWordIn = calculateCRC(&DataTx[0], bytesPerWord * 2, 0xFFFF);
-    crcTx[0] = upperByte(crcWordIn);
-    crcTx[1] = lowerByte(crcWordIn);
-#endif
+	/* A single register is returned in place of the response word instead */
+	if (1 == count)
+	{
+	    readSingleRegister(startAddress);
+	    return false;
+	}
 
-    /* Set the nCS pin LOW */
-    MAP_SPICSEnable(GSPI_BASE);
+	uint8_t bytesPerWord = getWordByteLength();
+	uint16_t opcode = OPCODE_RREG | (((uint16_t) startAddress) << 7) | (count - 1);
+	memset(registerFrameTx, 0, sizeof(registerFrameTx));
+	uint8_t numberOfBytes = buildSPIarray(&opcode, 1, registerFrameTx);
 
-    // Send NULL word, receive response word
-    for (i = 0; i < bytesPerWord; i++)
-    {
-        dataRx[i] = spiSendReceiveByte(0x00);
-    }
-    DataStruct->response = combineBytes(dataRx[0], dataRx[1]);
+	// [FRAME 1] Send RREG command
+	spiSendReceiveArrays(registerFrameTx, registerFrameRx, numberOfBytes);
+
+	// [FRAME 2] Send NULL command; the response is the acknowledge word, the register words and the CRC word
+	numberOfBytes = (count + 2) * bytesPerWord;
+	memset(registerFrameTx, 0, sizeof(registerFrameTx));
+	opcode = OPCODE_NULL;
+	buildSPIarray(&opcode, 1, registerFrameTx);
+	spiSendReceiveArrays(registerFrameTx, registerFrameRx, numberOfBytes);
+
+	// Acknowledge word: 111a aaaa annn nnnn
+	uint16_t acknowledge = combineBytes(registerFrameRx[0], registerFrameRx[1]);
+	uint16_t expected = 0xE000 | (((uint16_t) startAddress) << 7) | (count - 1);
+
+	// CRC-OUT covers every byte preceding the CRC word; a valid frame gives zero
+	uint16_t crcWord = calculateCRC(&registerFrameRx[0], ((count + 1) * bytesPerWord) + 2, 0xFFFF);
+	if ((acknowledge != expected) || crcWord)
+	{
+	    return true;
+	}
 
-    // (OPTIONAL) Do something with the response (STATUS) word.
-    // ...Here we only use the response for calculating the CRC-OUT
-    //uint16_t crcWord = calculateCRC(&dataRx[0], bytesPerWord, 0xFFFF);
+	uint8_t i;
+	for (i = 0; i < count; i++)
+	{
+	    const uint8_t *word = &registerFrameRx[(i + 1) * bytesPerWord];
+	    registerMap[startAddress + i] = combineBytes(word[0], word[1]);
+	}
 
-    // (OPTIONAL) Ignore CRC error checking
-    uint16_t crcWord = 0;
+	// Keep the scaling and timing in step with the register settings
+	updateDerivedSettings(startAddress, count);
 
-    // Send 2nd word, receive channel 1 data
-    for (i = 0; i < bytesPerWord; i++)
-    {
-        dataRx[i] = spiSendReceiveByte(crcTx[i]);
-    }
-    DataStruct->channel0 = signExtend(&dataRx[0]);
-    //crcWord = calculateCRC(&dataRx[0], bytesPerWord, crcWord);
+	return false;
+}
 
-#if (CHANNEL_COUNT > 1)
 
-    // Send 3rd word, receive channel 2 data
-    for (i = 0; i < bytesPerWord; i++)
+
+//*****************************************************************************
+//
+//! Writes a block of contiguous registers with one multiple-register WREG.
+//!
+//! \fn void writeMultipleRegisters(uint8_t startAddress, uint8_t count, const uint16_t regData[])
+//!
+//! \param startAddress is the address of the first register to write.
+//! \param count is the number of registers to write (1 to MAX_REGISTERS_PER_FRAME).
+//! \param regData[] values to write, regData[0] going to startAddress.
+//!
+//! Unlike writeSingleRegister(), the registers are not read back; use
+//! readMultipleRegisters() (or use commitRegisters()) to confirm the write.
+//! This command will be ignored if device registers are locked.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void writeMultipleRegisters(uint8_t startAddress, uint8_t count, const uint16_t regData[])
+{
+    /* Check that the register addresses are in range */
+    assert((count > 0) && (count <= MAX_REGISTERS_PER_FRAME));
+    assert((startAddress + count) <= NUM_REGISTERS);
+
+    // Opcode word followed by one word per register
+    registerWords[0] = OPCODE_WREG | (((uint16_t) startAddress) << 7) | (count - 1);
+
+    uint8_t i;
+    for (i = 0; i < count; i++)
     {
-        dataRx[i] = spiSendReceiveByte(0x00);
+        uint16_t data = regData[i];
+
+        // (REQUIRED) Enforce the MODE register fields selected in ads131m0x.h
+        if (MODE_ADDRESS == (startAddress + i))
+        {
+            data = enforce_selected_device_modes(data);
+        }
+        registerWords[i + 1] = data;
     }
-    DataStruct->channel1 = signExtend(&dataRx[0]);
-    //crcWord = calculateCRC(&dataRx[0], bytesPerWord, crcWord);
 
-#endif
-#if (CHANNEL_COUNT > 2)
+    memset(registerFrameTx, 0, sizeof(registerFrameTx));
+    uint8_t numberOfBytes = buildSPIarray(registerWords, count + 1, registerFrameTx);
 
-    // Send 4th word, receive channel 3 data
-    for (i = 0; i < bytesPerWord; i++)
+    // Send command
+    spiSendReceiveArrays(registerFrameTx, registerFrameRx, numberOfBytes);
+
+    // Update internal array
+    for (i = 0; i < count; i++)
     {
-        dataRx[i] = spiSendReceiveByte(0x00);
+        registerMap[startAddress + i] = registerWords[i + 1];
     }
-    DataStruct->channel2 = signExtend(&dataRx[0]);
-    //crcWord = calculateCRC(&dataRx[0], bytesPerWord, crcWord);
 
-#endif
-#if (CHANNEL_COUNT > 3)
+    // Keep the scaling and timing in step with the register settings
+    updateDerivedSettings(startAddress, count);
+}
+
+
 
-    // Send 5th word, receive channel 4 data
-    for (i = 0; i < bytesPerWord; i++)
+//*****************************************************************************
+//
+//! Brings the configuration registers to the desired values in as few SPI
+//! frames as possible.
+//!
+//! \fn bool applyRegisterConfig(const uint16_t config[])
+//!
+//! \param config[] desired register map, indexed by register address
+//! (NUM_REGISTERS entries). Only FIRST_CONFIG_ADDRESS to LAST_CONFIG_ADDRESS
+//! are applied.
+//!
+//! Every configuration register is staged and the changes are committed with
+//! commitRegisters().
+//!
+//! \return true if the device registers could not be verified.
+//
+//*****************************************************************************
+bool applyRegisterConfig(const uint16_t config[])
+{
+    uint8_t address;
+    for (address = FIRST_CONFIG_ADDRESS; address <= LAST_CONFIG_ADDRESS; address++)
     {
-        dataRx[i] = spiSendReceiveByte(0x00);
+        stageRegister(address, config[address]);
     }
-    DataStruct->channel3 = signExtend(&dataRx[0]);
-    //crcWord = calculateCRC(&dataRx[0], bytesPerWord, crcWord);
 
-#endif
-#if (CHANNEL_COUNT > 4)
+    return commitRegisters();
+}
+
+
 
-    // Send 6th word, receive channel 5 data
-    for (i = 0; i < bytesPerWord; i++)
+//****************************************************************************
+//
+// Shadow register map functions
+//
+//****************************************************************************
+
+
+//*****************************************************************************
+//
+//! Stages a configuration register value for the next commitRegisters().
+//!
+//! \fn void stageRegister(uint8_t address, uint16_t data)
+//!
+//! \param address is the address of a configuration register
+//! (FIRST_CONFIG_ADDRESS to LAST_CONFIG_ADDRESS).
+//! \param data is the value to write.
+//!
+//! Nothing is sent to the device. The register is marked dirty only if the
+//! value differs from registerMap[]; the MODE register settings selected in
+//! ads131m0x.h are enforced here already.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void stageRegister(uint8_t address, uint16_t data)
+{
+    /* Check that the register address is in range */
+    assert((address >= FIRST_CONFIG_ADDRESS) && (address <= LAST_CONFIG_ADDRESS));
+
+    if (MODE_ADDRESS == address)
     {
-        dataRx[i] = spiSendReceiveByte(0x00);
+        data = enforce_selected_device_modes(data);
     }
-    DataStruct->channel4 = signExtend(&dataRx[0]);
-    //crcWord = calculateCRC(&dataRx[0], bytesPerWord, crcWord);
-
-#endif
-#if (CHANNEL_COUNT > 5)
 
-    // Send 7th word, receive channel 6 data
-    for (i = 0; i < bytesPerWord; i++)
+    stagedMap[address] = data;
+    if (data != registerMap[address])
     {
-        dataRx[i] = spiSendReceiveByte(0x00);
+        dirtyRegisters |= REGISTER_BIT(address);
     }
-    DataStruct->channel5 = signExtend(&dataRx[0]);
-    //crcWord = calculateCRC(&dataRx[0], bytesPerWord, crcWord);
+    else
+    {
+        dirtyRegisters &= ~REGISTER_BIT(address);
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Stages a change to some fields of a configuration register.
+//!
+//! \fn void stageRegisterField(uint8_t address, uint16_t mask, uint16_t value)
+//!
+//! \param address is the address of a configuration register.
+//! \param mask selects the bits to change.
+//! \param value holds the new field values, already shifted into place.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void stageRegisterField(uint8_t address, uint16_t mask, uint16_t value)
+{
+    stageRegister(address, (getStagedRegisterValue(address) & ~mask) | (value & mask));
+}
+
 
-#endif
-#if (CHANNEL_COUNT > 6)
 
-    // Send 8th word, receive channel 7 data
-    for (i = 0; i < bytesPerWord; i++)
+//*****************************************************************************
+//
+//! Returns the value a register will have after the next commitRegisters().
+//!
+//! \fn uint16_t getStagedRegisterValue(uint8_t address)
+//!
+//! \param address is the 8-bit address of the register.
+//!
+//! \return staged value if the register is dirty, else the registerMap[] value.
+//
+//*****************************************************************************
+uint16_t getStagedRegisterValue(uint8_t address)
+{
+    assert(address < NUM_REGISTERS);
+    return (dirtyRegisters & REGISTER_BIT(address)) ? stagedMap[address] : registerMap[address];
+}
+
+
+
+//*****************************************************************************
+//
+//! Stages the PGA gain of a channel.
+//!
+//! \fn void setChannelGain(uint8_t channel, uint8_t gain)
+//!
+//! \param channel is the channel number.
+//! \param gain is the PGA gain in V/V: 1, 2, 4, 8, 16, 32, 64 or 128.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void setChannelGain(uint8_t channel, uint8_t gain)
+{
+    assert(channel < CHANNEL_COUNT);
+
+    // The 3-bit PGAGAIN field is log2 of the gain
+    uint16_t gainCode = 0;
+    while ((gainCode < 7) && ((1u << gainCode) < gain)) { gainCode++; }
+    assert((1u << gainCode) == gain);
+
+    // Channels 0-3 are in GAIN1 and 4-7 in GAIN2, 4 bits per channel
+    uint8_t address = (channel < 4) ? GAIN1_ADDRESS : GAIN2_ADDRESS;
+    uint8_t shift = 4 * (channel % 4);
+    stageRegisterField(address, GAIN1_PGAGAIN0_MASK << shift, gainCode << shift);
+}
+
+
+
+//*****************************************************************************
+//
+//! Stages the oversampling ratio.
+//!
+//! \fn void setOversamplingRatio(uint16_t osr)
+//!
+//! \param osr is one of the CLOCK_OSR_* field values.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void setOversamplingRatio(uint16_t osr)
+{
+    stageRegisterField(CLOCK_ADDRESS, CLOCK_OSR_MASK, osr);
+}
+
+
+
+//*****************************************************************************
+//
+//! Stages the power mode.
+//!
+//! \fn void setPowerMode(uint16_t pwr)
+//!
+//! \param pwr is one of the CLOCK_PWR_* field values.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void setPowerMode(uint16_t pwr)
+{
+    stageRegisterField(CLOCK_ADDRESS, CLOCK_PWR_MASK, pwr);
+}
+
+
+
+//*****************************************************************************
+//
+//! Stages the set of enabled channels.
+//!
+//! \fn void setChannelEnableMask(uint8_t mask)
+//!
+//! \param mask has bit n set to enable channel n; at least one channel must
+//! stay enabled.
+//!
+//! Disabled channels are powered down and read as zero. Their words stay in
+//! the data frame; readData() reports the mask so that later stages can skip
+//! them.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void setChannelEnableMask(uint8_t mask)
+{
+    assert((mask != 0) && ((mask & ~ALL_CHANNELS_MASK) == 0));
+
+    stageRegisterField(CLOCK_ADDRESS, (uint16_t) ALL_CHANNELS_MASK << CLOCK_CH_EN_SHIFT,
+                       (uint16_t) mask << CLOCK_CH_EN_SHIFT);
+}
+
+
+
+//*****************************************************************************
+//
+//! Drops every staged change.
+//!
+//! \fn void discardRegisterChanges(void)
+//!
+//! \return None.
+//
+//*****************************************************************************
+void discardRegisterChanges(void)
+{
+    dirtyRegisters = 0;
+}
+
+
+
+//*****************************************************************************
+//
+//! Writes the dirty registers to the device and verifies the register map.
+//!
+//! \fn bool commitRegisters(void)
+//!
+//! Each block of dirty registers is written with one multiple-register WREG;
+//! a block also absorbs up to MAX_REWRITE_GAP clean registers rather than
+//! starting a new frame.
+//!
+//! With ENABLE_REGMAP_CRC, the result is verified by reading REGMAP_CRC once
+//! and comparing it with the CRC of registerMap[]. On a mismatch (or without
+//! ENABLE_REGMAP_CRC) registers are read back instead: every configuration
+//! register after a mismatch, only the written ones otherwise.
+//!
+//! NOTE: registerMap[] must be in sync with the device (e.g. after
+//! restoreRegisterDefaults() following a reset). This function is not thread
+//! safe; call it from the task that owns the SPI bus.
+//!
+//! \return true if a register did not read back as written.
+//
+//*****************************************************************************
+bool commitRegisters(void)
+{
+    uint64_t writtenRegisters = 0;
+    uint8_t firstWritten = NUM_REGISTERS;
+    uint8_t lastWritten = 0;
+    uint8_t address = FIRST_CONFIG_ADDRESS;
+
+    while (dirtyRegisters)
     {
-        dataRx[i] = spiSendReceiveByte(0x00);
+        if (!(dirtyRegisters & REGISTER_BIT(address)))
+        {
+            address++;
+            continue;
+        }
+
+        // Extend the block over later dirty registers, bridging short clean gaps
+        uint8_t start = address;
+        uint8_t end = address;
+        uint8_t next;
+        for (next = start + 1; (next <= LAST_CONFIG_ADDRESS) && ((next - start) < MAX_REGISTERS_PER_FRAME); next++)
+        {
+            if ((next - end) > (MAX_REWRITE_GAP + 1)) { break; }
+            if (dirtyRegisters & REGISTER_BIT(next)) { end = next; }
+        }
+
+        // Clean registers inside the block are rewritten with their current value
+        for (next = start; next <= end; next++)
+        {
+            if (!(dirtyRegisters & REGISTER_BIT(next))) { stagedMap[next] = registerMap[next]; }
+            dirtyRegisters &= ~REGISTER_BIT(next);
+            writtenRegisters |= REGISTER_BIT(next);
+        }
+
+        writeMultipleRegisters(start, end - start + 1, &stagedMap[start]);
+
+        if (start < firstWritten) { firstWritten = start; }
+        lastWritten = end;
+        address = end + 1;
     }
-    DataStruct->channel6 = signExtend(&dataRx[0]);
-    //crcWord = calculateCRC(&dataRx[0], bytesPerWord, crcWord);
 
+    // readData() decodes frames of the word length selected at compile time, so
+    // the device must be left in it; checked here rather than on every frame
+    assert(getWordByteLength() == WORD_BYTES);
+
+    // Nothing to do
+    if (firstWritten > lastWritten) { return false; }
+
+#ifdef ENABLE_REGMAP_CRC
+    // One register read verifies the whole map
+    uint16_t expectedCRC = calculateRegisterMapCRC();
+    if (readSingleRegister(REGMAP_CRC_ADDRESS) == expectedCRC) { return false; }
+
+    // The map differs somewhere: resynchronize every configuration register
+    firstWritten = FIRST_CONFIG_ADDRESS;
+    lastWritten = LAST_CONFIG_ADDRESS;
 #endif
-#if (CHANNEL_COUNT > 7)
 
-    // Send 9th word, receive channel 8 data
-    for (i = 0; i < bytesPerWord; i++)
+    // Read back the span and compare the written registers with what was written
+    bool b_config_error = false;
+    for (address = firstWritten; address <= lastWritten; address += MAX_REGISTERS_PER_FRAME)
     {
-        dataRx[i] = spiSendReceiveByte(0x00);
+        uint8_t count = lastWritten - address + 1;
+        if (count > MAX_REGISTERS_PER_FRAME) { count = MAX_REGISTERS_PER_FRAME; }
+
+        if (readMultipleRegisters(address, count)) { b_config_error = true; }
+    }
+    for (address = firstWritten; address <= lastWritten; address++)
+    {
+        if ((writtenRegisters & REGISTER_BIT(address)) && (stagedMap[address] != registerMap[address]))
+        {
+            b_config_error = true;
+        }
     }
-    DataStruct->channel7 = signExtend(&dataRx[0]);
-    //crcWord = calculateCRC(&dataRx[0], bytesPerWord, crcWord);
 
+    return b_config_error;
+}
+
+
+
+//*****************************************************************************
+//
+//! Reads ADC data.
+//!
+//! \fn bool readData(adc_channel_data *DataStruct)
+//!
+//! \param *DataStruct points to an adc_channel_data type-defined structure/
+//!
+//! NOTE: Should be called after /DRDY goes low, and not during a /DRDY falling edge!
+//!
+//! \return Returns true if the CRC-OUT of the data read detects an error.
+//
+//*****************************************************************************
+bool readData(adc_channel_data *DataStruct)
+{
+    uint8_t dataRx[FRAME_BYTES];
+
+    // The frame layout is fixed at compile time by WORD_LENGTH_* and CHANNEL_COUNT;
+    // commitRegisters() checks that the device uses that word length
+
+#ifdef ENABLE_CRC_IN
+    // The first word is the NULL command (all zeros), followed by its CRC word
+    uint8_t dataTx[FRAME_BYTES] = { 0 };
+    uint16_t crcWordIn = calculateCRC(&dataTx[0], WORD_BYTES, 0xFFFF);
+    dataTx[WORD_BYTES + 0] = upperByte(crcWordIn);
+    dataTx[WORD_BYTES + 1] = lowerByte(crcWordIn);
+#else
+    // The whole frame is the NULL command (all zeros)
+    static const uint8_t dataTx[FRAME_BYTES] = { 0 };
 #endif
 
-    // Send the next word, receive CRC data
-    for (i = 0; i < bytesPerWord; i++)
-    {
-        dataRx[i] = spiSendReceiveByte(0x00);
-    }
-    DataStruct->crc = combineBytes(dataRx[0], dataRx[1]);
+    // Clock out the whole frame in a single transfer (uses the uDMA when enabled in hal.h)
+    BENCH_START(spiStart);
+    spiSendReceiveArrays(dataTx, dataRx, FRAME_BYTES);
+    BENCH_END(BENCH_STAGE_SPI, spiStart);
+
+    // Response word
+    DataStruct->response = combineBytes(dataRx[0], dataRx[1]);
+
+    // Channel data words; disabled channels decode as zero
+    signExtendFrame(dataRx, DataStruct->channel);
+    DataStruct->channelMask = channelEnableMask;
 
-    /* NOTE: If we continue calculating the CRC with a matching CRC, the result should be zero.
+    // Last word holds the CRC
+    DataStruct->crc = combineBytes(dataRx[(FRAME_WORDS - 1) * WORD_BYTES], dataRx[((FRAME_WORDS - 1) * WORD_BYTES) + 1]);
+
+    /* Check CRC-OUT: it covers every byte preceding the CRC word. If we continue
+     * calculating the CRC over the received CRC bytes, the result should be zero.
      * Any non-zero result will indicate a mismatch.
      */
-    //crcWord = calculateCRC(&dataRx[0], bytesPerWord, crcWord);
-
-    /* Set the nCS pin HIGH */
-    MAP_SPICSDisable(GSPI_BASE);
+    BENCH_START(crcStart);
+    uint16_t crcWord = calculateCRC(&dataRx[0], ((FRAME_WORDS - 1) * WORD_BYTES) + 2, 0xFFFF);
+    BENCH_END(BENCH_STAGE_CRC, crcStart);
 
     // Returns true when a CRC error occurs
     return ((bool) crcWord);
@@ -417,7 +959,7 @@ uint16_t sendCommand(uint16_t opcode)
     uint8_t numberOfBytes = buildSPIarray(&opcode, 1, dataTx);
 
     /* Set the nCS pin LOW */
-    MAP_SPICSEnable(GSPI_BASE);
+    setCS(LOW);
 
     // Send the opcode (and crc word, if enabled)
     int i;
@@ -427,7 +969,7 @@ uint16_t sendCommand(uint16_t opcode)
     }
 
     /* Set the nCS pin HIGH */
-    MAP_SPICSDisable(GSPI_BASE);
+    setCS(HIGH);
 
     // Combine response bytes and return as a 16-bit word
     uint16_t adcResponse = combineBytes(dataRx[0], dataRx[1]);
@@ -465,7 +1007,7 @@ void resetDevice(void)
     uint8_t wordsInFrame    = CHANNEL_COUNT + 2;
 
     // Set the nCS pin LOW
-    MAP_SPICSEnable(GSPI_BASE);
+    setCS(LOW);
 
     // Send the opcode (and CRC word, if enabled)
     int i;
@@ -485,7 +1027,7 @@ void resetDevice(void)
     // did not receive a full SPI frame and the reset did not occur!
 
     // Set the nCS pin HIGH
-    MAP_SPICSDisable(GSPI_BASE);
+    setCS(HIGH);
 
     // tSRLRST delay, ~1ms with 2.048 MHz fCLK
     delay_ms(1);
@@ -605,69 +1147,41 @@ bool unlockRegisters(void)
 //! \param numberBytes number of bytes to be used in CRC calculation
 //! \param initialValue the seed value (or partial crc calculation), use 0xFFFF when beginning a new CRC computation
 //!
-//! NOTE: This calculation is shown as an example and is not optimized for speed.
+//! NOTE: The polynomial is selected at compile time (CRC_CCITT or CRC_ANSI in
+//! ads131m0x.h). Each byte costs one table lookup; bytes are consumed in pairs
+//! to halve the loop overhead.
 //!
 //! \return 16-bit calculated CRC word
 //
 //*****************************************************************************
 uint16_t calculateCRC(const uint8_t dataBytes[], uint8_t numberBytes, uint16_t initialValue)
 {
-	/* Check that "dataBytes" is not a null pointer */
-	assert(dataBytes != 0x00);
-
-	int         bitIndex, byteIndex;
-	bool        dataMSb;						/* Most significant bit of data byte */
-	bool        crcMSb;						    /* Most significant bit of crc byte  */
-	uint8_t     bytesPerWord = wlength_byte_values[WLENGTH];
+    /* Check that "dataBytes" is not a null pointer */
+    assert(dataBytes != 0x00);
 
-	/*
+    /*
      * Initial value of crc register
      * NOTE: The ADS131M0x defaults to 0xFFFF,
      * but can be set at function call to continue an on-going calculation
      */
-    uint16_t crc = initialValue;
+    uint32_t crc = initialValue;
 
-    #ifdef CRC_CCITT
-    /* CCITT CRC polynomial = x^16 + x^12 + x^5 + 1 */
-    const uint16_t poly = 0x1021;
-    #endif
-
-    #ifdef CRC_ANSI
-    /* ANSI CRC polynomial = x^16 + x^15 + x^2 + 1 */
-    const uint16_t poly = 0x8005;
-    #endif
-
-    //
-    // CRC algorithm
-    //
+    // Two bytes (one 16-bit word) per iteration
+    while (numberBytes >= 2)
+    {
+        crc = (crc << 8) ^ crcTable[((crc >> 8) ^ dataBytes[0]) & 0xFF];
+        crc = (crc << 8) ^ crcTable[((crc >> 8) ^ dataBytes[1]) & 0xFF];
+        dataBytes   += 2;
+        numberBytes -= 2;
+    }
 
-    // Loop through all bytes in the dataBytes[] array
-	for (byteIndex = 0; byteIndex < numberBytes; byteIndex++)
-	{
-	    // Point to MSb in byte
-	    bitIndex = 0x80u;
-
-	    // Loop through all bits in the current byte
-	    while (bitIndex > 0)
-	    {
-	        // Check MSB's of data and crc
-	        dataMSb = (bool) (dataBytes[byteIndex] & bitIndex);
-	        crcMSb  = (bool) (crc & 0x8000u);
-
-	        crc <<= 1;              /* Left shift CRC register */
-
-	        // Check if XOR operation of MSBs results in additional XOR operations
-	        if (dataMSb ^ crcMSb)
-	        {
-	            crc ^= poly;        /* XOR crc with polynomial */
-	        }
-
-	        /* Shift MSb pointer to the next data bit */
-	        bitIndex >>= 1;
-	    }
-	}
+    // Odd trailing byte
+    if (numberBytes)
+    {
+        crc = (crc << 8) ^ crcTable[((crc >> 8) ^ dataBytes[0]) & 0xFF];
+    }
 
-	return crc;
+    return (uint16_t) crc;
 }
 
 
@@ -761,6 +1275,8 @@ void restoreRegisterDefaults(void)
     registerMap[CH7_GCAL_LSB_ADDRESS]   =   CH7_GCAL_LSB_DEFAULT;
 #endif
     registerMap[REGMAP_CRC_ADDRESS]     =   REGMAP_CRC_DEFAULT;
+
+    updateDerivedSettings(0, NUM_REGISTERS);
 }
 
 
@@ -849,40 +1365,182 @@ uint16_t combineBytes(uint8_t upperByte, uint8_t lowerByte)
 //*****************************************************************************
 int32_t signExtend(const uint8_t dataBytes[])
 {
+    // Decoding is selected at compile time by the WORD_LENGTH_* define
+    return DECODE_DATA_WORD(dataBytes);
+}
 
-#ifdef WORD_LENGTH_24BIT
 
-    int32_t upperByte   = ((int32_t) dataBytes[0] << 24);
-    int32_t middleByte  = ((int32_t) dataBytes[1] << 16);
-    int32_t lowerByte   = ((int32_t) dataBytes[2] << 8);
 
-    return (((int32_t) (upperByte | middleByte | lowerByte)) >> 8);     // Right-shift of signed data maintains signed bit
+//*****************************************************************************
+//
+//! Sign-extends every channel data word of a received data frame.
+//!
+//! \fn void signExtendFrame(const uint8_t frame[], int32_t channel[])
+//!
+//! \param frame[] complete data frame as received (FRAME_BYTES long, response
+//! word first).
+//! \param channel[] array of CHANNEL_COUNT codes to fill.
+//!
+//! NOTE: Each word is loaded as a full 32-bit word, which may read past the
+//! end of a 16- or 24-bit data word. That stays inside the frame, because the
+//! CRC word follows the last channel word.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void signExtendFrame(const uint8_t frame[], int32_t channel[])
+{
+    const uint8_t *word = &frame[WORD_BYTES];
+    uint8_t i;
 
-#elif defined WORD_LENGTH_32BIT_SIGN_EXTEND
+    for (i = 0; i < CHANNEL_COUNT; i++)
+    {
+        channel[i] = DECODE_DATA_WORD_FAST(word);
+        word += WORD_BYTES;
+    }
+}
 
-    int32_t signByte    = ((int32_t) dataBytes[0] << 24);
-    int32_t upperByte   = ((int32_t) dataBytes[1] << 16);
-    int32_t middleByte  = ((int32_t) dataBytes[2] << 8);
-    int32_t lowerByte   = ((int32_t) dataBytes[3] << 0);
 
-    return (signByte | upperByte | middleByte | lowerByte);
 
-#elif defined WORD_LENGTH_32BIT_ZERO_PADDED
+//****************************************************************************
+//
+// Scaling functions
+//
+//****************************************************************************
+
+
+//*****************************************************************************
+//
+//! Returns the code-to-microvolt multiplier of a channel for its current PGA
+//! gain (see SCALE_SHIFT in ads131m0x.h).
+//!
+//! \fn int32_t getChannelScale(uint8_t channel)
+//!
+//! \param channel is the channel number.
+//!
+//! \return multiplier for codeToMicrovolts().
+//
+//*****************************************************************************
+int32_t getChannelScale(uint8_t channel)
+{
+    assert(channel < CHANNEL_COUNT);
+    return channelScale[channel];
+}
 
-    int32_t upperByte   = ((int32_t) dataBytes[0] << 24);
-    int32_t middleByte  = ((int32_t) dataBytes[1] << 16);
-    int32_t lowerByte   = ((int32_t) dataBytes[2] << 8);
 
-    return (((int32_t) (upperByte | middleByte | lowerByte)) >> 8);     // Right-shift of signed data maintains signed bit
 
-#elif defined WORD_LENGTH_16BIT_TRUNCATED
+//*****************************************************************************
+//
+//! Converts a conversion code to microvolts at the ADC input.
+//!
+//! \fn int32_t codeToMicrovolts(int32_t code, int32_t multiplier)
+//!
+//! \param code is a sign-extended conversion code.
+//! \param multiplier is the channel multiplier from getChannelScale().
+//!
+//! NOTE: This is one 32x32->64-bit multiply (SMULL) and a shift, rounded to
+//! the nearest microvolt; no floating point is involved.
+//!
+//! \return input voltage in microvolts.
+//
+//*****************************************************************************
+int32_t codeToMicrovolts(int32_t code, int32_t multiplier)
+{
+    int64_t product = (int64_t) code * multiplier;
+
+    return (int32_t) ((product + ((int64_t) 1 << (SCALE_SHIFT - 1))) >> SCALE_SHIFT);
+}
 
-    int32_t upperByte   = ((int32_t) dataBytes[0] << 24);
-    int32_t lowerByte   = ((int32_t) dataBytes[1] << 16);
 
-    return (((int32_t) (upperByte | lowerByte)) >> 16);                 // Right-shift of signed data maintains signed bit
 
-#endif
+//*****************************************************************************
+//
+//! Converts every enabled channel of a conversion to microvolts.
+//!
+//! \fn void convertToMicrovolts(const adc_channel_data *DataStruct, int32_t microvolts[])
+//!
+//! \param DataStruct conversion as returned by readData().
+//! \param microvolts[] array of CHANNEL_COUNT results to fill; disabled
+//! channels are set to zero.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void convertToMicrovolts(const adc_channel_data *DataStruct, int32_t microvolts[])
+{
+    uint8_t i;
+
+    for (i = 0; i < CHANNEL_COUNT; i++)
+    {
+        microvolts[i] = (DataStruct->channelMask & (1u << i)) ?
+                        codeToMicrovolts(DataStruct->channel[i], channelScale[i]) : 0;
+    }
+}
+
+
+
+//****************************************************************************
+//
+// Data rate functions
+//
+//****************************************************************************
+
+
+//*****************************************************************************
+//
+//! Sets the oversampling ratio and power mode, and with them the output data
+//! rate.
+//!
+//! \fn bool setDataRate(uint16_t osr, uint16_t powerMode)
+//!
+//! \param osr is the oversampling ratio: 128, 256, 512, ... 8192, or 16256.
+//! \param powerMode is one of the CLOCK_PWR_* field values.
+//!
+//! Any other staged register changes are committed as well. The new timing is
+//! available from getAdcTiming() once this function returns.
+//!
+//! NOTE: The data rate is CLKIN_FREQUENCY_HZ / (2 * OSR) in every power mode.
+//! LP mode is only specified up to MAX_CLKIN_LP_HZ and VLP mode up to
+//! MAX_CLKIN_VLP_HZ, so they are rejected when CLKIN_FREQUENCY_HZ is higher.
+//!
+//! \return true if the arguments are invalid or the registers could not be verified.
+//
+//*****************************************************************************
+bool setDataRate(uint16_t osr, uint16_t powerMode)
+{
+    uint16_t osrCode = 0;
+    while ((osrCode < 7) && (OSR_FROM_CODE(osrCode) < osr)) { osrCode++; }
+
+    uint32_t maxClkin_Hz = (powerMode == CLOCK_PWR_VLP) ? MAX_CLKIN_VLP_HZ :
+                           (powerMode == CLOCK_PWR_LP)  ? MAX_CLKIN_LP_HZ  : CLKIN_FREQUENCY_HZ;
+
+    if ((OSR_FROM_CODE(osrCode) != osr) || (powerMode & ~CLOCK_PWR_MASK) || (CLKIN_FREQUENCY_HZ > maxClkin_Hz))
+    {
+        return true;
+    }
+
+    setOversamplingRatio((osrCode << 2) & CLOCK_OSR_MASK);
+    setPowerMode(powerMode);
+
+    return commitRegisters();
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the conversion timing of the current CLOCK register settings.
+//!
+//! \fn void getAdcTiming(adc_timing *timingOut)
+//!
+//! \param *timingOut points to the structure to fill.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void getAdcTiming(adc_timing *timingOut)
+{
+    *timingOut = timing;
 }
 
 
@@ -933,7 +1591,7 @@ uint8_t buildSPIarray(const uint16_t opcodeArray[], uint8_t numberOpcodes, uint8
 
 #ifdef ENABLE_CRC_IN
     // Calculate CRC and put it into TX array
-    uint16_t crcWord = calculateCRC(&byteArray[0], numberOfBytes, 0xFFFF);
+    uint16_t crcWord = calculateCRC(&byteArray[0], numberOpcodes * bytesPerWord, 0xFFFF);
     byteArray[(i*bytesPerWord) + 0] = upperByte(crcWord);
     byteArray[(i*bytesPerWord) + 1] = lowerByte(crcWord);
 #endif
@@ -971,6 +1629,18 @@ uint16_t enforce_selected_device_modes(uint16_t data)
 #endif // ENABLE_CRC_IN
 
 
+    ///////////////////////////////////////////////////////////////////////////
+    // Enforce REG_CRC_EN setting
+
+#ifdef ENABLE_REGMAP_CRC
+    // When writing to the MODE register, ensure REG_CRC_EN bit is ALWAYS set
+    data |= MODE_REG_CRC_EN_ENABLED;
+#else
+    // When writing to the MODE register, ensure REG_CRC_EN bit is NEVER set
+    data &= ~MODE_REG_CRC_EN_ENABLED;
+#endif // ENABLE_REGMAP_CRC
+
+
     ///////////////////////////////////////////////////////////////////////////
     // Enforce WLENGH setting
 
@@ -1035,3 +1705,116 @@ uint8_t getWordByteLength(void)
 {
     return wlength_byte_values[WLENGTH];
 }
+
+
+
+//*****************************************************************************
+//
+//! Recomputes the values derived from registerMap[] after some registers
+//! changed.
+//!
+//! \fn void updateDerivedSettings(uint8_t startAddress, uint8_t count)
+//!
+//! \param startAddress is the address of the first changed register.
+//! \param count is the number of changed registers.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void updateDerivedSettings(uint8_t startAddress, uint8_t count)
+{
+    uint8_t lastAddress = startAddress + count - 1;
+
+    if ((startAddress <= GAIN2_ADDRESS) && (lastAddress >= GAIN1_ADDRESS))
+    {
+        updateChannelScales();
+    }
+    if ((startAddress <= CLOCK_ADDRESS) && (lastAddress >= CLOCK_ADDRESS))
+    {
+        updateTiming();
+        channelEnableMask = (uint8_t) (registerMap[CLOCK_ADDRESS] >> CLOCK_CH_EN_SHIFT) & ALL_CHANNELS_MASK;
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Recomputes the code-to-microvolt multiplier of every channel from the PGA
+//! gain fields in registerMap[GAIN1_ADDRESS] and registerMap[GAIN2_ADDRESS].
+//!
+//! \fn void updateChannelScales(void)
+//!
+//! \return None.
+//
+//*****************************************************************************
+void updateChannelScales(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < CHANNEL_COUNT; i++)
+    {
+        // Channels 0-3 are in GAIN1 and 4-7 in GAIN2, 4 bits per channel; the
+        // 3-bit PGAGAIN field is log2 of the gain.
+        uint16_t gainRegister = (i < 4) ? registerMap[GAIN1_ADDRESS] : registerMap[GAIN2_ADDRESS];
+        uint8_t  gainCode = (uint8_t) ((gainRegister >> (4 * (i % 4))) & GAIN1_PGAGAIN0_MASK);
+
+        channelScale[i] = SCALE_MULTIPLIER_GAIN1 >> gainCode;
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Recomputes the conversion timing from the OSR and PWR fields in
+//! registerMap[CLOCK_ADDRESS].
+//!
+//! \fn void updateTiming(void)
+//!
+//! \return None.
+//
+//*****************************************************************************
+void updateTiming(void)
+{
+    uint16_t clock = registerMap[CLOCK_ADDRESS];
+
+    // fDATA = fCLKIN / (2 * OSR)
+    uint16_t osr = OSR_FROM_CODE((clock & CLOCK_OSR_MASK) >> 2);
+    uint32_t period_ns = (uint32_t) (((2ull * osr * 1000000000ull) + (CLKIN_FREQUENCY_HZ / 2)) / CLKIN_FREQUENCY_HZ);
+    uint32_t transfer_ns = (uint32_t) ((FRAME_BYTES * 8ull * 1000000000ull) / SPI_IF_BIT_RATE);
+
+    timing.osr              = osr;
+    timing.powerMode        = clock & CLOCK_PWR_MASK;
+    timing.dataRate_Hz      = (CLKIN_FREQUENCY_HZ + osr) / (2ul * osr);
+    timing.drdyPeriod_ns    = period_ns;
+    timing.frameBudget_ns   = (period_ns > transfer_ns) ? (period_ns - transfer_ns) : 0;
+}
+
+
+
+//*****************************************************************************
+//
+//! Calculates the CRC the device reports in REGMAP_CRC from registerMap[].
+//!
+//! \fn uint16_t calculateRegisterMapCRC(void)
+//!
+//! The register map CRC covers the MODE through the last channel registers,
+//! most-significant byte first, with the CRC type selected in ads131m0x.h.
+//!
+//! \return 16-bit CRC.
+//
+//*****************************************************************************
+uint16_t calculateRegisterMapCRC(void)
+{
+    uint16_t crc = 0xFFFF;
+    uint8_t address;
+
+    for (address = FIRST_CONFIG_ADDRESS; address <= LAST_CONFIG_ADDRESS; address++)
+    {
+        const uint8_t word[2] = { upperByte(registerMap[address]), lowerByte(registerMap[address]) };
+        crc = calculateCRC(word, 2, crc);
+    }
+
+    return crc;
+}
@@ -78,9 +78,16 @@
 /* Enable this define statement to use CRC on DIN... */
 //#define ENABLE_CRC_IN
 
-/* Select CRC type */
+/* Enable this define statement to have the device keep REGMAP_CRC up to date;
+ * commitRegisters() then verifies the register map with a single register read... */
+#define ENABLE_REGMAP_CRC
+
+/* Select CRC type (or define one on the compiler command line, as the host
+ * CRC test does to build both) */
+#if !defined CRC_CCITT && !defined CRC_ANSI
 #define CRC_CCITT
 //#define CRC_ANSI
+#endif
 
 /* Disable assertions when not in the CCS "Debug" configuration */
 #ifndef _DEBUG
@@ -100,6 +107,12 @@
 #error Must define at least one WORD_LENGTH mode
 #endif
 
+// Throw an error if more than one WORD_LENGTH mode was selected above
+#if (defined WORD_LENGTH_16BIT_TRUNCATED + defined WORD_LENGTH_24BIT + \
+     defined WORD_LENGTH_32BIT_SIGN_EXTEND + defined WORD_LENGTH_32BIT_ZERO_PADDED) > 1
+#error Must define only one WORD_LENGTH mode
+#endif
+
 // Throw an error if none or both CRC types are selected
 #if !defined CRC_CCITT && !defined CRC_ANSI
 #error Must define at least one CRC type
@@ -118,6 +131,71 @@
 
 #define NUM_REGISTERS                           ((uint8_t) 64)
 
+/* Data frame: response word + one word per channel + CRC word */
+#define FRAME_WORDS                             ((uint8_t) (CHANNEL_COUNT + 2))
+#define MAX_FRAME_BYTES                         ((uint8_t) (FRAME_WORDS * 4))
+
+/* Bytes per SPI word for the selected WORD_LENGTH mode. The device is always
+ * configured for this mode (see enforce_selected_device_modes()), so readData()
+ * decodes frames with these constants instead of reading WLENGTH at run time.
+ */
+#ifdef WORD_LENGTH_16BIT_TRUNCATED
+#define WORD_BYTES                              ((uint8_t) 2)
+#elif defined WORD_LENGTH_24BIT
+#define WORD_BYTES                              ((uint8_t) 3)
+#else
+#define WORD_BYTES                              ((uint8_t) 4)
+#endif
+
+#define FRAME_BYTES                             ((uint8_t) (FRAME_WORDS * WORD_BYTES))
+
+/* Configuration registers: MODE through the last channel's GCAL_LSB register */
+#define FIRST_CONFIG_ADDRESS                    (MODE_ADDRESS)
+#define LAST_CONFIG_ADDRESS                     ((uint8_t) (CH0_CFG_ADDRESS + (5 * CHANNEL_COUNT) - 1))
+
+/* Most registers moved by one multiple-register RREG/WREG frame. The frame
+ * (acknowledge or opcode word, register words and CRC word) must fit in the
+ * 8-bit byte count of spiSendReceiveArrays() at 4 bytes per word.
+ */
+#define MAX_REGISTERS_PER_FRAME                 ((uint8_t) ((255 / 4) - 2))
+#define MAX_REGISTER_FRAME_BYTES                ((uint8_t) ((MAX_REGISTERS_PER_FRAME + 2) * 4))
+
+/* Fixed-point scaling of conversion codes: uV = (code * multiplier) >> SCALE_SHIFT
+ *
+ * One LSB is 2 * VREF / gain / 2^CODE_BITS. With SCALE_SHIFT = CODE_BITS + 7,
+ * the multiplier at gain 1 is 2 * VREF(uV) * 2^7 = 307200000, and halving it
+ * for each PGA gain step is exact up to a gain of 128.
+ */
+#define REFERENCE_UV                            ((int32_t) 1200000)
+
+#ifdef WORD_LENGTH_16BIT_TRUNCATED
+#define CODE_BITS                               ((uint8_t) 16)
+#else
+#define CODE_BITS                               ((uint8_t) 24)
+#endif
+
+#define SCALE_SHIFT                             ((uint8_t) (CODE_BITS + 7))
+#define SCALE_MULTIPLIER_GAIN1                  ((int32_t) (2 * REFERENCE_UV) << 7)
+
+/* Oversampling ratio range (CLOCK_OSR_128 to CLOCK_OSR_16256) */
+#define MIN_OSR                                 ((uint16_t) 128)
+#define MAX_OSR                                 ((uint16_t) 16256)
+
+/* Oversampling ratio of a 3-bit CLOCK OSR code: 128 << code, except that
+ * the last code selects 16256 rather than 16384 */
+#define OSR_FROM_CODE(code)                     ((uint16_t) (((code) == 7u) ? MAX_OSR : (MIN_OSR << (code))))
+
+/* Highest CLKIN frequency of the low-power modes; HR mode runs up to 8.192 MHz */
+#define MAX_CLKIN_LP_HZ                         ((uint32_t) 4096000)
+#define MAX_CLKIN_VLP_HZ                        ((uint32_t) 2048000)
+
+/* Channel enable mask: bit n enables channel n (CLOCK CHn_EN, bits 8 to 15).
+ * A disabled channel is powered down but keeps its word in every data frame:
+ * channels are identified by word position and CRC-OUT covers the whole frame.
+ */
+#define ALL_CHANNELS_MASK                       ((uint8_t) ((1u << CHANNEL_COUNT) - 1))
+#define CLOCK_CH_EN_SHIFT                       (8)
+
 
 
 //****************************************************************************
@@ -471,7 +549,7 @@
     #define CLOCK_OSR_2048                                                  ((uint16_t) 0x0004 << 2)
     #define CLOCK_OSR_4096                                                  ((uint16_t) 0x0005 << 2)
     #define CLOCK_OSR_8192                                                  ((uint16_t) 0x0006 << 2)
-    #define CLOCK_OSR_16384                                                 ((uint16_t) 0x0007 << 2)
+    #define CLOCK_OSR_16256                                                 ((uint16_t) 0x0007 << 2)
 
     /* PWR field mask & values */
     #define CLOCK_PWR_MASK                                                  ((uint16_t) 0x0003)
@@ -1594,33 +1672,29 @@ typedef struct
 {
     uint16_t response;
     uint16_t crc;
-    int32_t channel0;
-
-#if (CHANNEL_COUNT > 1)
-    int32_t channel1;
-#endif
-#if (CHANNEL_COUNT > 2)
-    int32_t channel2;
-#endif
-#if (CHANNEL_COUNT > 3)
-    int32_t channel3;
-#endif
-#if (CHANNEL_COUNT > 4)
-    int32_t channel4;
-#endif
-#if (CHANNEL_COUNT > 5)
-    int32_t channel5;
-#endif
-#if (CHANNEL_COUNT > 6)
-    int32_t channel6;
- #endif
- #if (CHANNEL_COUNT > 7)
-    int32_t channel7;
-#endif
+    uint8_t channelMask;                // Channels enabled for this conversion, bit n = channel n
+    int32_t channel[CHANNEL_COUNT];     // Sign-extended codes, index = channel number
 } adc_channel_data;
 
 
 
+//****************************************************************************
+//
+// Conversion timing structure
+//
+//****************************************************************************
+
+typedef struct
+{
+    uint16_t osr;               // Oversampling ratio, MIN_OSR to MAX_OSR
+    uint16_t powerMode;         // CLOCK_PWR_* field value
+    uint32_t dataRate_Hz;       // Output data rate, rounded to the nearest Hz
+    uint32_t drdyPeriod_ns;     // Time between two conversions
+    uint32_t frameBudget_ns;    // DRDY period left after clocking out one data frame
+} adc_timing;
+
+
+
 //****************************************************************************
 //
 // Function prototypes
@@ -1632,6 +1706,24 @@ uint16_t    sendCommand(uint16_t op_code);
 bool        readData(adc_channel_data *DataStruct);
 uint16_t    readSingleRegister(uint8_t address);
 void        writeSingleRegister(uint8_t address, uint16_t data);
+bool        readMultipleRegisters(uint8_t startAddress, uint8_t count);
+void        writeMultipleRegisters(uint8_t startAddress, uint8_t count, const uint16_t regData[]);
+bool        applyRegisterConfig(const uint16_t config[]);
+
+// Data rate functions
+bool        setDataRate(uint16_t osr, uint16_t powerMode);
+void        getAdcTiming(adc_timing *timingOut);
+
+// Shadow register map functions
+void        stageRegister(uint8_t address, uint16_t data);
+void        stageRegisterField(uint8_t address, uint16_t mask, uint16_t value);
+uint16_t    getStagedRegisterValue(uint8_t address);
+void        setChannelGain(uint8_t channel, uint8_t gain);
+void        setOversamplingRatio(uint16_t osr);
+void        setPowerMode(uint16_t pwr);
+void        setChannelEnableMask(uint8_t mask);
+void        discardRegisterChanges(void);
+bool        commitRegisters(void);
 bool        lockRegisters(void);
 bool        unlockRegisters(void);
 void        resetDevice(void);
@@ -1640,12 +1732,19 @@ uint16_t    calculateCRC(const uint8_t dataBytes[], uint8_t numberBytes, uint16_
 
 // Getter functions
 uint16_t    getRegisterValue(uint8_t address);
+uint8_t     getChannelEnableMask(void);
 
 // Helper functions
 uint8_t     upperByte(uint16_t uint16_Word);
 uint8_t     lowerByte(uint16_t uint16_Word);
 uint16_t    combineBytes(uint8_t upperByte, uint8_t lowerByte);
 int32_t     signExtend(const uint8_t dataBytes[]);
+void        signExtendFrame(const uint8_t frame[], int32_t channel[]);
+
+// Scaling functions
+int32_t     getChannelScale(uint8_t channel);
+int32_t     codeToMicrovolts(int32_t code, int32_t multiplier);
+void        convertToMicrovolts(const adc_channel_data *DataStruct, int32_t microvolts[]);
 
 
 
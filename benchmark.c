@@ -0,0 +1,602 @@
+/**
+ * \brief Throughput and latency measurements of the acquisition pipeline
+ * (see benchmark.h).
+ */
+
+#include "benchmark.h"
+
+#ifdef ENABLE_BENCHMARK
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "adc_stream.h"
+#include "sample_ring.h"
+
+
+
+//****************************************************************************
+//
+// Internal macros
+//
+//****************************************************************************
+
+#if (BENCH_TRACKED_CONVERSIONS & (BENCH_TRACKED_CONVERSIONS - 1))
+#error "BENCH_TRACKED_CONVERSIONS must be a power of two"
+#endif
+
+#define TRACKED_INDEX(n)    ((n) & (BENCH_TRACKED_CONVERSIONS - 1))
+
+/* Report lines: three summary lines, then statistics and histogram of each stage */
+#define SUMMARY_LINES       (3U)
+#define REPORT_LINES        (SUMMARY_LINES + (2U * BENCH_STAGE_COUNT))
+
+/* Number of leading zero bits of a non-zero word (CLZ instruction on the target) */
+#if defined(__TI_COMPILER_VERSION__)
+#define COUNT_LEADING_ZEROS(x)  _norm(x)
+#else
+#define COUNT_LEADING_ZEROS(x)  ((uint32_t) __builtin_clz(x))
+#endif
+
+
+
+//****************************************************************************
+//
+// Internal variables
+//
+//****************************************************************************
+
+static const char * const stageNames[BENCH_STAGE_COUNT] = {
+    "DRDY ISR", "DRDY to task", "readData", "SPI frame", "CRC check", "scaling", "packetizer", "encoder",
+    "send"
+};
+
+// Per-stage statistics and histograms; each stage is written by one task (or the ISR) only
+static bench_stage_stats    stages[BENCH_STAGE_COUNT];
+static uint32_t             stageHistograms[BENCH_STAGE_COUNT][BENCH_STAGE_BUCKETS];
+
+// /DRDY timestamp of each conversion still in the pipeline, indexed by sequence
+static uint32_t             drdyTimestamps[BENCH_TRACKED_CONVERSIONS];
+
+// End-to-end latency histogram; written by the sender task
+static uint32_t             latencyHistogram[BENCH_LATENCY_BUCKETS];
+static uint32_t             latencyMax_cycles;
+
+// Counters; conversions and crcErrors are written by the acquisition task, sent by the sender task
+static volatile uint32_t    conversions;
+static volatile uint32_t    crcErrors;
+static volatile uint32_t    sent;
+
+// Compression of the packets; written by the sender task
+static uint32_t             encodedSamples;
+static uint64_t             rawPacketBytes;
+static uint64_t             encodedPacketBytes;
+
+// Set by benchRequestReport(), cleared when the sender task picks it up
+static volatile bool        reportRequested;
+
+// Reference points taken by benchReset()
+static uint32_t             startDrdyEvents;
+static uint32_t             startOverflows;
+static uint32_t             lastCycles;
+static uint64_t             elapsedCycles;
+
+
+
+//****************************************************************************
+//
+// Internal function prototypes
+//
+//****************************************************************************
+
+static void     updateElapsed(void);
+static uint32_t stageBucket(uint32_t cycles);
+static void     formatHistogram(bench_stage stage, char *buffer, uint16_t size);
+static uint32_t latencyBucket(uint32_t cycles);
+static uint64_t bucketLimit(uint32_t bucket);
+static uint32_t latencyPercentile(uint32_t percent, uint32_t frequency);
+static uint32_t cyclesToMicroseconds(uint64_t cycles, uint32_t frequency);
+
+
+
+//*****************************************************************************
+//
+//! Clears every statistic and starts a new measurement.
+//!
+//! \fn void benchReset(void)
+//!
+//! \return None.
+//
+//*****************************************************************************
+void benchReset(void)
+{
+    sample_ring_stats ringStats;
+    uint32_t i;
+
+    // Every conversion between /DRDY and its send needs its own timestamp slot
+    assert(BENCH_TRACKED_CONVERSIONS >= (SAMPLE_RING_SIZE + STREAM_MAX_RECORDS));
+
+    for (i = 0; i < BENCH_STAGE_COUNT; i++)
+    {
+        uint32_t bucket;
+
+        stages[i].count         = 0;
+        stages[i].min_cycles    = UINT32_MAX;
+        stages[i].max_cycles    = 0;
+        stages[i].total_cycles  = 0;
+        for (bucket = 0; bucket < BENCH_STAGE_BUCKETS; bucket++)
+        {
+            stageHistograms[i][bucket] = 0;
+        }
+    }
+    for (i = 0; i < BENCH_LATENCY_BUCKETS; i++)
+    {
+        latencyHistogram[i] = 0;
+    }
+    latencyMax_cycles = 0;
+
+    conversions = 0;
+    crcErrors   = 0;
+    sent        = 0;
+
+    encodedSamples      = 0;
+    rawPacketBytes      = 0;
+    encodedPacketBytes  = 0;
+
+    sampleRingGetStats(&ringStats);
+    startDrdyEvents = getDRDYinterruptCount();
+    startOverflows  = ringStats.overflows;
+    lastCycles      = getCycleCount();
+    elapsedCycles   = 0;
+}
+
+
+
+//*****************************************************************************
+//
+//! Adds one run of a pipeline stage.
+//!
+//! \fn void benchAddStage(bench_stage stage, uint32_t cycles)
+//!
+//! \param stage pipeline stage.
+//! \param cycles duration of the run in getCycleCount() counts.
+//!
+//! Short enough to be called from the /DRDY interrupt handler.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void benchAddStage(bench_stage stage, uint32_t cycles)
+{
+    bench_stage_stats *stats = &stages[stage];
+
+    // The first run also sets the minimum, so that runs before benchReset() count
+    stats->count++;
+    stats->total_cycles += cycles;
+    if ((stats->count == 1) || (cycles < stats->min_cycles)) { stats->min_cycles = cycles; }
+    if (cycles > stats->max_cycles) { stats->max_cycles = cycles; }
+
+    stageHistograms[stage][stageBucket(cycles)]++;
+}
+
+
+
+//*****************************************************************************
+//
+//! Records a conversion read by the acquisition task.
+//!
+//! \fn void benchAddConversion(uint32_t sequence, uint32_t readStart, bool crcError)
+//!
+//! \param sequence sequence number given to the conversion.
+//! \param readStart getCycleCount() just before readData().
+//! \param crcError return value of readData().
+//!
+//! Adds the BENCH_STAGE_WAKE time and remembers the /DRDY timestamp for the
+//! latency measured by benchAddSent().
+//!
+//! \return None.
+//
+//*****************************************************************************
+void benchAddConversion(uint32_t sequence, uint32_t readStart, bool crcError)
+{
+    uint32_t drdy = getDRDYtimestamp();
+
+    benchAddStage(BENCH_STAGE_WAKE, readStart - drdy);
+    drdyTimestamps[TRACKED_INDEX(sequence)] = drdy;
+
+    conversions++;
+    if (crcError) { crcErrors++; }
+}
+
+
+
+//*****************************************************************************
+//
+//! Records conversions handed to the network.
+//!
+//! \fn void benchAddSent(uint32_t firstSequence, uint16_t count, uint8_t decimation, uint32_t conversions)
+//!
+//! \param firstSequence sequence number of the first record sent.
+//! \param count number of records sent (see streamRecordSequence()).
+//! \param decimation conversions per record (see streamGetDecimation()).
+//! \param conversions number of conversions averaged into the records.
+//!
+//! The latency of a record is taken from its first conversion.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void benchAddSent(uint32_t firstSequence, uint16_t count, uint8_t decimation, uint32_t conversions)
+{
+    uint32_t now = getCycleCount();
+    uint16_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        uint32_t sequence = streamRecordSequence(firstSequence, i, decimation);
+        uint32_t latency = now - drdyTimestamps[TRACKED_INDEX(sequence)];
+
+        latencyHistogram[latencyBucket(latency)]++;
+        if (latency > latencyMax_cycles) { latencyMax_cycles = latency; }
+    }
+
+    sent += conversions;
+    updateElapsed();
+}
+
+
+
+//*****************************************************************************
+//
+//! Records a packet passed through streamBatchEncode().
+//!
+//! \fn void benchAddEncoded(uint32_t samples, uint16_t rawBytes, uint16_t bytes)
+//!
+//! \param samples codes in the packet: records times channels.
+//! \param rawBytes size of the packet before encoding.
+//! \param bytes size of the packet after encoding.
+//!
+//! The BENCH_STAGE_ENCODE time of the packet divided by samples gives the
+//! encoder cycles per sample.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void benchAddEncoded(uint32_t samples, uint16_t rawBytes, uint16_t bytes)
+{
+    encodedSamples += samples;
+    rawPacketBytes += rawBytes;
+    encodedPacketBytes += bytes;
+}
+
+
+
+//*****************************************************************************
+//
+//! Summarizes the statistics collected since benchReset().
+//!
+//! \fn void benchGetReport(bench_report *report)
+//!
+//! \param report pointer to the report to fill.
+//!
+//! NOTE: Call from the sender task, or at least once per wrap-around period
+//! of getCycleCount(), to keep the elapsed time correct.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void benchGetReport(bench_report *report)
+{
+    sample_ring_stats ringStats;
+    uint32_t frequency = getCycleFrequency();
+    uint32_t i;
+
+    updateElapsed();
+    sampleRingGetStats(&ringStats);
+
+    report->cycleFrequency  = frequency;
+    report->elapsed_us      = ((elapsedCycles / frequency) * 1000000u) + (((elapsedCycles % frequency) * 1000000u) / frequency);
+    report->drdyEvents      = getDRDYinterruptCount() - startDrdyEvents;
+    report->conversions     = conversions;
+    report->crcErrors       = crcErrors;
+    report->overflows       = ringStats.overflows - startOverflows;
+    report->sent            = sent;
+    report->dropped         = (report->drdyEvents - report->conversions) + report->crcErrors + report->overflows;
+    report->samplesPerSecond = report->elapsed_us ? (uint32_t) (((uint64_t) sent * 1000000u) / report->elapsed_us) : 0;
+
+    report->latencyP50_us   = latencyPercentile(50, frequency);
+    report->latencyP90_us   = latencyPercentile(90, frequency);
+    report->latencyP99_us   = latencyPercentile(99, frequency);
+    report->latencyMax_us   = cyclesToMicroseconds(latencyMax_cycles, frequency);
+
+    report->encodedSamples  = encodedSamples;
+    report->rawBytes        = rawPacketBytes;
+    report->encodedBytes    = encodedPacketBytes;
+
+    for (i = 0; i < BENCH_STAGE_COUNT; i++)
+    {
+        report->stage[i] = stages[i];
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Formats one line of a report as text.
+//!
+//! \fn bool benchFormatReportLine(const bench_report *report, uint16_t line, char *buffer, uint16_t size)
+//!
+//! \param report report filled by benchGetReport().
+//! \param line line number, counting from 0.
+//! \param buffer destination of the null-terminated line, without line ending.
+//! \param size size of buffer; BENCH_REPORT_LINE_BYTES holds any line.
+//!
+//! Lines start with "bench: ". The first three summarize throughput, latency
+//! and compression (empty until a packet was encoded); each stage then has a
+//! line of statistics and a line with its histogram, which is read from the
+//! live counters rather than from the report. Lines of stages that never ran
+//! are empty.
+//!
+//! \return false once line is past the last line of the report.
+//
+//*****************************************************************************
+bool benchFormatReportLine(const bench_report *report, uint16_t line, char *buffer, uint16_t size)
+{
+    if (line >= REPORT_LINES) { return false; }
+
+    buffer[0] = '\0';
+    if (line == 0)
+    {
+        snprintf(buffer, size, "bench: %u samples/s, %u sent, %u dropped (%u DRDY, %u CRC, %u ring) in %u ms",
+                 (unsigned int) report->samplesPerSecond, (unsigned int) report->sent,
+                 (unsigned int) report->dropped, (unsigned int) (report->drdyEvents - report->conversions),
+                 (unsigned int) report->crcErrors, (unsigned int) report->overflows,
+                 (unsigned int) (report->elapsed_us / 1000u));
+        return true;
+    }
+    if (line == 1)
+    {
+        snprintf(buffer, size, "bench: latency p50 %u us, p90 %u us, p99 %u us, max %u us, %u cycles/s",
+                 (unsigned int) report->latencyP50_us, (unsigned int) report->latencyP90_us,
+                 (unsigned int) report->latencyP99_us, (unsigned int) report->latencyMax_us,
+                 (unsigned int) report->cycleFrequency);
+        return true;
+    }
+    if (line == 2)
+    {
+        const bench_stage_stats *encoder = &report->stage[BENCH_STAGE_ENCODE];
+
+        if ((report->encodedSamples == 0) || (report->encodedBytes == 0)) { return true; }
+
+        // Ratio in hundredths and cycles in tenths, without floating point
+        uint32_t ratio = (uint32_t) ((report->rawBytes * 100u) / report->encodedBytes);
+        uint32_t cycles = (uint32_t) ((encoder->total_cycles * 10u) / report->encodedSamples);
+
+        snprintf(buffer, size, "bench: encoding %u samples, %u bytes to %u, ratio %u.%02u, %u.%u cycles/sample",
+                 (unsigned int) report->encodedSamples, (unsigned int) report->rawBytes,
+                 (unsigned int) report->encodedBytes, (unsigned int) (ratio / 100u), (unsigned int) (ratio % 100u),
+                 (unsigned int) (cycles / 10u), (unsigned int) (cycles % 10u));
+        return true;
+    }
+
+    bench_stage stage = (bench_stage) ((line - SUMMARY_LINES) / 2);
+    const bench_stage_stats *stats = &report->stage[stage];
+
+    if (stats->count == 0) { return true; }
+
+    if (((line - SUMMARY_LINES) % 2) == 0)
+    {
+        snprintf(buffer, size, "bench: %s: %u runs, cycles min %u avg %u max %u",
+                 stageNames[stage], (unsigned int) stats->count, (unsigned int) stats->min_cycles,
+                 (unsigned int) (stats->total_cycles / stats->count), (unsigned int) stats->max_cycles);
+    }
+    else
+    {
+        formatHistogram(stage, buffer, size);
+    }
+    return true;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the printable name of a pipeline stage.
+//!
+//! \fn const char *benchStageName(bench_stage stage)
+//!
+//! \param stage pipeline stage.
+//!
+//! \return Null-terminated name.
+//
+//*****************************************************************************
+const char *benchStageName(bench_stage stage)
+{
+    return stageNames[stage];
+}
+
+
+
+//*****************************************************************************
+//
+//! Asks the sender task to send a report to the websocket client.
+//!
+//! \fn void benchRequestReport(void)
+//!
+//! \return None.
+//
+//*****************************************************************************
+void benchRequestReport(void)
+{
+    reportRequested = true;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns whether a report was requested, and clears the request.
+//!
+//! \fn bool benchReportRequested(void)
+//!
+//! \return true once for each call of benchRequestReport().
+//
+//*****************************************************************************
+bool benchReportRequested(void)
+{
+    if (!reportRequested) { return false; }
+
+    reportRequested = false;
+    return true;
+}
+
+
+
+//****************************************************************************
+//
+// Internal functions
+//
+//****************************************************************************
+
+
+//*****************************************************************************
+//
+//! Adds the time since the last call to the elapsed time.
+//
+//*****************************************************************************
+static void updateElapsed(void)
+{
+    uint32_t now = getCycleCount();
+
+    elapsedCycles += (uint32_t) (now - lastCycles);
+    lastCycles = now;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the histogram bucket of a stage duration: the number of significant
+//! bits of the cycle count.
+//
+//*****************************************************************************
+static uint32_t stageBucket(uint32_t cycles)
+{
+    return cycles ? (32u - COUNT_LEADING_ZEROS(cycles)) : 0;
+}
+
+
+
+//*****************************************************************************
+//
+//! Writes the non-empty histogram buckets of a stage as "<lowest cycles>+ <runs>"
+//! pairs; pairs that do not fit in the buffer are left out.
+//
+//*****************************************************************************
+static void formatHistogram(bench_stage stage, char *buffer, uint16_t size)
+{
+    int length = snprintf(buffer, size, "bench: %s histogram:", stageNames[stage]);
+    uint32_t bucket;
+
+    for (bucket = 0; (bucket < BENCH_STAGE_BUCKETS) && (length >= 0) && (length < size); bucket++)
+    {
+        uint32_t runs = stageHistograms[stage][bucket];
+        uint32_t lowest = bucket ? (1ul << (bucket - 1)) : 0;
+
+        if (runs == 0) { continue; }
+
+        int added = snprintf(&buffer[length], size - length, " %lu+ %lu",
+                             (unsigned long) lowest, (unsigned long) runs);
+        if ((added < 0) || (added >= (size - length)))
+        {
+            // Drop the partial pair
+            buffer[length] = '\0';
+            break;
+        }
+        length += added;
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the histogram bucket of a latency: values below two octaves have
+//! a bucket each, larger values keep their BENCH_BUCKETS_PER_OCTAVE leading
+//! steps.
+//
+//*****************************************************************************
+static uint32_t latencyBucket(uint32_t cycles)
+{
+    uint32_t shift = 0;
+
+    while (cycles >= (2 * BENCH_BUCKETS_PER_OCTAVE))
+    {
+        cycles >>= 1;
+        shift++;
+    }
+    return (shift * BENCH_BUCKETS_PER_OCTAVE) + cycles;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the largest latency that falls into a bucket.
+//
+//*****************************************************************************
+static uint64_t bucketLimit(uint32_t bucket)
+{
+    if (bucket < (2 * BENCH_BUCKETS_PER_OCTAVE)) { return bucket; }
+
+    uint32_t shift = (bucket / BENCH_BUCKETS_PER_OCTAVE) - 1;
+    uint32_t step = bucket - (shift * BENCH_BUCKETS_PER_OCTAVE);
+
+    return ((uint64_t) (step + 1) << shift) - 1;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the latency in microseconds below which a percentage of the sent
+//! conversions fall (rounded up to a bucket limit).
+//
+//*****************************************************************************
+static uint32_t latencyPercentile(uint32_t percent, uint32_t frequency)
+{
+    uint64_t total = 0;
+    uint64_t seen = 0;
+    uint32_t i;
+
+    for (i = 0; i < BENCH_LATENCY_BUCKETS; i++) { total += latencyHistogram[i]; }
+    if (total == 0) { return 0; }
+
+    uint64_t target = ((total * percent) + 99) / 100;
+
+    for (i = 0; i < BENCH_LATENCY_BUCKETS; i++)
+    {
+        seen += latencyHistogram[i];
+        if (seen >= target) { break; }
+    }
+
+    uint64_t limit = bucketLimit(i);
+    if (limit > latencyMax_cycles) { limit = latencyMax_cycles; }
+
+    return cyclesToMicroseconds(limit, frequency);
+}
+
+
+
+//*****************************************************************************
+//
+//! Converts getCycleCount() counts to microseconds.
+//
+//*****************************************************************************
+static uint32_t cyclesToMicroseconds(uint64_t cycles, uint32_t frequency)
+{
+    return (uint32_t) ((cycles * 1000000u) / frequency);
+}
+
+#endif /* ENABLE_BENCHMARK */
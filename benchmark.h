@@ -0,0 +1,181 @@
+/**
+ * \brief Throughput and latency measurements of the acquisition pipeline.
+ *
+ * The pipeline is instrumented in stages, from the /DRDY interrupt to the
+ * network send:
+ *
+ *   BENCH_STAGE_ISR    /DRDY interrupt handler, from entry to exit
+ *   BENCH_STAGE_WAKE   /DRDY interrupt until the acquisition task runs
+ *   BENCH_STAGE_READ   readData(), which includes the next two stages
+ *   BENCH_STAGE_SPI    SPI transfer of one data frame
+ *   BENCH_STAGE_CRC    CRC-OUT check of one data frame
+ *   BENCH_STAGE_SCALE  convertToMicrovolts() (text format only)
+ *   BENCH_STAGE_PACK   appending one record to a packet (or text frame)
+ *   BENCH_STAGE_ENCODE streamBatchEncode() of one packet (STREAM_ENCODING_RICE only)
+ *   BENCH_STAGE_SEND   handing one packet to the network (the websocket client queues)
+ *
+ * For each stage, the number of calls, the minimum, maximum and total
+ * durations and a histogram with one bucket per octave are kept. Durations
+ * are CPU cycles from the DWT cycle counter (see CYCLE_COUNT() in hal.h).
+ * End-to-end latency (/DRDY interrupt until the packet holding the conversion
+ * was sent) goes into a finer histogram from which benchGetReport() derives
+ * percentiles. The samples encoded and the packet sizes before and after
+ * streamBatchEncode() give the compression ratio and the encoder cycles per
+ * sample. benchFormatReportLine() turns a report into text lines for the
+ * UART and for the "stats" websocket command.
+ *
+ * Stages are bracketed with the BENCH_* macros, which compile to nothing
+ * unless ENABLE_BENCHMARK is defined. Each statistic has a single writer
+ * (the /DRDY interrupt, the acquisition task or the sender task), so no
+ * locking is needed; a report read while the pipeline runs may mix counts
+ * from adjacent conversions.
+ */
+
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal.h"
+
+
+//****************************************************************************
+//
+// Select benchmark mode
+//
+//****************************************************************************
+
+/* Enable this define statement to collect benchmark statistics. The target
+ * then reports them on the UART every BENCH_REPORT_INTERVAL_MS and to a
+ * websocket client on its "stats" command, and the "bench <rate_Hz>"
+ * websocket command drives the pipeline from a synthetic /DRDY source (see
+ * setSyntheticDRDYrate()).
+ */
+//#define ENABLE_BENCHMARK
+
+
+
+//****************************************************************************
+//
+// Constants
+//
+//****************************************************************************
+
+typedef enum
+{
+    BENCH_STAGE_ISR = 0,
+    BENCH_STAGE_WAKE,
+    BENCH_STAGE_READ,
+    BENCH_STAGE_SPI,
+    BENCH_STAGE_CRC,
+    BENCH_STAGE_SCALE,
+    BENCH_STAGE_PACK,
+    BENCH_STAGE_ENCODE,
+    BENCH_STAGE_SEND,
+    BENCH_STAGE_COUNT
+} bench_stage;
+
+/* Conversions between /DRDY and the send that can be timed; must be a power
+ * of two and cover a full sample ring plus a full packet */
+#define BENCH_TRACKED_CONVERSIONS       (1024U)
+
+/* Latency histogram: 8 buckets per octave, so a percentile is reported at most
+ * 12.5% above the true value */
+#define BENCH_BUCKETS_PER_OCTAVE        (8U)
+#define BENCH_LATENCY_BUCKETS           (240U)
+
+/* Stage histograms: bucket 0 counts runs of 0 cycles, bucket n runs of
+ * 2^(n-1) to 2^n - 1 cycles */
+#define BENCH_STAGE_BUCKETS             (33U)
+
+/* Longest line written by benchFormatReportLine(), including the terminator */
+#define BENCH_REPORT_LINE_BYTES         (256U)
+
+/* Time between two UART reports on the target */
+#define BENCH_REPORT_INTERVAL_MS        (5000U)
+
+
+
+//****************************************************************************
+//
+// Data structures
+//
+//****************************************************************************
+
+typedef struct
+{
+    uint32_t count;             // Times the stage ran
+    uint32_t min_cycles;        // Fastest run
+    uint32_t max_cycles;        // Slowest run
+    uint64_t total_cycles;      // Sum of all runs
+} bench_stage_stats;
+
+typedef struct
+{
+    uint32_t cycleFrequency;    // getCycleFrequency(), to convert cycles to time
+    uint64_t elapsed_us;        // Time since benchReset()
+    uint32_t drdyEvents;        // /DRDY interrupts since benchReset()
+    uint32_t conversions;       // Conversions read
+    uint32_t crcErrors;         // Conversions read with a CRC error
+    uint32_t overflows;         // Conversions dropped by a full sample ring
+    uint32_t sent;              // Conversions sent to the network
+    uint32_t dropped;           // /DRDY events not read, plus CRC errors and overflows
+    uint32_t samplesPerSecond;  // Conversions sent per second of elapsed time
+    uint32_t latencyP50_us;     // End-to-end latency percentiles
+    uint32_t latencyP90_us;
+    uint32_t latencyP99_us;
+    uint32_t latencyMax_us;
+    uint32_t encodedSamples;    // Codes (one channel of one record) in the packets encoded
+    uint64_t rawBytes;          // Size of those packets before encoding
+    uint64_t encodedBytes;      // and after; the same for packets left raw
+    bench_stage_stats stage[BENCH_STAGE_COUNT];
+} bench_report;
+
+
+
+//****************************************************************************
+//
+// Instrumentation macros
+//
+//****************************************************************************
+
+#ifdef ENABLE_BENCHMARK
+#define BENCH_START(t)                  uint32_t t = CYCLE_COUNT()
+#define BENCH_END(stage, t)             benchAddStage((stage), CYCLE_COUNT() - (t))
+#define BENCH_CONVERSION(seq, t, error) benchAddConversion((seq), (t), (error))
+#define BENCH_SENT(firstSeq, count, decimation, conversions) \
+                                        benchAddSent((firstSeq), (count), (decimation), (conversions))
+#define BENCH_ENCODED(samples, rawBytes, bytes) \
+                                        benchAddEncoded((samples), (rawBytes), (bytes))
+#define BENCH_RESET()                   benchReset()
+#else
+#define BENCH_START(t)
+#define BENCH_END(stage, t)
+#define BENCH_CONVERSION(seq, t, error)
+#define BENCH_SENT(firstSeq, count, decimation, conversions)
+#define BENCH_ENCODED(samples, rawBytes, bytes)
+#define BENCH_RESET()
+#endif
+
+
+
+//****************************************************************************
+//
+// Function prototypes
+//
+//****************************************************************************
+
+void        benchReset(void);
+void        benchAddStage(bench_stage stage, uint32_t cycles);
+void        benchAddConversion(uint32_t sequence, uint32_t readStart, bool crcError);
+void        benchAddSent(uint32_t firstSequence, uint16_t count, uint8_t decimation, uint32_t conversions);
+void        benchAddEncoded(uint32_t samples, uint16_t rawBytes, uint16_t bytes);
+void        benchGetReport(bench_report *report);
+bool        benchFormatReportLine(const bench_report *report, uint16_t line, char *buffer, uint16_t size);
+const char *benchStageName(bench_stage stage);
+void        benchRequestReport(void);
+bool        benchReportRequested(void);
+
+
+#endif /* BENCHMARK_H_ */
@@ -49,6 +49,8 @@
 #include <ti/sysbios/BIOS.h>
 #include <ti/sysbios/knl/Task.h>
 #include <ti/sysbios/knl/Semaphore.h>
+#include <ti/sysbios/knl/Clock.h>
+#include <ti/sysbios/hal/Hwi.h>
 
 /* TI-RTOS Header files */
 #include <ti/drivers/GPIO.h>
@@ -92,11 +94,18 @@
 
 #include "httpserver_pinmux.h"
 #include "httpserverapp.h"
+#include "adc_control.h"
+#include "adc_stream.h"
+#include "benchmark.h"
+#include "log_ring.h"
+#include "task_config.h"  // Task priorities and stack sizes
+#include "tcp_stream.h"
+#include "ws_clients.h"
+#include "sample_ring.h"
 
 //*****************************************************************************
 //                 DEFINITIONS FOR SPI SETTINGS
 //*****************************************************************************
-#define SPI_IF_BIT_RATE  100000
 #define TR_BUFF_SIZE     100
 
 //*****************************************************************************
@@ -108,18 +117,42 @@
 //*****************************************************************************
 //                 TASK SETTINGS
 //*****************************************************************************
-#define TASKSTACKSIZE   2048
+/* Priorities and stack sizes are set in task_config.h */
+#define DRDY_TIMEOUT_MS 100
+
+/* Minimum time between two reports of lost conversions */
+#define STATS_REPORT_INTERVAL_MS    (1000)
+
+//*****************************************************************************
+//                 STREAM SETTINGS
+//*****************************************************************************
+/* Enable this define statement to send the CSV text frames (microvolts)
+ * instead of binary packets (see adc_stream.h)... */
+//#define STREAM_TEXT_FORMAT
 
 Task_Struct tsk0Struct;
-UInt8 tsk0Stack[TASKSTACKSIZE];
+UInt8 tsk0Stack[ADC_STACK_SIZE];
 Task_Handle task;
 
-#define OSI_STACK_SIZE                  (2048)
-#define OOB_TASK_PRIORITY               (1)
+Task_Struct sender_tskStruct;
+UInt8 sender_tskStack[SENDER_STACK_SIZE];
+
+Task_Struct wsClient_tskStruct[WS_MAX_CLIENTS];
+UInt8 wsClient_tskStack[WS_MAX_CLIENTS][WS_CLIENT_STACK_SIZE];
+
+Task_Struct housekeeping_tskStruct;
+UInt8 housekeeping_tskStack[HOUSEKEEPING_STACK_SIZE];
+
+Semaphore_Handle sampleReadySemaphore;
+Semaphore_Struct sampleReadySemStruct;
+
 Task_Struct httpserver_tsk0Struct;
-UInt8 httpserver_tsk0Stack[OSI_STACK_SIZE];
+UInt8 httpserver_tsk0Stack[HTTP_SERVER_STACK_SIZE];
 Task_Handle httpserver_task;
 
+Task_Struct tcpServer_tskStruct;
+UInt8 tcpServer_tskStack[TCP_SERVER_STACK_SIZE];
+
 Semaphore_Handle httpServerInitCompleteSemaphore;
 Semaphore_Struct structSem;
 
@@ -127,14 +160,6 @@ Semaphore_Struct structSem;
 //                 GLOBAL VARIABLES
 //*****************************************************************************
 int count = 0;
-adc_channel_data adcData;
-double channel0Signal;
-double channel1Signal;
-double channel2Signal;
-double channel3Signal;
-
-extern UINT16 g_uConnection;
-char data[32*4 + 4];
 
 //*****************************************************************************
 //                 VECTORS (Specific for compilers)
@@ -254,82 +279,522 @@ BoardInit(void)
     PRCMCC3200MCUInit();
 }
 
+//*****************************************************************************
+//
+//! Returns the time since BIOS start in milliseconds.
+//
+//*****************************************************************************
+static uint32_t getTime_ms(void)
+{
+    return (uint32_t) (((uint64_t) Clock_getTicks() * Clock_tickPeriod) / 1000);
+}
+
+//*****************************************************************************
+//
+//! Takes an empty frame from the websocket frame pool.
+//!
+//! \param opcode STREAM_WS_OPCODE_BINARY or STREAM_WS_OPCODE_TEXT.
+//!
+//! The pool is sized for every client queue to be full (see ws_clients.h),
+//! so this only waits if a frame was not released.
+//!
+//! \return The frame.
+//
+//*****************************************************************************
+static ws_frame *acquireFrame(uint8_t opcode)
+{
+    ws_frame *frame;
+
+    while ((frame = wsFrameAcquire(opcode)) == NULL) {
+        Task_sleep(1);
+    }
+    return frame;
+}
+
+//*****************************************************************************
+//
+//! Reports the conversions lost at each stage on the UART and to the
+//! websocket clients.
+//!
+//! \param loss counters from streamGetLossStats().
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void reportLoss(const stream_loss_stats *loss)
+{
+    static char line[STREAM_LOSS_REPORT_BYTES];
+    sample_ring_stats stats;
+
+    sampleRingGetStats(&stats);
+    streamFormatLossReport(loss, line, sizeof(line));
+
+    LOG_PRINT("loss: drdy %u, crc %u, ring %u, send %u\r\n", loss->missedDrdy, loss->crcErrors,
+              loss->ringOverflows, loss->sendFailures);
+    LOG_PRINT("Sample ring high water %u of %u\r\n", stats.highWater, SAMPLE_RING_SIZE);
+    if (!wsFramePublishText(line, WS_SUBSCRIBE_REPORTS)) {
+        LOG_PRINT("Error: Cannot send loss report\r\n");
+    }
+}
+
+#ifndef STREAM_TEXT_FORMAT
+//*****************************************************************************
+//
+//! Publishes the records collected in a batch frame to the websocket clients
+//! as one binary frame, and replaces it with an empty frame.
+//!
+//! \param frame batch frame to send.
+//!
+//! \return The frame to fill next: frame itself if it was empty.
+//
+//*****************************************************************************
+static ws_frame *sendBatch(ws_frame *frame)
+{
+    uint32_t firstSequence = frame->batch.firstSequence;
+    uint16_t count = frame->batch.count;
+    uint8_t decimation = frame->batch.decimation;
+    uint32_t conversions = frame->batch.conversions;
+
+    if (count == 0) {
+        return frame;
+    }
+
+    //
+    // Compress the records if the clients asked for it (see streamSetEncoding())
+    //
+    if (streamGetEncoding() != STREAM_ENCODING_RAW) {
+        uint16_t rawBytes = frame->batch.length;
+
+        BENCH_START(encodeStart);
+        streamBatchEncode(&frame->batch);
+        BENCH_END(BENCH_STAGE_ENCODE, encodeStart);
+        BENCH_ENCODED((uint32_t) count * ((frame->batch.recordBytes - 2u) / STREAM_CODE_BYTES), rawBytes,
+                      frame->batch.length);
+    }
+
+    //
+    // Hand the conversions to the client tasks; the frame is not ours afterwards
+    //
+    BENCH_START(sendStart);
+    wsFramePublish(frame, WS_SUBSCRIBE_DATA);
+    BENCH_END(BENCH_STAGE_SEND, sendStart);
+    BENCH_SENT(firstSequence, count, decimation, conversions);
+
+    return acquireFrame(STREAM_WS_OPCODE_BINARY);
+}
+
+//*****************************************************************************
+//
+//! Moves the record formed by the decimator into the batch frame, sending
+//! the frame first if the record does not fit or when the flush policy says
+//! so.
+//!
+//! \param frame batch frame being filled.
+//! \param decimator decimator holding the record; emptied.
+//!
+//! \return The frame to fill next.
+//
+//*****************************************************************************
+static ws_frame *packRecord(ws_frame *frame, stream_decimator *decimator)
+{
+    stream_record record;
+
+    if (!streamDecimatorTake(decimator, &record)) {
+        return frame;
+    }
+
+    // A lost conversion, a channel mask change or a new link mode ends the current packet
+    if (!streamBatchAccepts(&frame->batch, &record)) {
+        frame = sendBatch(frame);
+    }
+    BENCH_START(packStart);
+    streamBatchAdd(&frame->batch, &record, getTime_ms());
+    BENCH_END(BENCH_STAGE_PACK, packStart);
+
+    if (streamBatchFlushDue(&frame->batch, getTime_ms())) {
+        frame = sendBatch(frame);
+    }
+    return frame;
+}
+
+//*****************************************************************************
+//
+//! Adapts the batching and decimation of the stream to how well the
+//! websocket clients kept up since the last call (see streamAdaptToLink()).
+//!
+//! \param interval_ms time since the last call.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void adaptToLink(uint32_t interval_ms)
+{
+    stream_link_stats link;
+
+    wsClientsGetLinkStats(&link);
+    link.interval_us = interval_ms * 1000;
+
+    if (streamAdaptToLink(&link)) {
+        LOG_PRINT("Link mode %u, decimation %u, %u records per packet\r\n", streamGetMode(),
+                  streamGetDecimation(), streamGetBatchRecords());
+    }
+}
+#endif
+
+#ifdef ENABLE_BENCHMARK
+//*****************************************************************************
+//
+//! Reports the benchmark statistics collected since the last "bench" command.
+//!
+//! \param toClient true to send the report to the websocket clients
+//!        subscribed to reports as text frames (the "stats" command), false
+//!        to print it on the UART.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void reportBenchmark(bool toClient)
+{
+    static bench_report report;
+    static char line[BENCH_REPORT_LINE_BYTES];
+    uint16_t n;
+
+    benchGetReport(&report);
+
+    for (n = 0; benchFormatReportLine(&report, n, line, sizeof(line)); n++) {
+        if (line[0] == '\0') {
+            continue;
+        }
+        if (toClient) {
+            if (!wsFramePublishText(line, WS_SUBSCRIBE_REPORTS)) {
+                LOG_PRINT("Error: Cannot send benchmark report\r\n");
+                return;
+            }
+        }
+        else {
+            UART_PRINT("%s\r\n", line);
+        }
+    }
+}
+#endif
+
 //****************************************************************************
 //
-//! Executes the ADC task to process data after DRDY interrupt.
+//! Executes the ADC task to read conversions after the DRDY interrupt.
 //!
 //! \param a0 Sleep duration (in units) for the task before entering the main loop.
 //! \param a1 Not used in the current implementation.
 //!
 //! This function performs the following operations:
 //!    1. Sleeps the task for the duration specified by a0.
-//!    2. Enters a continuous loop, where it waits for a DRDY interrupt.
+//!    2. Enters a continuous loop, where it applies configuration requests
+//!       (see adc_control.h) and then blocks on the DRDY semaphore.
 //!    3. If the DRDY interrupt occurs:
-//!       a. Clears the interrupt flag.
-//!       b. Reads data from the ADC.
-//!       c. If there's a CRC error in the read data, it prints a warning message.
-//!    4. If the DRDY interrupt does not occur within the specified timeout, it turns on an LED.
+//!       a. Takes the timestamp and sequence number of the interrupt, counting
+//!          skipped sequence numbers as missed conversions, and reads data from the ADC.
+//!       b. If there's a CRC error in the read data, it logs a warning message.
+//!       c. Otherwise, pushes the conversion into the sample ring and wakes
+//!          the sender task once a batch worth of records is waiting.
+//!    4. If the DRDY interrupt does not occur within DRDY_TIMEOUT_MS, it logs a warning message.
+//!
+//! This task never touches the network or the UART, so a Wi-Fi stall can only
+//! fill the sample ring; it cannot delay the SPI reads. Messages go through
+//! the deferred log (see log_ring.h) and are printed by housekeepingTask().
 //!
 //! \return None. (Function does not exit unless externally terminated.)
 //
 //****************************************************************************
-
 Void adcTask(UArg a0, UArg a1)
 {
+    sample_record record;
+
     // Wait for HTTP server initialization to complete
     Semaphore_pend(httpServerInitCompleteSemaphore, BIOS_WAIT_FOREVER);
 
     // Initial sleep before entering main loop
     Task_sleep((UInt)a0);
 
+    // Size the stream batches for the data rate set up by InitADC()
+    adcControlInit();
+    BENCH_RESET();
+
+    // Discard any DRDY event latched while the device was being configured
+    set_flag_nDRDY_INTERRUPT(false);
+
     while(1) {
-        // Wait for DRDY interrupt or timeout
-        bool interruptOccurred = waitForDRDYinterrupt(10000);
+        // Apply configuration requests from other tasks between two conversions
+        if (adcControlService()) {
+            adc_timing timing;
+            getAdcTiming(&timing);
+            LOG_PRINT("Data rate: %u SPS (OSR %u), %u ns per conversion, channel mask 0x%02X\r\n",
+                      timing.dataRate_Hz, timing.osr, timing.drdyPeriod_ns, getChannelEnableMask());
+        }
+
+        // Block until the DRDY interrupt posts the semaphore, or timeout
+        bool interruptOccurred = waitForDRDYinterrupt(DRDY_TIMEOUT_MS);
 
             if (interruptOccurred) {
-                // Clear interrupt flag
-                set_flag_nDRDY_INTERRUPT(false);
                 GPIO_IF_LedToggle(MCU_ORANGE_LED_GPIO);
 
+                // Stamp the conversion with the time and number of its /DRDY interrupt
+                record.timestamp = getDRDYtime(&record.sequence);
+                streamTrackSequence(record.sequence);
+
                 // Read data from ADC
-                bool crcError = readData(&adcData);
+                BENCH_START(readStart);
+                bool crcError = readData(&record.data);
+                BENCH_END(BENCH_STAGE_READ, readStart);
+                BENCH_CONVERSION(record.sequence, readStart, crcError);
 
                 if (crcError) {
-                    // Print warning for CRC error
-                    System_printf("CRC error occurred.");
-                    System_flush();
+                    // Log warning for CRC error
+                    LOG_PRINT("CRC error occurred.\r\n");
+                    streamCountCrcError();
                 } else {
-                    double lsbWeight = (2.4 / 8.0) / (1.0 * (1 << 24));
-                    channel0Signal = (double)adcData.channel0 * lsbWeight;
-                    channel1Signal = (double)adcData.channel1 * lsbWeight;
-                    channel2Signal = (double)adcData.channel2 * lsbWeight;
-                    channel3Signal = (double)adcData.channel3 * lsbWeight;
-
-                    struct HttpBlob Write;
-                    UINT8 Opcode = 0x01;
-
-                    Write.uLength = snprintf(data, sizeof(data), "%.16lf,%.16lf,%.16lf,%.16lf",
-                             channel0Signal, channel1Signal, channel2Signal, channel3Signal);
-                    Write.pData = (UINT8 *)data;
-
-
-                    //
-                    // Send updated counter over websocket
-                    //
-                    //Write.uLength = sizeof(adcData.channel0);
-                    //Write.pData = (UINT8 *)(&adcData.channel0);
-                    if(!sl_WebSocketSend(g_uConnection, Write, Opcode))
-                    {
-                        UART_PRINT("Error: Cannot send websocket counter update\r\n");
+                    // A full ring drops the conversion and counts the overflow
+                    sampleRingPush(&record);
+
+#ifdef STREAM_TEXT_FORMAT
+                    Semaphore_post(sampleReadySemaphore);
+#else
+                    if (sampleRingCount() >= streamGetBatchRecords()) {
+                        Semaphore_post(sampleReadySemaphore);
                     }
+#endif
                 }
 
             } else {
                 // Turn on LED if no interrupt within timeout
                 //GPIO_write(Board_LED0, Board_LED_ON);
-                System_printf("No DRDY interrupt detected\n");
-                System_flush();
+                LOG_PRINT("No DRDY interrupt detected\r\n");
+            }
+    }
+}
+
+//****************************************************************************
+//
+//! Executes the sender task, which drains the sample ring to the websocket
+//! clients.
+//!
+//! \param a0 Not used in the current implementation.
+//! \param a1 Not used in the current implementation.
+//!
+//! The task wakes when the ADC task reports a full batch, or after the batch
+//! latency has elapsed, appends every waiting record to the current batch and
+//! sends the batch according to the flush policy (see streamSetFlushPolicy()).
+//! Every STREAM_ADAPT_INTERVAL_MS, the batch size and decimation are adapted
+//! to how busy the clients' links are (see streamAdaptToLink()). Each batch
+//! is encoded once and published to every subscribed client (see
+//! ws_clients.h); the client tasks do the network sends, so a slow client
+//! cannot hold up the sample ring. Lost conversions (see stream_loss_stats)
+//! are logged and reported to the clients at most once per
+//! STATS_REPORT_INTERVAL_MS.
+//!
+//! \return None. (Function does not exit unless externally terminated.)
+//
+//****************************************************************************
+Void senderTask(UArg a0, UArg a1)
+{
+    sample_record record;
+    stream_loss_stats loss;
+    uint32_t reportedLoss = 0;
+    uint32_t lastReport_ms = 0;
+#ifdef ENABLE_BENCHMARK
+    uint32_t lastBenchReport_ms = 0;
+#endif
+
+#ifdef STREAM_TEXT_FORMAT
+    int32_t microvolts[CHANNEL_COUNT];
+#else
+    ws_frame *frame = acquireFrame(STREAM_WS_OPCODE_BINARY);
+    stream_decimator decimator;
+    uint32_t lastAdapt_ms = 0;
+
+    streamDecimatorReset(&decimator);
+#endif
+
+    while(1) {
+#ifdef STREAM_TEXT_FORMAT
+        Semaphore_pend(sampleReadySemaphore, DRDY_TIMEOUT_MS);
+
+        while (sampleRingPop(&record)) {
+            ws_frame *frame = acquireFrame(STREAM_WS_OPCODE_TEXT);
+            char *data = (char *)frame->batch.buffer;
+            int length = 0;
+            uint8_t channel;
+
+            // Enabled channels only, lowest channel first
+            BENCH_START(scaleStart);
+            convertToMicrovolts(&record.data, microvolts);
+            BENCH_END(BENCH_STAGE_SCALE, scaleStart);
+
+            BENCH_START(packStart);
+            for (channel = 0; channel < CHANNEL_COUNT; channel++) {
+                if (record.data.channelMask & (1u << channel)) {
+                    length += snprintf(&data[length], sizeof(frame->batch.buffer) - length, length ? ",%ld" : "%ld",
+                                       (long)microvolts[channel]);
+                }
+            }
+            BENCH_END(BENCH_STAGE_PACK, packStart);
+            frame->batch.length = length;
+            frame->batch.count = 1;
+            frame->batch.conversions = 1;
+
+            //
+            // Hand the conversion to the client tasks
+            //
+            BENCH_START(sendStart);
+            wsFramePublish(frame, WS_SUBSCRIBE_DATA);
+            BENCH_END(BENCH_STAGE_SEND, sendStart);
+            BENCH_SENT(record.sequence, 1, 1, 1);
+        }
+#else
+        // Clock ticks are 1 ms (Clock.tickPeriod in empty_min.cfg)
+        uint32_t timeout = streamGetBatchLatency();
+        if (timeout < 1)                { timeout = 1; }
+        if (timeout > DRDY_TIMEOUT_MS)  { timeout = DRDY_TIMEOUT_MS; }
+
+        Semaphore_pend(sampleReadySemaphore, timeout);
+
+        while (sampleRingPop(&record)) {
+            // Average the conversions into records of the current decimation
+            if (!streamDecimatorAccepts(&decimator, &record)) {
+                frame = packRecord(frame, &decimator);
             }
+            streamDecimatorAdd(&decimator, &record);
+            if (streamDecimatorComplete(&decimator)) {
+                frame = packRecord(frame, &decimator);
+            }
+        }
+
+        // Send a partial batch once its oldest record is due
+        if (streamBatchFlushDue(&frame->batch, getTime_ms())) {
+            frame = sendBatch(frame);
+        }
+
+        if ((uint32_t)(getTime_ms() - lastAdapt_ms) >= STREAM_ADAPT_INTERVAL_MS) {
+            adaptToLink(getTime_ms() - lastAdapt_ms);
+            lastAdapt_ms = getTime_ms();
+        }
+#endif
+
+        // Report losses whenever they grow, at most once per interval
+        streamGetLossStats(&loss);
+        if ((streamLossTotal(&loss) != reportedLoss) &&
+            ((uint32_t)(getTime_ms() - lastReport_ms) >= STATS_REPORT_INTERVAL_MS)) {
+            reportLoss(&loss);
+            reportedLoss = streamLossTotal(&loss);
+            lastReport_ms = getTime_ms();
+        }
+
+#ifdef ENABLE_BENCHMARK
+        if ((uint32_t)(getTime_ms() - lastBenchReport_ms) >= BENCH_REPORT_INTERVAL_MS) {
+            reportBenchmark(false);
+            lastBenchReport_ms = getTime_ms();
+        }
+        if (benchReportRequested()) {
+            reportBenchmark(true);
+        }
+#endif
+    }
+}
+
+//*****************************************************************************
+//
+//! Logs the stacks whose high-water mark went up since the last check.
+//!
+//! The task stacks are filled with a known pattern when they are constructed,
+//! so the deepest use is where the pattern ends. The SimpleLink spawn task is
+//! created by the SDK and is not checked.
+//!
+//! \return None.
+//
+//*****************************************************************************
+static void checkStacks(void)
+{
+    static const struct {
+        const char *name;
+        Task_Struct *task;
+    } tasks[] = {
+        { "adc",            &tsk0Struct },
+        { "sender",         &sender_tskStruct },
+        { "http server",    &httpserver_tsk0Struct },
+        { "tcp server",     &tcpServer_tskStruct },
+        { "housekeeping",   &housekeeping_tskStruct },
+    };
+    static UInt32 reportedUsed[sizeof(tasks) / sizeof(tasks[0])];
+    static UInt32 reportedClientUsed[WS_MAX_CLIENTS];
+    static UInt32 reportedHwiPeak = 0;
+    Hwi_StackInfo hwiStack;
+    Task_Stat stat;
+    uint16_t n;
+
+    for (n = 0; n < (sizeof(tasks) / sizeof(tasks[0])); n++) {
+        Task_stat(Task_handle(tasks[n].task), &stat);
+        if (stat.used > reportedUsed[n]) {
+            reportedUsed[n] = stat.used;
+            LOG_PRINT("Stack high water: %s task %u of %u bytes\r\n", tasks[n].name, stat.used, stat.stackSize);
+        }
+    }
+
+    for (n = 0; n < WS_MAX_CLIENTS; n++) {
+        Task_stat(Task_handle(&wsClient_tskStruct[n]), &stat);
+        if (stat.used > reportedClientUsed[n]) {
+            reportedClientUsed[n] = stat.used;
+            LOG_PRINT("Stack high water: client %u task %u of %u bytes\r\n", n, stat.used, stat.stackSize);
+        }
+    }
+
+    // The system stack is shared by all interrupt handlers
+    Hwi_getStackInfo(&hwiStack, true);
+    if (hwiStack.hwiStackPeak > reportedHwiPeak) {
+        reportedHwiPeak = hwiStack.hwiStackPeak;
+        LOG_PRINT("Stack high water: system %u of %u bytes\r\n", hwiStack.hwiStackPeak, hwiStack.hwiStackSize);
+    }
+}
+
+//****************************************************************************
+//
+//! Executes the housekeeping task, which prints the deferred log messages
+//! and checks the stacks.
+//!
+//! \param a0 Not used in the current implementation.
+//! \param a1 Not used in the current implementation.
+//!
+//! Messages queued with LOG_PRINT() are formatted here, without Report() and
+//! its heap buffer, at the lowest task priority, so that the time spent
+//! formatting and waiting on the UART is taken from idle time rather than from
+//! the tasks that logged them. Messages dropped because the ring was full are
+//! reported once the ring has drained. Every STACK_CHECK_INTERVAL_MS the stack
+//! high-water marks are checked (see checkStacks()).
+//!
+//! \return None. (Function does not exit unless externally terminated.)
+//
+//****************************************************************************
+Void housekeepingTask(UArg a0, UArg a1)
+{
+    static char line[LOG_LINE_BYTES];
+    uint32_t reportedDropped = 0;
+    uint32_t lastStackCheck_ms = 0;
+
+    while(1) {
+        if ((uint32_t)(getTime_ms() - lastStackCheck_ms) >= STACK_CHECK_INTERVAL_MS) {
+            checkStacks();
+            lastStackCheck_ms = getTime_ms();
+        }
+
+        while (logRingFormat(line, sizeof(line))) {
+            Message(line);
+        }
+
+        if (logRingDropped() != reportedDropped) {
+            reportedDropped = logRingDropped();
+            snprintf(line, sizeof(line), "Log ring full, %u messages dropped\r\n",
+                     (unsigned int)reportedDropped);
+            Message(line);
+        }
+
+        Task_sleep(HOUSEKEEPING_PERIOD_MS);
     }
 }
 
@@ -339,12 +804,18 @@ Void adcTask(UArg a0, UArg a1)
 int main()
  {
     Task_Params tskParams;
+    UInt n;
     long lRetVal = -1;
     Semaphore_Params semParams;
     Semaphore_Params_init(&semParams);
     Semaphore_construct(&structSem, 0, &semParams);
     httpServerInitCompleteSemaphore = Semaphore_handle(&structSem);
 
+    // Wakes the sender task when conversions are waiting in the sample ring
+    semParams.mode = Semaphore_Mode_BINARY;
+    Semaphore_construct(&sampleReadySemStruct, 0, &semParams);
+    sampleReadySemaphore = Semaphore_handle(&sampleReadySemStruct);
+
     // Initialize board-related functions
     Board_initGeneral();
     Board_initGPIO();
@@ -386,11 +857,37 @@ int main()
 
     // Set up the ADC task
     Task_Params_init(&tskParams);
-    tskParams.stackSize = TASKSTACKSIZE;
+    tskParams.stackSize = ADC_STACK_SIZE;
     tskParams.stack = &tsk0Stack;
     tskParams.arg0 = 1000;
+    tskParams.priority = ADC_TASK_PRIORITY;
     Task_construct(&tsk0Struct, (Task_FuncPtr)adcTask, &tskParams, NULL);
 
+    // Set up the sender task
+    Task_Params_init(&tskParams);
+    tskParams.stackSize = SENDER_STACK_SIZE;
+    tskParams.stack = &sender_tskStack;
+    tskParams.priority = SENDER_TASK_PRIORITY;
+    Task_construct(&sender_tskStruct, (Task_FuncPtr)senderTask, &tskParams, NULL);
+
+    // Set up one task per websocket client
+    wsClientsInit();
+    for (n = 0; n < WS_MAX_CLIENTS; n++) {
+        Task_Params_init(&tskParams);
+        tskParams.stackSize = WS_CLIENT_STACK_SIZE;
+        tskParams.stack = &wsClient_tskStack[n];
+        tskParams.arg0 = n;
+        tskParams.priority = WS_CLIENT_TASK_PRIORITY;
+        Task_construct(&wsClient_tskStruct[n], (Task_FuncPtr)wsClientTask, &tskParams, NULL);
+    }
+
+    // Set up the housekeeping task
+    Task_Params_init(&tskParams);
+    tskParams.stackSize = HOUSEKEEPING_STACK_SIZE;
+    tskParams.stack = &housekeeping_tskStack;
+    tskParams.priority = HOUSEKEEPING_TASK_PRIORITY;
+    Task_construct(&housekeeping_tskStruct, (Task_FuncPtr)housekeepingTask, &tskParams, NULL);
+
 
     //
     // Simplelinkspawntask
@@ -404,11 +901,18 @@ int main()
 
     // Set up the HTTP Server task
     Task_Params_init(&tskParams);
-    tskParams.stackSize = OSI_STACK_SIZE;
+    tskParams.stackSize = HTTP_SERVER_STACK_SIZE;
     tskParams.stack = &httpserver_tsk0Stack;
-    tskParams.priority = OOB_TASK_PRIORITY;
+    tskParams.priority = HTTP_SERVER_TASK_PRIORITY;
     Task_construct(&httpserver_tsk0Struct, (Task_FuncPtr)HttpServerAppTask, &tskParams, NULL);
 
+    // Set up the raw TCP stream server task; it waits for the network
+    Task_Params_init(&tskParams);
+    tskParams.stackSize = TCP_SERVER_STACK_SIZE;
+    tskParams.stack = &tcpServer_tskStack;
+    tskParams.priority = TCP_SERVER_TASK_PRIORITY;
+    Task_construct(&tcpServer_tskStruct, (Task_FuncPtr)tcpServerTask, &tskParams, NULL);
+
     // Launch the TI-RTOS kernel
     BIOS_start();
 
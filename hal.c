@@ -32,7 +32,13 @@
  */
 
 #include <stdlib.h>
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/hal/Hwi.h>
+#include <ti/sysbios/knl/Clock.h>
+#include <ti/sysbios/knl/Semaphore.h>
 #include <ti/sysbios/knl/Task.h>
+#include <ti/sysbios/hal/Timer.h>
+#include <xdc/runtime/Error.h>
 
 // Driverlib includes
 #include "hw_types.h"
@@ -60,16 +66,19 @@
 #include "hw_types.h"
 #include "hw_memmap.h"
 #include "hw_gpio.h"
+#include "hw_mcspi.h"
 #include "pin.h"
 #include "rom.h"
 #include "rom_map.h"
 #include "gpio.h"
+#include "udma.h"
 #include "prcm.h"
 #include "gpio_if.h"
 
 // Common interface includes
 #include "pin_mux_config.h"
 #include "hal.h"
+#include "benchmark.h"
 
 /* BIOS Header files */
 //#include <ti/sysbios/BIOS.h>
@@ -88,8 +97,48 @@
 
 // Flag to indicate if a /DRDY interrupt has occurred
 static volatile bool flag_nDRDY_INTERRUPT = false;
-volatile uint8_t randomNumber = 0;
-#define SPI_IF_BIT_RATE  10000000
+
+// Number of /DRDY interrupts serviced (used to verify the handler is being triggered)
+static volatile uint32_t drdyInterruptCount = 0;
+
+// Cycle count (getCycleCount()) at the most recent /DRDY interrupt
+static volatile uint32_t drdyTimestamp = 0;
+
+// Timestamp timer (getTimestamp()) at the most recent /DRDY interrupt
+static volatile uint64_t drdyTime = 0;
+
+// Software extension of the 32-bit timestamp timer to 64 bits
+static volatile uint32_t timestampHigh = 0;
+static volatile uint32_t timestampLastLow = 0;
+
+// Binary semaphore posted from the /DRDY interrupt to wake the reader task
+static Semaphore_Struct drdySemaphoreStruct;
+static Semaphore_Handle drdySemaphore;
+
+// Timer standing in for the /DRDY pin (see setSyntheticDRDYrate())
+static Timer_Struct     syntheticDrdyTimerStruct;
+static Timer_Handle     syntheticDrdyTimer = NULL;
+
+#ifdef SPI_USE_DMA
+// GSPI interrupt (uDMA done) and the semaphore it posts to the waiting task
+static Hwi_Struct       spiDmaHwiStruct;
+static Semaphore_Struct spiDmaSemaphoreStruct;
+static Semaphore_Handle spiDmaSemaphore;
+#endif
+
+
+
+//****************************************************************************
+//
+// Internal macros
+//
+//****************************************************************************
+
+/* Debug registers that enable the DWT cycle counter (ARMv7-M architecture) */
+#define DEMCR               (*((volatile uint32_t *) 0xE000EDFC))
+#define DEMCR_TRCENA        ((uint32_t) 0x01000000)
+#define DWT_CTRL            (*((volatile uint32_t *) 0xE0001000))
+#define DWT_CTRL_CYCCNTENA  ((uint32_t) 0x00000001)
 
 
 
@@ -98,9 +147,16 @@ volatile uint8_t randomNumber = 0;
 // Internal function prototypes
 //
 //****************************************************************************
+void InitCycleCounter(void);
+void InitTimestampTimer(void);
+uint64_t extendTimestamp(void);
 void InitGPIO(void);
 void InitSPI(void);
+void InitSPIDMA(void);
 void GPIO_DRDY_IRQHandler(unsigned int index);
+void SyntheticDRDY_IRQHandler(UArg arg);
+void SPI_DMA_IRQHandler(UArg arg);
+void spiDMATransfer(const uint8_t dataTx[], uint8_t dataRx[], const uint8_t byteLength);
 
 
 
@@ -124,6 +180,12 @@ void InitADC(void)
 {
     // IMPORTANT: Make sure device is powered before setting GPIOs pins to HIGH state.
 
+    // Start the cycle counter used to profile the drivers
+    InitCycleCounter();
+
+    // Start the free-running timer used to timestamp /DRDY
+    InitTimestampTimer();
+
     // Initialize GPIOs pins used by ADS131M0x
     InitGPIO();
 
@@ -145,6 +207,152 @@ void InitADC(void)
 
 
 
+//*****************************************************************************
+//
+//! Starts the DWT cycle counter.
+//!
+//! \fn void InitCycleCounter(void)
+//!
+//! \return None.
+//
+//*****************************************************************************
+void InitCycleCounter(void)
+{
+    DEMCR      |= DEMCR_TRCENA;
+    DWT_CYCCNT  = 0;
+    DWT_CTRL   |= DWT_CTRL_CYCCNTENA;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns a free-running cycle count for measuring short intervals.
+//!
+//! \fn uint32_t getCycleCount(void)
+//!
+//! The count wraps around; compute intervals as unsigned differences. Use
+//! CYCLE_COUNT() instead where a function call would distort the measurement.
+//!
+//! \return Counter value, at getCycleFrequency() counts per second.
+//
+//*****************************************************************************
+uint32_t getCycleCount(void)
+{
+    return CYCLE_COUNT();
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the rate of the getCycleCount() counter.
+//!
+//! \fn uint32_t getCycleFrequency(void)
+//!
+//! \return Counts per second.
+//
+//*****************************************************************************
+uint32_t getCycleFrequency(void)
+{
+    return CPU_CLOCK_HZ;
+}
+
+
+
+//*****************************************************************************
+//
+//! Starts the free-running timestamp timer.
+//!
+//! \fn void InitTimestampTimer(void)
+//!
+//! The timer counts up through its full 32-bit range and wraps around every
+//! 53.7 s at 80 MHz; extendTimestamp() adds the upper 32 bits.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void InitTimestampTimer(void)
+{
+    MAP_PRCMPeripheralClkEnable(TIMESTAMP_TIMER_PRCM, PRCM_RUN_MODE_CLK);
+    MAP_PRCMPeripheralReset(TIMESTAMP_TIMER_PRCM);
+
+    MAP_TimerConfigure(TIMESTAMP_TIMER_BASE, TIMER_CFG_PERIODIC_UP);
+    MAP_TimerPrescaleSet(TIMESTAMP_TIMER_BASE, TIMER_A, 0);
+    MAP_TimerLoadSet(TIMESTAMP_TIMER_BASE, TIMER_A, 0xFFFFFFFF);
+    MAP_TimerEnable(TIMESTAMP_TIMER_BASE, TIMER_A);
+
+    timestampHigh       = 0;
+    timestampLastLow    = 0;
+}
+
+
+
+//*****************************************************************************
+//
+//! Reads the timestamp timer and extends it to 64 bits.
+//!
+//! \fn uint64_t extendTimestamp(void)
+//!
+//! A wrap-around is detected when the timer reads lower than at the previous
+//! call, so calls must be less than one timer period (53.7 s) apart; the
+//! /DRDY interrupt and waitForDRDYinterrupt() take care of that.
+//!
+//! NOTE: Not reentrant; call from an interrupt handler or with interrupts
+//! disabled.
+//!
+//! \return Timer ticks since InitTimestampTimer().
+//
+//*****************************************************************************
+uint64_t extendTimestamp(void)
+{
+    uint32_t low = MAP_TimerValueGet(TIMESTAMP_TIMER_BASE, TIMER_A);
+
+    if (low < timestampLastLow) { timestampHigh++; }
+    timestampLastLow = low;
+
+    return ((uint64_t) timestampHigh << 32) | low;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the current time of the timestamp timer.
+//!
+//! \fn uint64_t getTimestamp(void)
+//!
+//! \return Timer ticks since InitADC(), at getTimestampFrequency() ticks per
+//! second.
+//
+//*****************************************************************************
+uint64_t getTimestamp(void)
+{
+    UInt key = Hwi_disable();
+    uint64_t timestamp = extendTimestamp();
+    Hwi_restore(key);
+
+    return timestamp;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the rate of the timestamp timer.
+//!
+//! \fn uint32_t getTimestampFrequency(void)
+//!
+//! \return Ticks per second of getTimestamp() and getDRDYtime().
+//
+//*****************************************************************************
+uint32_t getTimestampFrequency(void)
+{
+    return TIMESTAMP_FREQUENCY_HZ;
+}
+
+
+
 //*****************************************************************************
 //
 //! Provides a timing delay with 'ms' resolution.
@@ -210,6 +418,16 @@ void InitGPIO(void)
     /* Configure the GPIO for 'nSYNC_nRESET' as output and set high */
     MAP_GPIOPinWrite(GPIOA1_BASE, 1 << GPIO_PIN_4, 1 << GPIO_PIN_4);
 
+    /* Create the /DRDY semaphore before the interrupt can fire.
+     * NOTE: A binary semaphore is used on purpose; if the reader falls behind,
+     * only the most recent conversion is available from the device anyway.
+     */
+    Semaphore_Params semParams;
+    Semaphore_Params_init(&semParams);
+    semParams.mode = Semaphore_Mode_BINARY;
+    Semaphore_construct(&drdySemaphoreStruct, 0, &semParams);
+    drdySemaphore = Semaphore_handle(&drdySemaphoreStruct);
+
     /* Configure the GPIO for 'nDRDY' as input with falling edge interrupt */
     GPIO_setCallback(Board_BUTTON1, GPIO_DRDY_IRQHandler);
     GPIO_enableInt(Board_BUTTON1);
@@ -237,23 +455,25 @@ void InitGPIO(void)
 //*****************************************************************************
 void GPIO_DRDY_IRQHandler(unsigned int index)
 {
+    drdyTimestamp = CYCLE_COUNT();
+    drdyTime = extendTimestamp();
+
     /* --- INSERT YOUR CODE HERE --- */
     //NOTE: You many need to rename or register this interrupt function for your processor
 
     // Possible ways to handle this interrupt:
     // If you decide to read data here, you may want to disable other interrupts to avoid partial data reads.
 
-    // In this example we set a flag and exit the interrupt routine. In the main program loop, your application can examine
-    // all state flags and decide which state (operation) to perform next.
+    // In this example we set a flag, post the /DRDY semaphore and exit the interrupt routine.
+    // The reader task pending in waitForDRDYinterrupt() is made ready immediately.
 
     /* Get the interrupt status from the GPIO and clear the status */
     uint32_t getIntStatus = MAP_GPIOIntStatus(nDRDY_PORT, true);
 
-    /* Interrupt action: Set a flag */
+    /* Interrupt action: Set a flag and wake the reader */
     flag_nDRDY_INTERRUPT = true;
-
-    /* Random number generation to verify interrupt handler being triggered */
-    randomNumber = (uint8_t)rand() % 256;
+    drdyInterruptCount++;
+    Semaphore_post(drdySemaphore);
 
     /* Clear interrupt */
     MAP_GPIOIntClear(nDRDY_PORT, getIntStatus);
@@ -261,6 +481,32 @@ void GPIO_DRDY_IRQHandler(unsigned int index)
     // NOTE: We add a short delay at the end to prevent re-entrance. Refer to E2E issue:
     // https://e2e.ti.com/support/microcontrollers/tiva_arm/f/908/p/332605/1786938#1786938
     MAP_UtilsDelay(3);
+
+    BENCH_END(BENCH_STAGE_ISR, drdyTimestamp);
+}
+
+
+
+//*****************************************************************************
+//
+//! Interrupt handler for the synthetic /DRDY timer.
+//!
+//! \fn void SyntheticDRDY_IRQHandler(UArg arg)
+//!
+//! Signals a conversion exactly as GPIO_DRDY_IRQHandler() does.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void SyntheticDRDY_IRQHandler(UArg arg)
+{
+    drdyTimestamp = CYCLE_COUNT();
+    drdyTime = extendTimestamp();
+    flag_nDRDY_INTERRUPT = true;
+    drdyInterruptCount++;
+    Semaphore_post(drdySemaphore);
+
+    BENCH_END(BENCH_STAGE_ISR, drdyTimestamp);
 }
 
 
@@ -326,14 +572,9 @@ void setCS(const bool state)
 {
     /* --- INSERT YOUR CODE HERE --- */
 
-    // td(CSSC) delay
-    if(state) { MAP_UtilsDelay(2); }
-
-    uint8_t value = (uint8_t) (state ? nCS_PIN : 0);
-    MAP_GPIOPinWrite(nCS_PORT, nCS_PIN, value);
-
-    // td(SCCS) delay
-    if(!state) { MAP_UtilsDelay(2); }
+    // /CS is driven by the GSPI module in software-controlled mode
+    if (state)  { MAP_SPICSDisable(GSPI_BASE); }
+    else        { MAP_SPICSEnable(GSPI_BASE); }
 }
 
 
@@ -427,43 +668,176 @@ void toggleRESET(void)
 //!
 //! \param timeout_ms number of milliseconds to wait before timeout event.
 //!
+//! The calling task blocks on the /DRDY semaphore, so it consumes no CPU time
+//! while waiting and is woken as soon as GPIO_DRDY_IRQHandler() runs.
+//!
 //! \return Returns 'true' if nDRDY interrupt occurred before the timeout.
 //
 //*****************************************************************************
 bool waitForDRDYinterrupt(const uint32_t timeout_ms)
 {
-    /* --- INSERT YOUR CODE HERE ---
-     * Poll the nDRDY GPIO pin until it goes low. To avoid potential infinite
-     * loops, you may also want to implement a timer interrupt to occur after
-     * the specified timeout period, in case the nDRDY pin is not active.
-     * Return a boolean to indicate if nDRDY went low or if a timeout occurred.
-     */
-
-    // Convert ms to a # of loop iterations, OR even better use a timer here...
-    uint32_t timeout = timeout_ms * 6000;   // convert to # of loop iterations
+    // Convert ms to Clock ticks, rounding up so that a non-zero timeout never becomes BIOS_NO_WAIT
+    uint64_t timeout_us     = (uint64_t) timeout_ms * 1000u;
+    uint64_t timeout_ticks  = (timeout_us + Clock_tickPeriod - 1) / Clock_tickPeriod;
 
-    // Reset interrupt flag
-    flag_nDRDY_INTERRUPT = false;
+    if (timeout_ticks >= BIOS_WAIT_FOREVER) { timeout_ticks = BIOS_WAIT_FOREVER - 1; }
 
-    // Enable interrupts
-    IntMasterEnable();
+    // Wait for nDRDY interrupt or timeout
+    bool interruptOccurred = Semaphore_pend(drdySemaphore, (UInt) timeout_ticks);
 
-    // Wait for nDRDY interrupt or timeout - each iteration is about 20 ticks
-    do {
-        timeout--;
-        Task_sleep(1000);
-    } while (!flag_nDRDY_INTERRUPT && (timeout > 0));
+    // Without /DRDY, keep the 64-bit timestamp extension from missing a wrap-around
+    if (!interruptOccurred) { getTimestamp(); }
 
     // Reset interrupt flag
     flag_nDRDY_INTERRUPT = false;
 
-    // Timeout counter greater than zero indicates that an interrupt occurred
-    return (timeout > 0);
+    return interruptOccurred;
 }
 
+
+
+//*****************************************************************************
+//
+//! Sets or clears the nDRDY interrupt flag.
+//!
+//! \fn void set_flag_nDRDY_INTERRUPT(bool value)
+//!
+//! \param value new flag state.
+//!
+//! NOTE: Clearing the flag also discards a pending /DRDY event, so that the
+//! next call to waitForDRDYinterrupt() waits for a fresh conversion.
+//!
+//! \return None.
+//
+//*****************************************************************************
 void set_flag_nDRDY_INTERRUPT(bool value)
 {
     flag_nDRDY_INTERRUPT = value;
+
+    if (value) { Semaphore_post(drdySemaphore); }
+    else       { Semaphore_reset(drdySemaphore, 0); }
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the number of nDRDY interrupts serviced since startup.
+//!
+//! \fn uint32_t getDRDYinterruptCount(void)
+//!
+//! \return nDRDY interrupt count.
+//
+//*****************************************************************************
+uint32_t getDRDYinterruptCount(void)
+{
+    return drdyInterruptCount;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the cycle count at the most recent nDRDY interrupt.
+//!
+//! \fn uint32_t getDRDYtimestamp(void)
+//!
+//! \return getCycleCount() value sampled in the interrupt handler.
+//
+//*****************************************************************************
+uint32_t getDRDYtimestamp(void)
+{
+    return drdyTimestamp;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the time and sequence number of the most recent nDRDY interrupt.
+//!
+//! \fn uint64_t getDRDYtime(uint32_t *sequence)
+//!
+//! \param sequence pointer that receives the number of the interrupt, counting
+//! from 0 (getDRDYinterruptCount() - 1). Interrupts the reader was too late
+//! for show up as skipped sequence numbers.
+//!
+//! Call after waitForDRDYinterrupt() returns true, before the next interrupt
+//! is due, to get the time of the conversion that is about to be read.
+//!
+//! \return getTimestamp() value sampled in the interrupt handler.
+//
+//*****************************************************************************
+uint64_t getDRDYtime(uint32_t *sequence)
+{
+    UInt key = Hwi_disable();
+    uint64_t time = drdyTime;
+    *sequence = drdyInterruptCount - 1;
+    Hwi_restore(key);
+
+    return time;
+}
+
+
+
+//*****************************************************************************
+//
+//! Replaces the nDRDY pin with a periodic timer interrupt, or restores it.
+//!
+//! \fn bool setSyntheticDRDYrate(const uint32_t rate_Hz)
+//!
+//! \param rate_Hz interrupts per second, or 0 to use the nDRDY pin again.
+//!
+//! Used to benchmark the acquisition path at rates the ADC configuration does
+//! not provide. The reads are real SPI transfers; when the timer runs faster
+//! than the ADC, the device simply returns its latest conversion again.
+//!
+//! The timer is taken from those empty_min.cfg leaves to Timer_ANY on first
+//! use. If none is free, the nDRDY pin stays in use.
+//!
+//! NOTE: Call from task context.
+//!
+//! \return true if no timer was available.
+//
+//*****************************************************************************
+bool setSyntheticDRDYrate(const uint32_t rate_Hz)
+{
+    if (syntheticDrdyTimer) { Timer_stop(syntheticDrdyTimer); }
+
+    if (rate_Hz == 0)
+    {
+        GPIO_enableInt(Board_BUTTON1);
+        return false;
+    }
+
+    uint32_t period_us = 1000000u / rate_Hz;
+    if (period_us < 1) { period_us = 1; }
+
+    if (!syntheticDrdyTimer)
+    {
+        Timer_Params timerParams;
+        Timer_Params_init(&timerParams);
+        timerParams.period      = period_us;
+        timerParams.periodType  = Timer_PeriodType_MICROSECS;
+        timerParams.startMode   = Timer_StartMode_USER;
+
+        Error_Block eb;
+        Error_init(&eb);
+        Timer_construct(&syntheticDrdyTimerStruct, Timer_ANY, SyntheticDRDY_IRQHandler, &timerParams, &eb);
+        if (Error_check(&eb))
+        {
+            return true;
+        }
+        syntheticDrdyTimer = Timer_handle(&syntheticDrdyTimerStruct);
+    }
+    else
+    {
+        Timer_setPeriodMicroSecs(syntheticDrdyTimer, period_us);
+    }
+
+    GPIO_disableInt(Board_BUTTON1);
+    Timer_start(syntheticDrdyTimer);
+    return false;
 }
 
 
@@ -529,7 +903,131 @@ void InitSPI(void)
     //
     unsigned long junk;
     while(MAP_SPIDataGetNonBlocking(GSPI_BASE, &junk));
+
+#ifdef SPI_USE_DMA
+    InitSPIDMA();
+#endif
+}
+
+
+
+#ifdef SPI_USE_DMA
+//*****************************************************************************
+//
+//! Configures the uDMA channels used to move whole SPI frames.
+//!
+//! \fn void InitSPIDMA(void)
+//!
+//! NOTE: Board_initDMA() enables the uDMA controller and installs its control
+//! table. It is safe to call more than once.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void InitSPIDMA(void)
+{
+    Board_initDMA();
+
+    // Route the GSPI requests to the selected channels
+    MAP_uDMAChannelAssign(SPI_DMA_RX_CHANNEL);
+    MAP_uDMAChannelAssign(SPI_DMA_TX_CHANNEL);
+
+    MAP_uDMAChannelAttributeDisable(SPI_DMA_RX_CHANNEL, UDMA_ATTR_ALTSELECT | UDMA_ATTR_USEBURST |
+                                    UDMA_ATTR_HIGH_PRIORITY | UDMA_ATTR_REQMASK);
+    MAP_uDMAChannelAttributeDisable(SPI_DMA_TX_CHANNEL, UDMA_ATTR_ALTSELECT | UDMA_ATTR_USEBURST |
+                                    UDMA_ATTR_HIGH_PRIORITY | UDMA_ATTR_REQMASK);
+
+    // RX: fixed source (RX0 register) -> incrementing buffer, one byte per SPI request
+    MAP_uDMAChannelControlSet(SPI_DMA_RX_CHANNEL | UDMA_PRI_SELECT,
+                              UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_8 | UDMA_ARB_1);
+
+    // TX: incrementing buffer -> fixed destination (TX0 register)
+    MAP_uDMAChannelControlSet(SPI_DMA_TX_CHANNEL | UDMA_PRI_SELECT,
+                              UDMA_SIZE_8 | UDMA_SRC_INC_8 | UDMA_DST_INC_NONE | UDMA_ARB_1);
+
+    // Completion is signaled through the GSPI interrupt
+    Semaphore_Params semParams;
+    Semaphore_Params_init(&semParams);
+    semParams.mode = Semaphore_Mode_BINARY;
+    Semaphore_construct(&spiDmaSemaphoreStruct, 0, &semParams);
+    spiDmaSemaphore = Semaphore_handle(&spiDmaSemaphoreStruct);
+
+    Hwi_Params hwiParams;
+    Hwi_Params_init(&hwiParams);
+    Hwi_construct(&spiDmaHwiStruct, INT_GSPI, SPI_DMA_IRQHandler, &hwiParams, NULL);
+}
+
+
+
+//*****************************************************************************
+//
+//! Interrupt handler for the GSPI uDMA completion interrupt.
+//!
+//! \fn void SPI_DMA_IRQHandler(UArg arg)
+//!
+//! \return None.
+//
+//*****************************************************************************
+void SPI_DMA_IRQHandler(UArg arg)
+{
+    unsigned long status = MAP_SPIIntStatus(GSPI_BASE, true);
+    MAP_SPIIntClear(GSPI_BASE, status);
+
+    // The RX channel finishes last, so it marks the end of the frame
+    if (status & SPI_INT_DMARX)
+    {
+        MAP_SPIIntDisable(GSPI_BASE, SPI_INT_DMARX);
+        Semaphore_post(spiDmaSemaphore);
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Sends and receives a byte array using the uDMA.
+//!
+//! \fn void spiDMATransfer(const uint8_t dataTx[], uint8_t dataRx[], const uint8_t byteLength)
+//!
+//! \param const uint8_t dataTx[] byte array of SPI data to send on MOSI.
+//!
+//! \param uint8_t dataRx[] byte array of SPI data captured on MISO.
+//!
+//! \param uint8_t byteLength number of bytes to send & receive.
+//!
+//! NOTE: Must be called from a Task, as it blocks until the transfer completes.
+//! This function does not control the /CS pin.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void spiDMATransfer(const uint8_t dataTx[], uint8_t dataRx[], const uint8_t byteLength)
+{
+    // Remove any residual or old data from the receive register
+    unsigned long junk;
+    while(MAP_SPIDataGetNonBlocking(GSPI_BASE, &junk));
+
+    MAP_uDMAChannelTransferSet(SPI_DMA_RX_CHANNEL | UDMA_PRI_SELECT, UDMA_MODE_BASIC,
+                               (void *) (GSPI_BASE + MCSPI_O_RX0), (void *) dataRx, byteLength);
+    MAP_uDMAChannelTransferSet(SPI_DMA_TX_CHANNEL | UDMA_PRI_SELECT, UDMA_MODE_BASIC,
+                               (void *) dataTx, (void *) (GSPI_BASE + MCSPI_O_TX0), byteLength);
+
+    MAP_uDMAChannelEnable(SPI_DMA_RX_CHANNEL);
+    MAP_uDMAChannelEnable(SPI_DMA_TX_CHANNEL);
+
+    MAP_SPIIntClear(GSPI_BASE, SPI_INT_DMARX);
+    MAP_SPIIntEnable(GSPI_BASE, SPI_INT_DMARX);
+
+    // Enabling the DMA requests starts the transfer
+    MAP_SPIDmaEnable(GSPI_BASE, SPI_RX_DMA | SPI_TX_DMA);
+
+    // The CPU is free for other tasks until the last byte has been received
+    Semaphore_pend(spiDmaSemaphore, BIOS_WAIT_FOREVER);
+
+    // Return the peripheral to CPU-driven transfers
+    MAP_SPIDmaDisable(GSPI_BASE, SPI_RX_DMA | SPI_TX_DMA);
 }
+#endif
 
 
 
@@ -570,7 +1068,17 @@ void spiSendReceiveArrays(const uint8_t dataTx[], uint8_t dataRx[], const uint8_
     assert(dataTx && dataRx);
 
     // Set the nCS pin LOW
-    MAP_SPICSEnable(GSPI_BASE);
+    setCS(LOW);
+
+#ifdef SPI_USE_DMA
+    // Whole frames are moved by the uDMA, as long as the caller is allowed to block
+    if ((byteLength >= SPI_DMA_MIN_TRANSFER_SIZE) && (BIOS_getThreadType() == BIOS_ThreadType_Task))
+    {
+        spiDMATransfer(dataTx, dataRx, byteLength);
+        setCS(HIGH);
+        return;
+    }
+#endif
 
     // Send all dataTx[] bytes on MOSI, and capture all MISO bytes in dataRx[]
     int i;
@@ -580,7 +1088,7 @@ void spiSendReceiveArrays(const uint8_t dataTx[], uint8_t dataRx[], const uint8_
     }
 
     // Set the nCS pin HIGH
-    MAP_SPICSDisable(GSPI_BASE);
+    setCS(HIGH);
 }
 
 
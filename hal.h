@@ -55,6 +55,8 @@
 //****************************************************************************
 
 /*  --- INSERT YOUR CODE HERE --- */
+/* HOST_BUILD selects the simulated HAL in host/ instead of the CC3200 drivers */
+#ifndef HOST_BUILD
 #include "hw_types.h"
 #include "hw_memmap.h"
 #include "hw_common_reg.h"
@@ -77,6 +79,7 @@
 #include "timer.h"
 #include "utils.h"
 #include "prcm.h"
+#endif
 
 
 
@@ -123,6 +126,57 @@
 //#define CLKIN_PORT          (GPIO_PORTG_BASE)
 //#define CLKIN_PIN           (GPIO_PIN_1)
 
+/* Frequency of the clock at the ADC CLKIN pin; sets the output data rate */
+#define CLKIN_FREQUENCY_HZ  ((uint32_t) 8192000)
+
+/* CPU clock; the DWT cycle counter runs at this rate */
+#define CPU_CLOCK_HZ        ((uint32_t) 80000000)
+
+/* Free-running general-purpose timer that timestamps each /DRDY interrupt
+ * (see getDRDYtime()); counts up at the 80 MHz peripheral clock */
+#define TIMESTAMP_TIMER_BASE        (TIMERA1_BASE)
+#define TIMESTAMP_TIMER_PRCM        (PRCM_TIMERA1)
+#define TIMESTAMP_FREQUENCY_HZ      (CPU_CLOCK_HZ)
+
+
+
+//*****************************************************************************
+//
+// SPI transfer settings
+//
+//*****************************************************************************
+
+#define SPI_IF_BIT_RATE             ((uint32_t) 10000000)
+
+/* Enable this define statement to move ADC data frames with the uDMA... */
+#define SPI_USE_DMA
+
+/* Transfers shorter than this (register commands) are always clocked by the CPU */
+#define SPI_DMA_MIN_TRANSFER_SIZE   ((uint8_t) 8)
+
+#define SPI_DMA_RX_CHANNEL          (UDMA_CH6_GSPI_RX)
+#define SPI_DMA_TX_CHANNEL          (UDMA_CH7_GSPI_TX)
+
+
+
+//*****************************************************************************
+//
+// Cycle counter
+//
+//*****************************************************************************
+
+/* CYCLE_COUNT() reads the Cortex-M4 DWT cycle counter inline, for
+ * instrumentation in interrupt handlers and other hot paths. It counts CPU
+ * clock cycles and wraps around every 53 s at 80 MHz; the counter is started
+ * by InitADC(). getCycleCount() returns the same value.
+ */
+#ifndef HOST_BUILD
+#define DWT_CYCCNT          (*((volatile uint32_t *) 0xE0001004))
+#define CYCLE_COUNT()       (DWT_CYCCNT)
+#else
+#define CYCLE_COUNT()       getCycleCount()
+#endif
+
 
 
 //*****************************************************************************
@@ -142,6 +196,14 @@ void    spiSendReceiveArrays(const uint8_t DataTx[], uint8_t DataRx[], const uin
 uint8_t spiSendReceiveByte(const uint8_t dataTx);
 void    set_flag_nDRDY_INTERRUPT(bool value);
 bool    waitForDRDYinterrupt(const uint32_t timeout_ms);
+uint32_t getDRDYinterruptCount(void);
+uint32_t getDRDYtimestamp(void);
+uint64_t getDRDYtime(uint32_t *sequence);
+uint64_t getTimestamp(void);
+uint32_t getTimestampFrequency(void);
+bool    setSyntheticDRDYrate(const uint32_t rate_Hz);
+uint32_t getCycleCount(void);
+uint32_t getCycleFrequency(void);
 
 
 // Functions used for testing only
@@ -0,0 +1,402 @@
+/**
+ * \brief Measures the sustained throughput of the acquisition pipeline on a
+ * workstation.
+ *
+ * Conversions go through the same path as on the target: readData() on the
+ * simulated device, the sample ring, convertToMicrovolts() and the text
+ * formatter or the stream batch encoder, and a write() per packet to
+ * /dev/null standing in for the network send. The pipeline is instrumented
+ * with the BENCH_* macros of benchmark.h, and the run ends with the stage
+ * statistics and histograms the target prints on its UART. Cycle counts are
+ * nanoseconds here.
+ *
+ * The DRDY source is synthetic (see setSyntheticDRDYrate()): at a fixed rate,
+ * conversions that the pipeline is too slow to pick up are lost and counted
+ * as dropped; without a rate, conversions are produced as fast as they are
+ * read, which measures the ceiling of the pipeline.
+ *
+ * With a link capacity, packets also go through a simulated link that
+ * transmits them one after the other at that rate and loses those that find
+ * more than LINK_BACKLOG_MS of transmission queued, as a client whose queue is
+ * full would. The stream adapts to it as the firmware does (see
+ * streamAdaptToLink()), and the run reports the link mode it ended in.
+ *
+ * With -z, packets are compressed before they are sent (STREAM_ENCODING_RICE)
+ * and the report gives the encoder cycles per sample. The inputs of the
+ * simulated device are grounded here, so the ratio is that of quiet inputs;
+ * codec_bench measures it on recorded signals.
+ *
+ * Usage: adc_bench [-n conversions] [-R rate_Hz] [-o osr[,hr|lp|vlp]] [-m mask]
+ *                  [-b records] [-l latency_ms] [-L bytes_per_s] [-z] [-t]
+ *   -n  number of DRDY events to run (default 200000)
+ *   -R  synthetic DRDY rate in Hz (default 0: as fast as possible)
+ *   -o  oversampling ratio (and power mode), which sets the automatic batch size
+ *   -m  channel enable mask (default: all)
+ *   -b  records per packet, 0 = sized from the data rate (default 0)
+ *   -l  batch latency in ms (default STREAM_DEFAULT_BATCH_LATENCY_MS)
+ *   -L  capacity of the simulated link in bytes/s, binary packets only
+ *       (default 0: no link)
+ *   -z  send STREAM_ENCODING_RICE packets
+ *   -t  send one CSV text frame of microvolts per conversion instead of packets
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ads131m0x.h"
+#include "adc_control.h"
+#include "adc_stream.h"
+#include "benchmark.h"
+#include "sample_ring.h"
+#include "hal_sim.h"
+
+#ifndef ENABLE_BENCHMARK
+#error "adc_bench needs ENABLE_BENCHMARK (see host/Makefile)"
+#endif
+
+
+
+//****************************************************************************
+//
+// Internal macros
+//
+//****************************************************************************
+
+/* Transmission time the simulated link queues before it loses packets */
+#define LINK_BACKLOG_MS     (100)
+
+
+
+//****************************************************************************
+//
+// Internal variables
+//
+//****************************************************************************
+
+// Stand-in for the websocket
+static int sinkFd = -1;
+
+// Simulated link: capacity (0 for none), time it is busy until, and statistics
+static uint32_t linkCapacity = 0;
+static uint64_t linkFree_ns = 0;
+static uint64_t linkBusy_ns = 0;
+static uint32_t linkLostFrames = 0;
+static uint32_t linkLostTotal = 0;
+
+
+
+//*****************************************************************************
+//
+//! Queues a packet on the simulated link.
+//!
+//! \return false if the link lost it.
+//
+//*****************************************************************************
+static bool linkTransmit(uint16_t length)
+{
+    uint64_t now_ns = halSimGetTime_ns();
+    uint64_t transmit_ns = ((uint64_t) length * 1000000000u) / linkCapacity;
+
+    if (linkFree_ns < now_ns) { linkFree_ns = now_ns; }
+    if ((linkFree_ns - now_ns) > ((uint64_t) LINK_BACKLOG_MS * 1000000u))
+    {
+        linkLostFrames++;
+        linkLostTotal++;
+        return false;
+    }
+
+    linkFree_ns += transmit_ns;
+    linkBusy_ns += transmit_ns;
+    return true;
+}
+
+
+
+//*****************************************************************************
+//
+//! Sends a finished batch to the sink, as sendBatch() in empty_min.c does.
+//
+//*****************************************************************************
+static void sendBatch(stream_batch *batch)
+{
+    if (batch->count == 0) { return; }
+
+    if (streamGetEncoding() != STREAM_ENCODING_RAW)
+    {
+        uint16_t rawBytes = batch->length;
+
+        BENCH_START(encodeStart);
+        streamBatchEncode(batch);
+        BENCH_END(BENCH_STAGE_ENCODE, encodeStart);
+        BENCH_ENCODED((uint32_t) batch->count * ((batch->recordBytes - 2u) / STREAM_CODE_BYTES), rawBytes,
+                      batch->length);
+    }
+
+    BENCH_START(sendStart);
+    if (write(sinkFd, batch->buffer, batch->length) != (ssize_t) batch->length)
+    {
+        perror("write");
+    }
+    BENCH_END(BENCH_STAGE_SEND, sendStart);
+    BENCH_SENT(batch->firstSequence, batch->count, batch->decimation, batch->conversions);
+
+    // Published, as far as the sender is concerned; the link may still lose it
+    if (linkCapacity && !linkTransmit(batch->length))
+    {
+        streamCountSendFailure(batch->conversions);
+    }
+
+    streamBatchReset(batch);
+}
+
+
+
+//*****************************************************************************
+//
+//! Moves the record formed by the decimator into the batch, as packRecord()
+//! in empty_min.c does.
+//
+//*****************************************************************************
+static void packRecord(stream_decimator *decimator, stream_batch *batch, uint32_t now_ms)
+{
+    stream_record packed;
+
+    if (!streamDecimatorTake(decimator, &packed)) { return; }
+
+    if (!streamBatchAccepts(batch, &packed))
+    {
+        sendBatch(batch);
+    }
+    BENCH_START(packStart);
+    streamBatchAdd(batch, &packed, now_ms);
+    BENCH_END(BENCH_STAGE_PACK, packStart);
+
+    if (streamBatchFlushDue(batch, now_ms))
+    {
+        sendBatch(batch);
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Adapts the stream to the simulated link, as adaptToLink() in empty_min.c
+//! does.
+//
+//*****************************************************************************
+static void adaptToLink(uint32_t interval_ms)
+{
+    stream_link_stats link;
+
+    link.interval_us = interval_ms * 1000u;
+    link.busy_us = (uint32_t) (linkBusy_ns / 1000u);
+    link.lostFrames = linkLostFrames;
+    linkBusy_ns = 0;
+    linkLostFrames = 0;
+
+    if (streamAdaptToLink(&link))
+    {
+        printf("link:             %u%% busy, %u lost -> mode %u, decimation %u, %u records per packet\n",
+               (unsigned) (((uint64_t) link.busy_us * 100u) / link.interval_us), (unsigned) link.lostFrames,
+               (unsigned) streamGetMode(), (unsigned) streamGetDecimation(), (unsigned) streamGetBatchRecords());
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Formats and sends one conversion as a text frame, as senderTask() does
+//! with STREAM_TEXT_FORMAT.
+//
+//*****************************************************************************
+static void sendText(const sample_record *record)
+{
+    char data[12 * CHANNEL_COUNT + 4];
+    int32_t microvolts[CHANNEL_COUNT];
+    int length = 0;
+    uint8_t channel;
+
+    BENCH_START(scaleStart);
+    convertToMicrovolts(&record->data, microvolts);
+    BENCH_END(BENCH_STAGE_SCALE, scaleStart);
+
+    BENCH_START(packStart);
+    for (channel = 0; channel < CHANNEL_COUNT; channel++)
+    {
+        if (record->data.channelMask & (1u << channel))
+        {
+            length += snprintf(&data[length], sizeof(data) - length, length ? ",%ld" : "%ld",
+                               (long) microvolts[channel]);
+        }
+    }
+    BENCH_END(BENCH_STAGE_PACK, packStart);
+
+    BENCH_START(sendStart);
+    if (write(sinkFd, data, (size_t) length) != (ssize_t) length)
+    {
+        perror("write");
+    }
+    BENCH_END(BENCH_STAGE_SEND, sendStart);
+    BENCH_SENT(record->sequence, 1, 1, 1);
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    uint32_t events = 200000;
+    uint32_t drdyRate_Hz = 0;
+    const char *rate = NULL;
+    long channelMask = -1;
+    long batchRecords = -1;
+    long batchLatency_ms = -1;
+    bool textFormat = false;
+    int option;
+
+    while ((option = getopt(argc, argv, "n:R:o:m:b:l:L:zt")) != -1)
+    {
+        switch (option)
+        {
+            case 'n':   events = (uint32_t) strtoul(optarg, NULL, 0);                      break;
+            case 'R':   drdyRate_Hz = (uint32_t) strtoul(optarg, NULL, 0);                 break;
+            case 'o':   rate = optarg;                                                      break;
+            case 'm':   channelMask = strtol(optarg, NULL, 0);                              break;
+            case 'b':   batchRecords = strtol(optarg, NULL, 0);                             break;
+            case 'l':   batchLatency_ms = strtol(optarg, NULL, 0);                          break;
+            case 'L':   linkCapacity = (uint32_t) strtoul(optarg, NULL, 0);                 break;
+            case 'z':   streamSetEncoding(STREAM_ENCODING_RICE);                            break;
+            case 't':   textFormat = true;                                                  break;
+            default:
+                fprintf(stderr, "usage: %s [-n conversions] [-R rate_Hz] [-o osr[,hr|lp|vlp]] [-m mask]"
+                                " [-b records] [-l latency_ms] [-L bytes_per_s] [-z] [-t]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    sinkFd = open("/dev/null", O_WRONLY);
+    if (sinkFd < 0)
+    {
+        perror("/dev/null");
+        return 2;
+    }
+
+    // Configure the device and the stream through the same paths as the firmware
+    InitADC();
+    adcControlInit();
+    if (rate)
+    {
+        char *end;
+        uint16_t osr = (uint16_t) strtoul(rate, &end, 0);
+        uint16_t powerMode = !strcmp(end, ",lp")  ? CLOCK_PWR_LP  :
+                             !strcmp(end, ",vlp") ? CLOCK_PWR_VLP : CLOCK_PWR_HR;
+
+        adcControlRequestDataRate(osr, powerMode);
+    }
+    if (channelMask >= 0)
+    {
+        adcControlRequestChannelMask((uint8_t) channelMask);
+    }
+    adcControlService();
+
+    streamSetFlushPolicy((batchRecords >= 0) ? (uint16_t) batchRecords : STREAM_DEFAULT_BATCH_RECORDS,
+                         (batchLatency_ms >= 0) ? (uint32_t) batchLatency_ms : STREAM_DEFAULT_BATCH_LATENCY_MS);
+
+    // Starts the DRDY source and the statistics together
+    sampleRingReset();
+    adcControlRequestDrdyRate(drdyRate_Hz);
+    adcControlService();
+
+    static stream_batch batch;
+    stream_decimator decimator;
+    sample_record record;
+    uint32_t lastAdapt_ms = (uint32_t) (halSimGetTime_ns() / 1000000u);
+
+    streamBatchReset(&batch);
+    streamDecimatorReset(&decimator);
+
+    while (getDRDYinterruptCount() < events)
+    {
+        if (!waitForDRDYinterrupt(100)) { break; }
+
+        // Acquisition side, as in adcTask()
+        BENCH_START(readStart);
+        record.timestamp = getDRDYtime(&record.sequence);
+        streamTrackSequence(record.sequence);
+        bool crcError = readData(&record.data);
+        BENCH_END(BENCH_STAGE_READ, readStart);
+        BENCH_CONVERSION(record.sequence, readStart, crcError);
+
+        if (!crcError)
+        {
+            sampleRingPush(&record);
+        }
+
+        // Sender side, as in senderTask()
+        uint32_t now_ms = (uint32_t) (halSimGetTime_ns() / 1000000u);
+        while (sampleRingPop(&record))
+        {
+            if (textFormat)
+            {
+                sendText(&record);
+                continue;
+            }
+
+            if (!streamDecimatorAccepts(&decimator, &record))
+            {
+                packRecord(&decimator, &batch, now_ms);
+            }
+            streamDecimatorAdd(&decimator, &record);
+            if (streamDecimatorComplete(&decimator))
+            {
+                packRecord(&decimator, &batch, now_ms);
+            }
+        }
+
+        if (linkCapacity && ((uint32_t) (now_ms - lastAdapt_ms) >= STREAM_ADAPT_INTERVAL_MS))
+        {
+            adaptToLink(now_ms - lastAdapt_ms);
+            lastAdapt_ms = now_ms;
+        }
+    }
+    packRecord(&decimator, &batch, 0);
+    sendBatch(&batch);
+
+    bench_report report;
+    benchGetReport(&report);
+
+    printf("DRDY source:      %s, %u events\n", drdyRate_Hz ? "synthetic" : "free-running", (unsigned) report.drdyEvents);
+    if (drdyRate_Hz) { printf("DRDY rate:        %u Hz\n", (unsigned) drdyRate_Hz); }
+    printf("format:           %s, channel mask 0x%02X, %u records per packet\n",
+           textFormat ? "text" : "binary", (unsigned) getChannelEnableMask(), (unsigned) streamGetBatchRecords());
+    if (linkCapacity)
+    {
+        printf("link:             %u bytes/s, %u packets lost, mode %u, decimation %u\n", (unsigned) linkCapacity,
+               (unsigned) linkLostTotal, (unsigned) streamGetMode(), (unsigned) streamGetDecimation());
+    }
+    printf("throughput:       %u samples/s (%u sent in %.3f s)\n", (unsigned) report.samplesPerSecond,
+           (unsigned) report.sent, (double) report.elapsed_us / 1e6);
+    printf("dropped:          %u (%u DRDY not read, %u CRC errors, %u ring overflows)\n", (unsigned) report.dropped,
+           (unsigned) (report.drdyEvents - report.conversions), (unsigned) report.crcErrors, (unsigned) report.overflows);
+    printf("latency:          p50 %u us, p90 %u us, p99 %u us, max %u us\n", (unsigned) report.latencyP50_us,
+           (unsigned) report.latencyP90_us, (unsigned) report.latencyP99_us, (unsigned) report.latencyMax_us);
+
+    // Compression, stage statistics and histograms as the target reports them
+    char line[BENCH_REPORT_LINE_BYTES];
+    uint16_t n;
+    for (n = 2; benchFormatReportLine(&report, n, line, sizeof(line)); n++)
+    {
+        if (line[0]) { printf("%s\n", line); }
+    }
+
+    close(sinkFd);
+    // Every conversion read must be either sent or counted as dropped
+    return ((report.crcErrors == 0) &&
+            ((report.sent + report.overflows) == report.conversions)) ? 0 : 1;
+}
@@ -0,0 +1,441 @@
+/**
+ * \brief Runs the ADS131M0x driver and stream pipeline against the simulated
+ * device on a workstation.
+ *
+ * The registers configured by adcStartup() are first compared with the model.
+ * Every conversion is then read with readData(), checked against the model,
+ * converted to microvolts and checked against a floating-point reference,
+ * pushed through the sample ring and packed into stream batches, exactly as
+ * the firmware tasks do. The run ends with a summary and a non-zero exit
+ * status if any conversion was decoded or scaled wrongly, failed its CRC
+ * check, was stamped out of order or was packed into a packet of the wrong
+ * size, link mode or with the wrong timestamps, or if the sequence numbers
+ * skipped between packets do not add up to the losses the stream counted.
+ * Decimated streams hide the conversions lost within a group, so there the
+ * skipped sequence numbers must only not exceed the losses. With -z, every
+ * packet is also compressed and must decode to the raw packet exactly.
+ *
+ * Usage: adc_sim [-n conversions] [-c clkin_Hz] [-g gain1] [-o osr[,hr|lp|vlp]] [-m mask] [-d steps] [-z] [-r]
+ *   -n  number of conversions to run (default 100000)
+ *   -c  CLKIN frequency of the model in Hz (default 8192000)
+ *   -g  GAIN1 register value written after start-up (default: adcStartup()'s)
+ *   -o  oversampling ratio (and power mode) requested through adc_control.h
+ *   -m  channel enable mask requested through adc_control.h (default: all)
+ *   -d  link mode steps down before the run, as after that many bad intervals
+ *       (1: batched, 2 and up: decimated by 2, 4, ...; default 0)
+ *   -z  send STREAM_ENCODING_RICE packets
+ *   -r  pace conversions at the model's data rate instead of running flat out
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ads131m0x.h"
+#include "adc_control.h"
+#include "adc_stream.h"
+#include "sample_ring.h"
+#include "hal_sim.h"
+#include "ads131m04_model.h"
+#include "stream_decoder.h"
+
+
+
+//****************************************************************************
+//
+// Internal variables
+//
+//****************************************************************************
+
+/* Test signals applied to the model inputs (volts at the pins, PGA gain 8) */
+static const model_generator testSignals[] = {
+    { MODEL_WAVE_SINE,      0.100,  50.0,   0.0,    0.0     },
+    { MODEL_WAVE_SQUARE,    0.050,  10.0,   0.010,  0.0     },
+    { MODEL_WAVE_TRIANGLE,  0.120,  5.0,    -0.010, 0.0     },
+    { MODEL_WAVE_DC,        0.0,    0.0,    0.020,  0.0005  },
+};
+
+// Client view of the stream: next sequence number expected, and the number skipped
+static bool         sequenceSeen = false;
+static uint32_t     nextSequence = 0;
+static uint32_t     skippedSequences = 0;
+
+// Size of the packets before streamBatchEncode()
+static uint64_t     rawPacketBytes = 0;
+
+
+
+//*****************************************************************************
+//
+//! Returns the input voltage of a code in microvolts, in floating point.
+//
+//*****************************************************************************
+static double referenceMicrovolts(int32_t code, uint8_t channel)
+{
+    uint16_t gainRegister = getRegisterValue((channel < 4) ? GAIN1_ADDRESS : GAIN2_ADDRESS);
+    double gain = (double) (1u << ((gainRegister >> (4 * (channel % 4))) & 0x7));
+
+    return (double) code * (2.0 * REFERENCE_UV) / gain / (double) (1ul << CODE_BITS);
+}
+
+
+
+//*****************************************************************************
+//
+//! Reads a little-endian value from a packet.
+//
+//*****************************************************************************
+static uint64_t getLE(const uint8_t *src, uint8_t bytes)
+{
+    uint64_t value = 0;
+
+    while (bytes--) { value = (value << 8) | src[bytes]; }
+    return value;
+}
+
+
+
+//*****************************************************************************
+//
+//! Checks the header of a finished batch, sends it to nowhere and counts it.
+//! Host timestamps are in nanoseconds already, so the header must hold the
+//! first record's timestamp and the span to lastTimestamp unchanged. The link
+//! mode does not change during a run.
+//
+//*****************************************************************************
+static void flushBatch(stream_batch *batch, uint64_t lastTimestamp, uint32_t *packets, uint64_t *bytes,
+                       uint32_t *packetErrors)
+{
+    if (batch->count == 0) { return; }
+
+    // Records hold the channels of the header mask and nothing else
+    uint8_t channelMask = batch->buffer[1];
+    uint8_t channels = 0;
+    uint8_t channel;
+    for (channel = 0; channel < 8; channel++)
+    {
+        if (channelMask & (1u << channel)) { channels++; }
+    }
+    if ((batch->buffer[0] != STREAM_VERSION) || (channelMask != getChannelEnableMask()) ||
+        (batch->length != STREAM_HEADER_BYTES + (batch->count * STREAM_RECORD_BYTES(channels))) ||
+        (batch->length > STREAM_MAX_PACKET_BYTES) || (streamPacketBytes(batch->buffer) != batch->length) ||
+        (batch->buffer[20] != streamGetMode()) || (batch->buffer[21] != streamGetDecimation()) ||
+        (getLE(&batch->buffer[8], 8) != batch->firstTimestamp) ||
+        (getLE(&batch->buffer[16], 4) != (lastTimestamp - batch->firstTimestamp)))
+    {
+        if (*packetErrors < 5)
+        {
+            fprintf(stderr, "packet %u: mask 0x%02X, %u records in %u bytes, time %llu + %llu ns, mode %u/%u\n",
+                    (unsigned) *packets, (unsigned) channelMask, (unsigned) batch->count, (unsigned) batch->length,
+                    (unsigned long long) getLE(&batch->buffer[8], 8), (unsigned long long) getLE(&batch->buffer[16], 4),
+                    (unsigned) batch->buffer[20], (unsigned) batch->buffer[21]);
+        }
+        (*packetErrors)++;
+    }
+
+    // Count the records lost between packets, as a client would
+    uint32_t sequence = (uint32_t) getLE(&batch->buffer[4], 4);
+    if (sequenceSeen) { skippedSequences += sequence - nextSequence; }
+    nextSequence = streamRecordSequence(sequence, batch->count, batch->buffer[21]);
+    sequenceSeen = true;
+
+    // A compressed packet must give the raw one back, as a client decodes it
+    static uint8_t raw[STREAM_MAX_PACKET_BYTES];
+    static uint8_t decoded[STREAM_MAX_PACKET_BYTES];
+    uint16_t rawLength = batch->length;
+
+    memcpy(raw, batch->buffer, rawLength);
+    streamBatchEncode(batch);
+    if ((streamPacketBytes(batch->buffer) != batch->length) ||
+        (streamDecodePacket(batch->buffer, batch->length, decoded) != rawLength) ||
+        memcmp(decoded, raw, rawLength))
+    {
+        if (*packetErrors < 5)
+        {
+            fprintf(stderr, "packet %u: encoding %u in %u bytes does not decode to the raw packet\n",
+                    (unsigned) *packets, (unsigned) batch->buffer[22], (unsigned) batch->length);
+        }
+        (*packetErrors)++;
+    }
+
+    (*packets)++;
+    *bytes += batch->length;
+    rawPacketBytes += rawLength;
+    streamBatchReset(batch);
+}
+
+
+
+//*****************************************************************************
+//
+//! Moves the record formed by the decimator into the batch, flushing the
+//! batch as senderTask() does.
+//
+//*****************************************************************************
+static void packRecord(stream_decimator *decimator, stream_batch *batch, uint32_t now_ms, uint64_t *lastTimestamp,
+                       uint32_t *packets, uint64_t *bytes, uint32_t *packetErrors)
+{
+    stream_record packed;
+
+    if (!streamDecimatorTake(decimator, &packed)) { return; }
+
+    if (!streamBatchAccepts(batch, &packed))
+    {
+        flushBatch(batch, *lastTimestamp, packets, bytes, packetErrors);
+    }
+    streamBatchAdd(batch, &packed, now_ms);
+    *lastTimestamp = packed.timestamp;
+
+    if (streamBatchFlushDue(batch, now_ms))
+    {
+        flushBatch(batch, *lastTimestamp, packets, bytes, packetErrors);
+    }
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    uint32_t conversions = 100000;
+    long gain1 = -1;
+    const char *rate = NULL;
+    long channelMask = -1;
+    uint32_t linkSteps = 0;
+    bool realTime = false;
+    int option;
+
+    while ((option = getopt(argc, argv, "n:c:g:o:m:d:zr")) != -1)
+    {
+        switch (option)
+        {
+            case 'n':   conversions = (uint32_t) strtoul(optarg, NULL, 0);                 break;
+            case 'c':   modelSetClockFrequency((uint32_t) strtoul(optarg, NULL, 0));       break;
+            case 'g':   gain1 = strtol(optarg, NULL, 0);                                    break;
+            case 'o':   rate = optarg;                                                      break;
+            case 'm':   channelMask = strtol(optarg, NULL, 0);                              break;
+            case 'd':   linkSteps = (uint32_t) strtoul(optarg, NULL, 0);                    break;
+            case 'z':   streamSetEncoding(STREAM_ENCODING_RICE);                            break;
+            case 'r':   realTime = true;                                                    break;
+            default:
+                fprintf(stderr, "usage: %s [-n conversions] [-c clkin_Hz] [-g gain1] [-o osr[,hr|lp|vlp]] [-m mask] [-d steps] [-z]"
+                                " [-r]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    uint8_t channel;
+    for (channel = 0; channel < CHANNEL_COUNT; channel++)
+    {
+        modelSetGenerator(channel, &testSignals[channel % (sizeof(testSignals) / sizeof(testSignals[0]))]);
+    }
+
+    uint32_t registerErrors = 0;
+
+    InitADC();
+    if (gain1 >= 0)
+    {
+        stageRegister(GAIN1_ADDRESS, (uint16_t) gain1);
+        if (commitRegisters())
+        {
+            fprintf(stderr, "GAIN1 commit failed\n");
+            registerErrors++;
+        }
+    }
+
+    // Data rate changes go through the same request path as in adcTask()
+    adcControlInit();
+    if (rate)
+    {
+        char *end;
+        uint16_t osr = (uint16_t) strtoul(rate, &end, 0);
+        uint16_t powerMode = !strcmp(end, ",lp")  ? CLOCK_PWR_LP  :
+                             !strcmp(end, ",vlp") ? CLOCK_PWR_VLP : CLOCK_PWR_HR;
+
+        adcControlRequestDataRate(osr, powerMode);
+        adcControlService();
+
+        adc_timing requested;
+        getAdcTiming(&requested);
+        if ((requested.osr != osr) || (requested.powerMode != powerMode))
+        {
+            fprintf(stderr, "data rate %s rejected\n", rate);
+            registerErrors++;
+        }
+    }
+    if (channelMask >= 0)
+    {
+        adcControlRequestChannelMask((uint8_t) channelMask);
+        adcControlService();
+        if (getChannelEnableMask() != (uint8_t) channelMask)
+        {
+            fprintf(stderr, "channel mask 0x%02X rejected\n", (unsigned) channelMask);
+            registerErrors++;
+        }
+    }
+
+    // The driver's register map and timing must match the device after start-up
+    uint32_t startupFrames = halSimGetFrameCount();
+    adc_timing timing;
+    getAdcTiming(&timing);
+    uint16_t deviceClock = modelGetRegister(CLOCK_ADDRESS);
+    if ((timing.osr != OSR_FROM_CODE((deviceClock & CLOCK_OSR_MASK) >> 2)) ||
+        (timing.powerMode != (deviceClock & CLOCK_PWR_MASK)))
+    {
+        fprintf(stderr, "timing: driver OSR %u, device CLOCK 0x%04X\n", (unsigned) timing.osr, (unsigned) deviceClock);
+        registerErrors++;
+    }
+    uint8_t address;
+    for (address = FIRST_CONFIG_ADDRESS; address <= LAST_CONFIG_ADDRESS; address++)
+    {
+        if (getRegisterValue(address) != modelGetRegister(address))
+        {
+            fprintf(stderr, "register 0x%02X: driver 0x%04X, device 0x%04X\n", (unsigned) address,
+                    (unsigned) getRegisterValue(address), (unsigned) modelGetRegister(address));
+            registerErrors++;
+        }
+    }
+    sampleRingReset();
+    halSimSetRealTime(realTime);
+
+    // Each interval with a lost frame steps the link mode down by one
+    stream_link_stats badLink = { 1000, 0, 1 };
+    while (linkSteps--) { streamAdaptToLink(&badLink); }
+
+    static stream_batch batch;
+    stream_decimator decimator;
+    sample_record record;
+    uint32_t crcErrors = 0;
+    uint32_t mismatches = 0;
+    uint32_t scaleErrors = 0;
+    uint32_t packetErrors = 0;
+    uint32_t timestampErrors = 0;
+    uint64_t previousTimestamp = 0;
+    uint64_t lastTimestamp = 0;
+    int32_t microvolts[CHANNEL_COUNT];
+    uint32_t packets = 0;
+    uint64_t bytes = 0;
+    uint32_t n;
+
+    streamBatchReset(&batch);
+    streamDecimatorReset(&decimator);
+
+    uint64_t start_ns = halSimGetTime_ns();
+
+    for (n = 0; n < conversions; n++)
+    {
+        if (!waitForDRDYinterrupt(100)) { break; }
+
+        // Acquisition side, as in adcTask()
+        record.timestamp = getDRDYtime(&record.sequence);
+        streamTrackSequence(record.sequence);
+        if ((n > 0) && (record.timestamp <= previousTimestamp))
+        {
+            if (timestampErrors < 5)
+            {
+                fprintf(stderr, "conversion %u: timestamp %llu ns not after %llu ns\n", (unsigned) n,
+                        (unsigned long long) record.timestamp, (unsigned long long) previousTimestamp);
+            }
+            timestampErrors++;
+        }
+        previousTimestamp = record.timestamp;
+        if (readData(&record.data))
+        {
+            streamCountCrcError();
+            crcErrors++;
+            continue;
+        }
+
+        for (channel = 0; channel < CHANNEL_COUNT; channel++)
+        {
+            if (record.data.channel[channel] != modelGetExpectedCode(channel))
+            {
+                if (mismatches < 5)
+                {
+                    fprintf(stderr, "conversion %u channel %u: decoded %ld, expected %ld\n",
+                            (unsigned) n, (unsigned) channel,
+                            (long) record.data.channel[channel], (long) modelGetExpectedCode(channel));
+                }
+                mismatches++;
+            }
+        }
+
+        // Fixed-point scaling must round to the nearest microvolt; disabled channels read 0 uV
+        convertToMicrovolts(&record.data, microvolts);
+        for (channel = 0; channel < CHANNEL_COUNT; channel++)
+        {
+            double expected = (record.data.channelMask & (1u << channel)) ?
+                              referenceMicrovolts(record.data.channel[channel], channel) : 0.0;
+            if (fabs((double) microvolts[channel] - expected) > 0.5 + 1e-6)
+            {
+                if (scaleErrors < 5)
+                {
+                    fprintf(stderr, "conversion %u channel %u: %ld uV, expected %.3f uV\n",
+                            (unsigned) n, (unsigned) channel, (long) microvolts[channel], expected);
+                }
+                scaleErrors++;
+            }
+        }
+
+        sampleRingPush(&record);
+
+        // Sender side, as in senderTask()
+        uint32_t now_ms = (uint32_t) ((halSimGetTime_ns() - start_ns) / 1000000u);
+        while (sampleRingPop(&record))
+        {
+            if (!streamDecimatorAccepts(&decimator, &record))
+            {
+                packRecord(&decimator, &batch, now_ms, &lastTimestamp, &packets, &bytes, &packetErrors);
+            }
+            streamDecimatorAdd(&decimator, &record);
+            if (streamDecimatorComplete(&decimator))
+            {
+                packRecord(&decimator, &batch, now_ms, &lastTimestamp, &packets, &bytes, &packetErrors);
+            }
+        }
+    }
+    packRecord(&decimator, &batch, 0, &lastTimestamp, &packets, &bytes, &packetErrors);
+    flushBatch(&batch, lastTimestamp, &packets, &bytes, &packetErrors);
+
+    double elapsed = (double) (halSimGetTime_ns() - start_ns) / 1e9;
+    sample_ring_stats stats;
+    sampleRingGetStats(&stats);
+
+    printf("startup frames:   %u, register errors %u\n", (unsigned) startupFrames, (unsigned) registerErrors);
+    printf("conversions:      %u\n", (unsigned) n);
+    printf("CRC errors:       %u\n", (unsigned) crcErrors);
+    printf("timestamp errors: %u\n", (unsigned) timestampErrors);
+    printf("mismatches:       %u\n", (unsigned) mismatches);
+    printf("scaling errors:   %u\n", (unsigned) scaleErrors);
+    printf("ring high water:  %u, overflows %u\n", (unsigned) stats.highWater, (unsigned) stats.overflows);
+
+    // Every skipped sequence number must be accounted for by a loss counter
+    stream_loss_stats loss;
+    char lossReport[STREAM_LOSS_REPORT_BYTES];
+    streamGetLossStats(&loss);
+    streamFormatLossReport(&loss, lossReport, sizeof(lossReport));
+    if ((skippedSequences > streamLossTotal(&loss)) ||
+        ((streamGetDecimation() == 1) && (skippedSequences != streamLossTotal(&loss))))
+    {
+        fprintf(stderr, "%u sequence numbers skipped between packets, %u lost\n",
+                (unsigned) skippedSequences, (unsigned) streamLossTotal(&loss));
+        packetErrors++;
+    }
+    printf("%s, %u skipped between packets\n", lossReport, (unsigned) skippedSequences);
+    printf("packets:          %u (%llu bytes), channel mask 0x%02X, packet errors %u\n", (unsigned) packets,
+           (unsigned long long) bytes, (unsigned) getChannelEnableMask(), (unsigned) packetErrors);
+    printf("encoding:         %s, %llu bytes raw (ratio %.2f)\n",
+           (streamGetEncoding() == STREAM_ENCODING_RICE) ? "rice" : "raw", (unsigned long long) rawPacketBytes,
+           bytes ? (double) rawPacketBytes / (double) bytes : 0.0);
+    printf("data rate:        %.1f Hz simulated, %u Hz at CLKIN_FREQUENCY_HZ (OSR %u, batch %u records)\n",
+           modelGetDataRate(), (unsigned) timing.dataRate_Hz, (unsigned) timing.osr, (unsigned) streamGetBatchRecords());
+    printf("link mode:        %u, decimation %u\n", (unsigned) streamGetMode(), (unsigned) streamGetDecimation());
+    printf("throughput:       %.0f conversions/s (%.1fx real time)\n",
+           (double) n / elapsed, ((double) n / elapsed) / modelGetDataRate());
+
+    return ((registerErrors == 0) && (crcErrors == 0) && (mismatches == 0) && (scaleErrors == 0) &&
+            (timestampErrors == 0) && (packetErrors == 0)) ? 0 : 1;
+}
@@ -0,0 +1,826 @@
+/**
+ * \brief Software model of the ADS131M04 SPI interface (see ads131m04_model.h).
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "ads131m04_model.h"
+
+
+
+//****************************************************************************
+//
+// Internal constants
+//
+//****************************************************************************
+
+/* Longest frame: response word, every register (multiple RREG) and the CRC */
+#define MODEL_MAX_FRAME_WORDS       (2 + NUM_REGISTERS)
+#define MODEL_MAX_FRAME_BYTES       (MODEL_MAX_FRAME_WORDS * 4)
+
+/* Per-channel register block: CFG, OCAL_MSB, OCAL_LSB, GCAL_MSB, GCAL_LSB */
+#define CHANNEL_REGISTER_BLOCK      (5)
+#define LAST_CHANNEL_ADDRESS        (CH0_CFG_ADDRESS + (CHANNEL_COUNT * CHANNEL_REGISTER_BLOCK) - 1)
+
+/* Opcode field masks */
+#define OPCODE_COMMAND_MASK         ((uint16_t) 0xE000)
+#define OPCODE_ADDRESS(op)          ((uint8_t) (((op) >> 7) & 0x3F))
+#define OPCODE_COUNT(op)            ((uint8_t) ((op) & 0x7F))
+
+/* Acknowledge words */
+#define RESPONSE_RESET              ((uint16_t) (0xFF20 | CHANNEL_COUNT))
+#define RESPONSE_RREG_MULTIPLE      ((uint16_t) 0xE000)
+#define RESPONSE_WREG               ((uint16_t) 0x4000)
+
+#define TWO_PI                      (6.283185307179586)
+
+#define CODE_MAX                    ((int32_t) 0x7FFFFF)
+#define CODE_MIN                    ((int32_t) -0x800000)
+
+
+
+//****************************************************************************
+//
+// Internal variables
+//
+//****************************************************************************
+
+// Device state
+static uint16_t         registers[NUM_REGISTERS];
+static bool             locked;
+static bool             standby;
+static bool             crcError;
+static bool             regmapChanged;
+static uint8_t          drdyFlags;
+
+// Conversions
+static uint32_t         clkinFrequency = MODEL_DEFAULT_CLKIN_HZ;
+static model_generator  generators[CHANNEL_COUNT];
+static uint32_t         conversionCount;
+static int32_t          codes[CHANNEL_COUNT];
+static uint32_t         noiseState = 0x12345678;
+
+// SPI frame state
+static bool             csLow;
+static uint8_t          txFrame[MODEL_MAX_FRAME_BYTES];
+static uint8_t          rxFrame[MODEL_MAX_FRAME_BYTES];
+static uint16_t         framePosition;
+static uint16_t         frameLength;
+static uint8_t          frameWordBytes;
+static bool             frameHasData;
+
+// Response to the last command, sent at the start of the next frame
+static uint16_t         response;
+static bool             responseIsStatus;
+static uint8_t          rregAddress;
+static uint8_t          rregCount;
+
+
+
+//****************************************************************************
+//
+// Internal function prototypes
+//
+//****************************************************************************
+
+static uint8_t  wordBytes(void);
+static uint16_t crc16(const uint8_t data[], uint16_t length);
+static uint16_t statusValue(void);
+static uint16_t readRegister(uint8_t address);
+static void     writeRegister(uint8_t address, uint16_t value);
+static void     updateRegmapCRC(void);
+static uint8_t *putWord(uint8_t *dst, uint16_t value);
+static uint8_t *putDataWord(uint8_t *dst, int32_t code);
+static uint16_t getWord(const uint8_t *src);
+static void     processFrame(void);
+static double   generate(const model_generator *generator, double t);
+static double   noise(void);
+static uint8_t  channelGain(uint8_t channel);
+static bool     channelEnabled(uint8_t channel);
+
+
+
+//*****************************************************************************
+//
+//! Resets the device, as after power-up or an nRESET pulse.
+//!
+//! \fn void modelReset(void)
+//!
+//! \return None.
+//
+//*****************************************************************************
+void modelReset(void)
+{
+    memset(registers, 0, sizeof(registers));
+
+    registers[ID_ADDRESS]           = ID_DEFAULT;
+    registers[MODE_ADDRESS]         = MODE_DEFAULT;
+    registers[CLOCK_ADDRESS]        = CLOCK_DEFAULT;
+    registers[GAIN1_ADDRESS]        = GAIN1_DEFAULT;
+    registers[GAIN2_ADDRESS]        = GAIN2_DEFAULT;
+    registers[CFG_ADDRESS]          = CFG_DEFAULT;
+    registers[THRSHLD_MSB_ADDRESS]  = THRSHLD_MSB_DEFAULT;
+    registers[THRSHLD_LSB_ADDRESS]  = THRSHLD_LSB_DEFAULT;
+
+    // Every channel block has the same defaults as channel 0
+    uint8_t channel;
+    for (channel = 0; channel < CHANNEL_COUNT; channel++)
+    {
+        uint8_t base = CH0_CFG_ADDRESS + (channel * CHANNEL_REGISTER_BLOCK);
+        registers[base + 0] = CH0_CFG_DEFAULT;
+        registers[base + 1] = CH0_OCAL_MSB_DEFAULT;
+        registers[base + 2] = CH0_OCAL_LSB_DEFAULT;
+        registers[base + 3] = CH0_GCAL_MSB_DEFAULT;
+        registers[base + 4] = CH0_GCAL_LSB_DEFAULT;
+    }
+
+    locked          = false;
+    standby         = false;
+    crcError        = false;
+    regmapChanged   = false;
+    drdyFlags       = 0;
+    conversionCount = 0;
+    memset(codes, 0, sizeof(codes));
+
+    csLow           = false;
+    framePosition   = 0;
+    frameLength     = 0;
+
+    response            = RESPONSE_RESET;
+    responseIsStatus    = false;
+    rregCount           = 0;
+
+    updateRegmapCRC();
+    regmapChanged = false;
+}
+
+
+
+//*****************************************************************************
+//
+//! Sets the CLKIN frequency, which determines the data rate.
+//!
+//! \fn void modelSetClockFrequency(uint32_t clkin_Hz)
+//!
+//! \param clkin_Hz CLKIN frequency in Hz.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void modelSetClockFrequency(uint32_t clkin_Hz)
+{
+    clkinFrequency = clkin_Hz;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the output data rate for the current CLKIN and OSR setting.
+//!
+//! \fn double modelGetDataRate(void)
+//!
+//! \return Data rate in Hz (fCLKIN / 2 / OSR).
+//
+//*****************************************************************************
+double modelGetDataRate(void)
+{
+    uint8_t osrIndex = (uint8_t) ((registers[CLOCK_ADDRESS] & CLOCK_OSR_MASK) >> 2);
+    // The last OSR code selects 16256, not 128 << 7
+    uint32_t osr = (osrIndex == 7) ? 16256 : ((uint32_t) 128) << osrIndex;
+
+    return ((double) clkinFrequency / 2.0) / (double) osr;
+}
+
+
+
+//*****************************************************************************
+//
+//! Configures the signal applied to one channel input.
+//!
+//! \fn void modelSetGenerator(uint8_t channel, const model_generator *generator)
+//!
+//! \param channel channel index.
+//! \param generator signal description; DC uses only offset_V and noise_V.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void modelSetGenerator(uint8_t channel, const model_generator *generator)
+{
+    if (channel < CHANNEL_COUNT)
+    {
+        generators[channel] = *generator;
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Drives the /CS pin. A falling edge starts a frame, a rising edge ends it
+//! and executes the command received in it.
+//!
+//! \fn void modelSetCS(bool state)
+//!
+//! \param state pin level (true = high).
+//!
+//! \return None.
+//
+//*****************************************************************************
+void modelSetCS(bool state)
+{
+    if (!state && !csLow)
+    {
+        uint8_t *dst = txFrame;
+
+        csLow           = true;
+        framePosition   = 0;
+        frameWordBytes  = wordBytes();
+        memset(txFrame, 0, sizeof(txFrame));
+        memset(rxFrame, 0, sizeof(rxFrame));
+
+        if (responseIsStatus) { response = statusValue(); }
+        dst = putWord(dst, response);
+
+        if (rregCount > 0)
+        {
+            // Multiple register read: register words replace the channel data
+            uint8_t i;
+            for (i = 0; i < rregCount; i++)
+            {
+                dst = putWord(dst, readRegister((uint8_t) (rregAddress + i)));
+            }
+            rregCount       = 0;
+            frameHasData    = false;
+        }
+        else
+        {
+            uint8_t channel;
+            for (channel = 0; channel < CHANNEL_COUNT; channel++)
+            {
+                dst = putDataWord(dst, channelEnabled(channel) ? codes[channel] : 0);
+            }
+            frameHasData = true;
+        }
+
+        dst = putWord(dst, crc16(txFrame, (uint16_t) (dst - txFrame)));
+        frameLength = (uint16_t) (dst - txFrame);
+
+        // Until a command says otherwise, the next response is STATUS
+        responseIsStatus = true;
+    }
+    else if (state && csLow)
+    {
+        csLow = false;
+        processFrame();
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Clocks one byte through the SPI while /CS is low.
+//!
+//! \fn uint8_t modelTransferByte(uint8_t dataIn)
+//!
+//! \param dataIn byte on DIN.
+//!
+//! \return byte on DOUT (zero past the end of the frame or with /CS high).
+//
+//*****************************************************************************
+uint8_t modelTransferByte(uint8_t dataIn)
+{
+    if (!csLow) { return 0; }
+
+    uint8_t dataOut = (framePosition < frameLength) ? txFrame[framePosition] : 0;
+
+    if (framePosition < MODEL_MAX_FRAME_BYTES)
+    {
+        rxFrame[framePosition] = dataIn;
+    }
+    framePosition++;
+
+    return dataOut;
+}
+
+
+
+//*****************************************************************************
+//
+//! Produces the next conversion on every channel and sets the DRDY flags.
+//!
+//! \fn bool modelConvert(void)
+//!
+//! \return false if the device is in standby and no conversion was made.
+//
+//*****************************************************************************
+bool modelConvert(void)
+{
+    if (standby) { return false; }
+
+    double t = (double) conversionCount / modelGetDataRate();
+    uint8_t channel;
+
+    for (channel = 0; channel < CHANNEL_COUNT; channel++)
+    {
+        uint8_t base = CH0_CFG_ADDRESS + (channel * CHANNEL_REGISTER_BLOCK);
+        double volts = generate(&generators[channel], t);
+        double scaled = volts * (double) channelGain(channel) * 8388608.0 / MODEL_VREF;
+
+        int64_t code;
+        if (scaled >= (double) CODE_MAX)        { code = CODE_MAX; }
+        else if (scaled <= (double) CODE_MIN)   { code = CODE_MIN; }
+        else                                    { code = (int64_t) lround(scaled); }
+
+        // Offset calibration is subtracted, gain calibration is GCAL / 2^23
+        int32_t ocal = (int32_t) (((uint32_t) registers[base + 1] << 16) | ((uint32_t) registers[base + 2] << 8)) >> 8;
+        int64_t gcal = (int64_t) (((uint32_t) registers[base + 3] << 8) | (registers[base + 4] >> 8));
+
+        code = ((code - ocal) * gcal) >> 23;
+        if (code > CODE_MAX) { code = CODE_MAX; }
+        if (code < CODE_MIN) { code = CODE_MIN; }
+
+        codes[channel] = (int32_t) code;
+    }
+
+    drdyFlags = (uint8_t) ((1u << CHANNEL_COUNT) - 1);
+    conversionCount++;
+
+    return true;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the number of conversions since reset.
+//!
+//! \fn uint32_t modelGetConversionCount(void)
+//!
+//! \return Conversion count.
+//
+//*****************************************************************************
+uint32_t modelGetConversionCount(void)
+{
+    return conversionCount;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the 24-bit code of the last conversion.
+//!
+//! \fn int32_t modelGetCode(uint8_t channel)
+//!
+//! \param channel channel index.
+//!
+//! \return Sign-extended 24-bit code.
+//
+//*****************************************************************************
+int32_t modelGetCode(uint8_t channel)
+{
+    return (channel < CHANNEL_COUNT) ? codes[channel] : 0;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the value a correct driver decodes for the last conversion with the
+//! current word length: the top 16 bits in 16-bit mode, the full 24-bit code
+//! otherwise, and zero for disabled channels.
+//!
+//! \fn int32_t modelGetExpectedCode(uint8_t channel)
+//!
+//! \param channel channel index.
+//!
+//! \return Sign-extended code.
+//
+//*****************************************************************************
+int32_t modelGetExpectedCode(uint8_t channel)
+{
+    if ((channel >= CHANNEL_COUNT) || !channelEnabled(channel)) { return 0; }
+
+    if ((registers[MODE_ADDRESS] & MODE_WLENGTH_MASK) == MODE_WLENGTH_16BIT)
+    {
+        return codes[channel] >> 8;
+    }
+    return codes[channel];
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns a register value without going through the SPI.
+//!
+//! \fn uint16_t modelGetRegister(uint8_t address)
+//!
+//! \param address register address.
+//!
+//! \return Register value (STATUS is computed, but not cleared by this read).
+//
+//*****************************************************************************
+uint16_t modelGetRegister(uint8_t address)
+{
+    if (address == STATUS_ADDRESS) { return statusValue(); }
+    return (address < NUM_REGISTERS) ? registers[address] : 0;
+}
+
+
+
+//****************************************************************************
+//
+// Internal functions
+//
+//****************************************************************************
+
+
+//*****************************************************************************
+//
+//! Returns the number of bytes per word for the current WLENGTH setting.
+//
+//*****************************************************************************
+static uint8_t wordBytes(void)
+{
+    static const uint8_t bytes[] = { 2, 3, 4, 4 };
+    return bytes[(registers[MODE_ADDRESS] & MODE_WLENGTH_MASK) >> 8];
+}
+
+
+
+//*****************************************************************************
+//
+//! Bitwise CRC with the polynomial selected by MODE[CRC_TYPE], seed 0xFFFF.
+//! Deliberately independent of the table-driven CRC in ads131m0x.c.
+//
+//*****************************************************************************
+static uint16_t crc16(const uint8_t data[], uint16_t length)
+{
+    uint16_t polynomial = (registers[MODE_ADDRESS] & MODE_CRC_TYPE_MASK) ? 0x8005 : 0x1021;
+    uint16_t crc = 0xFFFF;
+    uint16_t i;
+
+    for (i = 0; i < length; i++)
+    {
+        uint8_t bit;
+        crc ^= (uint16_t) data[i] << 8;
+        for (bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? (uint16_t) ((crc << 1) ^ polynomial) : (uint16_t) (crc << 1);
+        }
+    }
+    return crc;
+}
+
+
+
+//*****************************************************************************
+//
+//! Builds the STATUS register from the device state.
+//
+//*****************************************************************************
+static uint16_t statusValue(void)
+{
+    uint16_t mode = registers[MODE_ADDRESS];
+
+    return (uint16_t) ((locked ? STATUS_LOCK_LOCKED : 0)
+                     | (regmapChanged ? STATUS_REG_MAP_CHANGED_CRC : 0)
+                     | (crcError ? STATUS_CRC_ERR_INPUT_CRC_ERROR : 0)
+                     | (mode & (MODE_CRC_TYPE_MASK | MODE_RESET_MASK | MODE_WLENGTH_MASK))
+                     | drdyFlags);
+}
+
+
+
+//*****************************************************************************
+//
+//! Reads a register as the device returns it. Reading STATUS clears the
+//! CRC_ERR and REG_MAP flags.
+//
+//*****************************************************************************
+static uint16_t readRegister(uint8_t address)
+{
+    if (address >= NUM_REGISTERS) { return 0; }
+
+    if (address == STATUS_ADDRESS)
+    {
+        uint16_t status = statusValue();
+        crcError        = false;
+        regmapChanged   = false;
+        return status;
+    }
+    return registers[address];
+}
+
+
+
+//*****************************************************************************
+//
+//! Writes a register; read-only and unimplemented addresses are ignored.
+//
+//*****************************************************************************
+static void writeRegister(uint8_t address, uint16_t value)
+{
+    bool writable = ((address >= MODE_ADDRESS) && (address <= LAST_CHANNEL_ADDRESS));
+    if (!writable) { return; }
+
+    if (address == MODE_ADDRESS)
+    {
+        value &= (uint16_t) ~(MODE_RESERVED0_MASK | MODE_RESERVED1_MASK);
+    }
+
+    registers[address] = value;
+    updateRegmapCRC();
+}
+
+
+
+//*****************************************************************************
+//
+//! Recalculates REGMAP_CRC over the MODE through last channel registers and
+//! flags a change in STATUS when the register map CRC is enabled.
+//
+//*****************************************************************************
+static void updateRegmapCRC(void)
+{
+    uint8_t bytes[2 * NUM_REGISTERS];
+    uint8_t *dst = bytes;
+    uint8_t address;
+
+    for (address = MODE_ADDRESS; address <= LAST_CHANNEL_ADDRESS; address++)
+    {
+        *dst++ = (uint8_t) (registers[address] >> 8);
+        *dst++ = (uint8_t) (registers[address] >> 0);
+    }
+
+    uint16_t crc = crc16(bytes, (uint16_t) (dst - bytes));
+    if ((crc != registers[REGMAP_CRC_ADDRESS]) && (registers[MODE_ADDRESS] & MODE_REG_CRC_EN_ENABLED))
+    {
+        regmapChanged = true;
+    }
+    registers[REGMAP_CRC_ADDRESS] = crc;
+}
+
+
+
+//*****************************************************************************
+//
+//! Writes a 16-bit value as one MSB-aligned word of the current frame.
+//
+//*****************************************************************************
+static uint8_t *putWord(uint8_t *dst, uint16_t value)
+{
+    dst[0] = (uint8_t) (value >> 8);
+    dst[1] = (uint8_t) (value >> 0);
+    return dst + frameWordBytes;
+}
+
+
+
+//*****************************************************************************
+//
+//! Writes a 24-bit conversion code in the current word format.
+//
+//*****************************************************************************
+static uint8_t *putDataWord(uint8_t *dst, int32_t code)
+{
+    switch ((registers[MODE_ADDRESS] & MODE_WLENGTH_MASK))
+    {
+        case MODE_WLENGTH_16BIT:
+            dst[0] = (uint8_t) (code >> 16);
+            dst[1] = (uint8_t) (code >> 8);
+            return dst + 2;
+
+        case MODE_WLENGTH_24BIT:
+            dst[0] = (uint8_t) (code >> 16);
+            dst[1] = (uint8_t) (code >> 8);
+            dst[2] = (uint8_t) (code >> 0);
+            return dst + 3;
+
+        case MODE_WLENGTH_32BIT_LSB_ZEROES:
+            dst[0] = (uint8_t) (code >> 16);
+            dst[1] = (uint8_t) (code >> 8);
+            dst[2] = (uint8_t) (code >> 0);
+            dst[3] = 0;
+            return dst + 4;
+
+        default:
+            dst[0] = (uint8_t) ((code < 0) ? 0xFF : 0x00);
+            dst[1] = (uint8_t) (code >> 16);
+            dst[2] = (uint8_t) (code >> 8);
+            dst[3] = (uint8_t) (code >> 0);
+            return dst + 4;
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Reads the 16 most-significant bits of a word.
+//
+//*****************************************************************************
+static uint16_t getWord(const uint8_t *src)
+{
+    return (uint16_t) (((uint16_t) src[0] << 8) | src[1]);
+}
+
+
+
+//*****************************************************************************
+//
+//! Executes the command received in the frame that just ended.
+//
+//*****************************************************************************
+static void processFrame(void)
+{
+    uint8_t  wb         = frameWordBytes;
+    uint16_t received   = (framePosition < MODEL_MAX_FRAME_BYTES) ? framePosition : MODEL_MAX_FRAME_BYTES;
+    uint16_t words      = received / wb;
+
+    // Data is consumed once all channel words have been clocked out
+    if (frameHasData && (framePosition >= (uint16_t) ((1 + CHANNEL_COUNT) * wb)))
+    {
+        drdyFlags = 0;
+    }
+
+    if (words < 1) { return; }
+
+    uint16_t opcode = getWord(&rxFrame[0]);
+    uint16_t commandWords = 1;
+
+    if ((opcode & OPCODE_COMMAND_MASK) == OPCODE_WREG)
+    {
+        commandWords = (uint16_t) (2 + OPCODE_COUNT(opcode));
+    }
+
+    // Input CRC covers the command words and follows them
+    if (registers[MODE_ADDRESS] & MODE_RX_CRC_EN_ENABLED)
+    {
+        if ((words < commandWords + 1) ||
+            (crc16(rxFrame, (uint16_t) (commandWords * wb)) != getWord(&rxFrame[commandWords * wb])))
+        {
+            crcError = true;
+            return;
+        }
+    }
+
+    // Locked registers only accept NULL, RREG and UNLOCK
+    if (locked && (opcode != OPCODE_NULL) && (opcode != OPCODE_UNLOCK) &&
+        ((opcode & OPCODE_COMMAND_MASK) != OPCODE_RREG))
+    {
+        return;
+    }
+
+    if ((opcode & OPCODE_COMMAND_MASK) == OPCODE_RREG)
+    {
+        uint8_t address = OPCODE_ADDRESS(opcode);
+        uint8_t count   = OPCODE_COUNT(opcode);
+
+        if (count == 0)
+        {
+            response = readRegister(address);
+        }
+        else
+        {
+            response    = (uint16_t) (RESPONSE_RREG_MULTIPLE | (opcode & 0x1FFF));
+            rregAddress = address;
+            rregCount   = (uint8_t) (((address + count + 1) > NUM_REGISTERS) ? (NUM_REGISTERS - address) : (count + 1));
+        }
+        responseIsStatus = false;
+    }
+    else if ((opcode & OPCODE_COMMAND_MASK) == OPCODE_WREG)
+    {
+        uint8_t  address    = OPCODE_ADDRESS(opcode);
+        uint16_t count      = (uint16_t) (OPCODE_COUNT(opcode) + 1);
+        uint16_t i;
+
+        // Only registers whose data word was completely clocked in are written
+        if (count > words - 1) { count = (uint16_t) (words - 1); }
+        if (count == 0) { return; }
+
+        for (i = 0; i < count; i++)
+        {
+            writeRegister((uint8_t) (address + i), getWord(&rxFrame[(1 + i) * wb]));
+        }
+
+        response            = (uint16_t) (RESPONSE_WREG | ((uint16_t) address << 7) | (count - 1));
+        responseIsStatus    = false;
+    }
+    else switch (opcode)
+    {
+        case OPCODE_RESET:
+            // RESET needs a full frame, otherwise it is only acknowledged
+            if (framePosition >= (uint16_t) ((CHANNEL_COUNT + 2) * wb))
+            {
+                modelReset();
+            }
+            else
+            {
+                response            = OPCODE_RESET;
+                responseIsStatus    = false;
+            }
+            break;
+
+        case OPCODE_STANDBY:
+        case OPCODE_WAKEUP:
+        case OPCODE_LOCK:
+        case OPCODE_UNLOCK:
+            standby             = (opcode == OPCODE_STANDBY) ? true : (opcode == OPCODE_WAKEUP) ? false : standby;
+            locked              = (opcode == OPCODE_LOCK) ? true : (opcode == OPCODE_UNLOCK) ? false : locked;
+            response            = opcode;
+            responseIsStatus    = false;
+            break;
+
+        default:
+            // NULL and unknown commands return STATUS in the next frame
+            break;
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Evaluates a signal generator at time t (seconds).
+//
+//*****************************************************************************
+static double generate(const model_generator *generator, double t)
+{
+    double phase = generator->frequency_Hz * t;
+    double value;
+
+    phase -= floor(phase);
+
+    switch (generator->waveform)
+    {
+        case MODEL_WAVE_SINE:       value = sin(TWO_PI * phase);                            break;
+        case MODEL_WAVE_SQUARE:     value = (phase < 0.5) ? 1.0 : -1.0;                     break;
+        case MODEL_WAVE_TRIANGLE:   value = (phase < 0.5) ? (4.0 * phase - 1.0) : (3.0 - 4.0 * phase); break;
+        case MODEL_WAVE_RAMP:       value = 2.0 * phase - 1.0;                              break;
+        default:                    value = 0.0;                                            break;
+    }
+
+    value = generator->offset_V + (generator->amplitude_V * value);
+
+    if (generator->noise_V > 0.0)
+    {
+        value += generator->noise_V * noise();
+    }
+    return value;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns approximately normal noise with unit variance (sum of 12 uniform
+//! values from a xorshift generator), reproducible from run to run.
+//
+//*****************************************************************************
+static double noise(void)
+{
+    double sum = 0.0;
+    int i;
+
+    for (i = 0; i < 12; i++)
+    {
+        noiseState ^= noiseState << 13;
+        noiseState ^= noiseState >> 17;
+        noiseState ^= noiseState << 5;
+        sum += (double) noiseState / 4294967296.0;
+    }
+    return sum - 6.0;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the PGA gain of a channel from GAIN1/GAIN2.
+//
+//*****************************************************************************
+static uint8_t channelGain(uint8_t channel)
+{
+    uint16_t gain = (channel < 4) ? registers[GAIN1_ADDRESS] : registers[GAIN2_ADDRESS];
+    uint8_t shift = (uint8_t) ((channel % 4) * 4);
+
+    return (uint8_t) (1u << ((gain >> shift) & 0x7));
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns true if a channel is enabled in the CLOCK register.
+//
+//*****************************************************************************
+static bool channelEnabled(uint8_t channel)
+{
+    return (registers[CLOCK_ADDRESS] & (CLOCK_CH0_EN_MASK << channel)) != 0;
+}
@@ -0,0 +1,97 @@
+/**
+ * \brief Software model of the ADS131M04 SPI interface, used by the host build.
+ *
+ * The model sits behind the simulated HAL (hal_sim.c) and behaves like the
+ * device as seen from the SPI bus:
+ *
+ *  - Register map with power-on defaults, read-only ID/STATUS and the MODE,
+ *    CLOCK, GAIN, CFG, threshold, channel and REGMAP_CRC registers.
+ *  - NULL, RESET, STANDBY, WAKEUP, LOCK, UNLOCK, RREG (single and multiple)
+ *    and WREG (single and multiple) commands. Responses appear in the next
+ *    frame, as on the device.
+ *  - 16-bit, 24-bit and both 32-bit word lengths, output CRC over every frame,
+ *    input CRC checking when RX_CRC_EN is set, CCITT and ANSI polynomials.
+ *  - One signal generator per channel. Codes are scaled by the PGA gain,
+ *    corrected by the OCAL/GCAL registers and clipped to 24 bits.
+ *
+ * Conversion timing is not simulated here: modelConvert() produces the next
+ * conversion whenever it is called. The data rate it reports follows CLKIN and
+ * the OSR setting, so callers can pace themselves if needed.
+ */
+
+#ifndef ADS131M04_MODEL_H_
+#define ADS131M04_MODEL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ads131m0x.h"
+
+
+//****************************************************************************
+//
+// Constants
+//
+//****************************************************************************
+
+/* CLKIN used when none is set, in Hz */
+#define MODEL_DEFAULT_CLKIN_HZ      ((uint32_t) 8192000)
+
+/* Reference voltage; full scale is +/- MODEL_VREF / gain */
+#define MODEL_VREF                  (1.2)
+
+
+
+//****************************************************************************
+//
+// Signal generator
+//
+//****************************************************************************
+
+typedef enum
+{
+    MODEL_WAVE_DC,
+    MODEL_WAVE_SINE,
+    MODEL_WAVE_SQUARE,
+    MODEL_WAVE_TRIANGLE,
+    MODEL_WAVE_RAMP
+} model_waveform;
+
+typedef struct
+{
+    model_waveform  waveform;
+    double          amplitude_V;    // Peak amplitude at the input pins
+    double          frequency_Hz;
+    double          offset_V;
+    double          noise_V;        // RMS of the added noise, 0 for none
+} model_generator;
+
+
+
+//****************************************************************************
+//
+// Function prototypes
+//
+//****************************************************************************
+
+// Device control
+void        modelReset(void);
+void        modelSetClockFrequency(uint32_t clkin_Hz);
+double      modelGetDataRate(void);
+void        modelSetGenerator(uint8_t channel, const model_generator *generator);
+
+// Pins
+void        modelSetCS(bool state);
+uint8_t     modelTransferByte(uint8_t dataIn);
+
+// Conversions
+bool        modelConvert(void);
+uint32_t    modelGetConversionCount(void);
+int32_t     modelGetCode(uint8_t channel);
+int32_t     modelGetExpectedCode(uint8_t channel);
+
+// Back door access for checks
+uint16_t    modelGetRegister(uint8_t address);
+
+
+#endif /* ADS131M04_MODEL_H_ */
@@ -0,0 +1,387 @@
+/**
+ * \brief Measures the compression of the stream (STREAM_ENCODING_RICE, see
+ * adc_stream.h) on recorded data.
+ *
+ * The recording is a file of packets back to back, as written by
+ * udp_receiver -o, raw or compressed. Without one, the simulated device is
+ * recorded with slowly varying, biosignal-like inputs and packed as the
+ * firmware does (see adc_sim.c); -w saves that recording.
+ *
+ * Every packet is brought to the raw layout, encoded with
+ * streamEncodePacket() and decoded with streamDecodePacket(), -r times, and
+ * must decode to the raw packet exactly. The run reports the compression
+ * ratio of the packets and of their records alone, and the time per sample
+ * (one code of one channel) to encode and to decode. Cycles per sample on the
+ * target are in the "encoder" stage of the benchmark report (benchmark.h).
+ *
+ * Usage: codec_bench [-i file] [-n conversions] [-o osr[,hr|lp|vlp]] [-m mask] [-w file] [-r repeats]
+ *   -i  recorded stream to read
+ *   -n  conversions to record from the simulated device (default 200000)
+ *   -o  oversampling ratio (and power mode) of the simulated recording
+ *   -m  channel enable mask of the simulated recording (default: all)
+ *   -w  file to save the simulated recording to
+ *   -r  times each packet is encoded and decoded (default 20)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ads131m0x.h"
+#include "adc_control.h"
+#include "adc_stream.h"
+#include "sample_ring.h"
+#include "hal_sim.h"
+#include "ads131m04_model.h"
+#include "stream_decoder.h"
+
+
+
+//****************************************************************************
+//
+// Internal macros
+//
+//****************************************************************************
+
+/* Largest recording kept in memory */
+#define MAX_RECORDING_BYTES     (64u * 1024u * 1024u)
+
+
+
+//****************************************************************************
+//
+// Internal data structures
+//
+//****************************************************************************
+
+typedef struct
+{
+    uint8_t    *data;               // Raw packets back to back
+    uint32_t    length;
+    uint32_t    packets;
+} recording;
+
+
+
+//****************************************************************************
+//
+// Internal variables
+//
+//****************************************************************************
+
+/* Inputs of the simulated recording (volts at the pins, PGA gain 8): a
+ * heartbeat-rate wave, alpha-band EEG, breathing and a drifting electrode
+ * offset, each with a few microvolts of noise */
+static const model_generator bioSignals[] = {
+    { MODEL_WAVE_SINE,      0.002,      1.2,    0.0,        0.000002    },
+    { MODEL_WAVE_SINE,      0.000050,   10.0,   0.0,        0.000001    },
+    { MODEL_WAVE_TRIANGLE,  0.001,      0.25,   0.0002,     0.000002    },
+    { MODEL_WAVE_RAMP,      0.0005,     0.05,   0.0005,     0.000001    },
+};
+
+
+
+//*****************************************************************************
+//
+//! Appends a raw packet to the recording.
+//
+//*****************************************************************************
+static void addPacket(recording *record, const uint8_t *packet, uint16_t length)
+{
+    if ((record->length + length) > MAX_RECORDING_BYTES) { return; }
+
+    memcpy(&record->data[record->length], packet, length);
+    record->length += length;
+    record->packets++;
+}
+
+
+
+//*****************************************************************************
+//
+//! Reads a recorded stream, bringing every packet to the raw layout.
+//!
+//! \return false if the file cannot be read or holds a malformed packet.
+//
+//*****************************************************************************
+static bool readRecording(recording *record, const char *path)
+{
+    static uint8_t packet[STREAM_MAX_PACKET_BYTES];
+    static uint8_t raw[STREAM_MAX_PACKET_BYTES];
+    FILE *file = fopen(path, "rb");
+
+    if (!file)
+    {
+        perror(path);
+        return false;
+    }
+
+    while (fread(packet, 1, STREAM_HEADER_BYTES, file) == STREAM_HEADER_BYTES)
+    {
+        uint16_t length = streamPacketBytes(packet);
+        uint16_t rawLength;
+
+        if ((length == 0) ||
+            (fread(&packet[STREAM_HEADER_BYTES], 1, length - STREAM_HEADER_BYTES, file) !=
+             (size_t) (length - STREAM_HEADER_BYTES)) ||
+            ((rawLength = streamDecodePacket(packet, length, raw)) == 0))
+        {
+            fprintf(stderr, "%s: malformed packet after %u\n", path, (unsigned) record->packets);
+            fclose(file);
+            return false;
+        }
+        addPacket(record, raw, rawLength);
+    }
+
+    fclose(file);
+    return true;
+}
+
+
+
+//*****************************************************************************
+//
+//! Moves the record formed by the decimator into the batch, as packRecord()
+//! in empty_min.c does, recording the batches sent.
+//
+//*****************************************************************************
+static void packRecord(recording *record, stream_decimator *decimator, stream_batch *batch, uint32_t now_ms)
+{
+    stream_record packed;
+
+    if (!streamDecimatorTake(decimator, &packed)) { return; }
+
+    if (!streamBatchAccepts(batch, &packed))
+    {
+        addPacket(record, batch->buffer, batch->length);
+        streamBatchReset(batch);
+    }
+    streamBatchAdd(batch, &packed, now_ms);
+
+    if (streamBatchFlushDue(batch, now_ms))
+    {
+        addPacket(record, batch->buffer, batch->length);
+        streamBatchReset(batch);
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Records the simulated device through the pipeline of adc_sim.
+//
+//*****************************************************************************
+static void recordSimulation(recording *record, uint32_t conversions, const char *rate, long channelMask)
+{
+    static stream_batch batch;
+    stream_decimator decimator;
+    sample_record sample;
+    uint8_t channel;
+    uint32_t n;
+
+    for (channel = 0; channel < CHANNEL_COUNT; channel++)
+    {
+        modelSetGenerator(channel, &bioSignals[channel % (sizeof(bioSignals) / sizeof(bioSignals[0]))]);
+    }
+
+    InitADC();
+    adcControlInit();
+    if (rate)
+    {
+        char *end;
+        uint16_t osr = (uint16_t) strtoul(rate, &end, 0);
+        uint16_t powerMode = !strcmp(end, ",lp")  ? CLOCK_PWR_LP  :
+                             !strcmp(end, ",vlp") ? CLOCK_PWR_VLP : CLOCK_PWR_HR;
+
+        adcControlRequestDataRate(osr, powerMode);
+        adcControlService();
+    }
+    if (channelMask >= 0)
+    {
+        adcControlRequestChannelMask((uint8_t) channelMask);
+        adcControlService();
+    }
+    sampleRingReset();
+
+    streamBatchReset(&batch);
+    streamDecimatorReset(&decimator);
+
+    uint64_t start_ns = halSimGetTime_ns();
+
+    for (n = 0; n < conversions; n++)
+    {
+        if (!waitForDRDYinterrupt(100)) { break; }
+
+        sample.timestamp = getDRDYtime(&sample.sequence);
+        streamTrackSequence(sample.sequence);
+        if (readData(&sample.data))
+        {
+            streamCountCrcError();
+            continue;
+        }
+        sampleRingPush(&sample);
+
+        uint32_t now_ms = (uint32_t) ((halSimGetTime_ns() - start_ns) / 1000000u);
+        while (sampleRingPop(&sample))
+        {
+            if (!streamDecimatorAccepts(&decimator, &sample))
+            {
+                packRecord(record, &decimator, &batch, now_ms);
+            }
+            streamDecimatorAdd(&decimator, &sample);
+            if (streamDecimatorComplete(&decimator))
+            {
+                packRecord(record, &decimator, &batch, now_ms);
+            }
+        }
+    }
+    packRecord(record, &decimator, &batch, 0);
+    if (batch.count > 0) { addPacket(record, batch.buffer, batch.length); }
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    const char *input = NULL;
+    const char *output = NULL;
+    uint32_t conversions = 200000;
+    const char *rate = NULL;
+    long channelMask = -1;
+    uint32_t repeats = 20;
+    int option;
+
+    while ((option = getopt(argc, argv, "i:n:o:m:w:r:")) != -1)
+    {
+        switch (option)
+        {
+            case 'i':   input = optarg;                                                     break;
+            case 'n':   conversions = (uint32_t) strtoul(optarg, NULL, 0);                 break;
+            case 'o':   rate = optarg;                                                      break;
+            case 'm':   channelMask = strtol(optarg, NULL, 0);                              break;
+            case 'w':   output = optarg;                                                    break;
+            case 'r':   repeats = (uint32_t) strtoul(optarg, NULL, 0);                     break;
+            default:
+                fprintf(stderr, "usage: %s [-i file] [-n conversions] [-o osr[,hr|lp|vlp]] [-m mask] [-w file]"
+                                " [-r repeats]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (repeats < 1) { repeats = 1; }
+
+    recording record;
+    memset(&record, 0, sizeof(record));
+    record.data = malloc(MAX_RECORDING_BYTES);
+    if (!record.data)
+    {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+
+    if (input)
+    {
+        if (!readRecording(&record, input)) { return 2; }
+    }
+    else
+    {
+        recordSimulation(&record, conversions, rate, channelMask);
+    }
+
+    if (output)
+    {
+        FILE *file = fopen(output, "wb");
+        if (!file || (fwrite(record.data, 1, record.length, file) != record.length))
+        {
+            perror(output);
+            return 2;
+        }
+        fclose(file);
+    }
+
+    static uint8_t encoded[STREAM_MAX_PACKET_BYTES];
+    static uint8_t decoded[STREAM_MAX_PACKET_BYTES];
+    uint64_t rawBytes = 0;
+    uint64_t encodedBytes = 0;
+    uint64_t samples = 0;
+    uint64_t encode_ns = 0;
+    uint64_t decode_ns = 0;
+    uint32_t leftRaw = 0;
+    uint32_t errors = 0;
+    uint32_t offset = 0;
+    uint32_t records = 0;
+    uint8_t masks = 0;
+
+    while (offset < record.length)
+    {
+        const uint8_t *packet = &record.data[offset];
+        uint16_t length = streamPacketBytes(packet);
+        uint16_t count = (uint16_t) (packet[2] | (packet[3] << 8));
+        uint16_t bytes = 0;
+        uint32_t channels = ((uint32_t) (length - STREAM_HEADER_BYTES) / count - 2u) / STREAM_CODE_BYTES;
+        uint32_t repeat;
+
+        uint64_t start_ns = halSimGetTime_ns();
+        for (repeat = 0; repeat < repeats; repeat++)
+        {
+            bytes = streamEncodePacket(packet, encoded);
+        }
+        encode_ns += halSimGetTime_ns() - start_ns;
+
+        if (bytes == 0)
+        {
+            // Sent raw
+            memcpy(encoded, packet, length);
+            bytes = length;
+            leftRaw++;
+        }
+
+        start_ns = halSimGetTime_ns();
+        for (repeat = 0; repeat < repeats; repeat++)
+        {
+            if (streamDecodePacket(encoded, bytes, decoded) != length) { break; }
+        }
+        decode_ns += halSimGetTime_ns() - start_ns;
+
+        if ((streamDecodePacket(encoded, bytes, decoded) != length) || memcmp(decoded, packet, length))
+        {
+            if (errors < 5)
+            {
+                fprintf(stderr, "packet at byte %u: %u-byte encoding does not decode to the raw packet\n",
+                        (unsigned) offset, (unsigned) bytes);
+            }
+            errors++;
+        }
+
+        rawBytes += length;
+        encodedBytes += bytes;
+        records += count;
+        samples += (uint64_t) count * channels;
+        masks |= packet[1];
+        offset += length;
+    }
+
+    uint64_t headers = (uint64_t) record.packets * STREAM_HEADER_BYTES;
+    uint64_t timed = samples * repeats;
+
+    printf("recording:        %s, %u packets, %u records, %llu samples, channels 0x%02X\n",
+           input ? input : "simulated", (unsigned) record.packets, (unsigned) records, (unsigned long long) samples,
+           (unsigned) masks);
+    printf("raw:              %llu bytes, %.2f bits per sample in the records\n", (unsigned long long) rawBytes,
+           samples ? (double) ((rawBytes - headers) * 8u) / (double) samples : 0.0);
+    printf("rice:             %llu bytes, %.2f bits per sample in the records, %u packets left raw\n",
+           (unsigned long long) encodedBytes,
+           samples ? (double) ((encodedBytes - headers) * 8u) / (double) samples : 0.0, (unsigned) leftRaw);
+    printf("ratio:            %.2f for the packets, %.2f for the records\n",
+           encodedBytes ? (double) rawBytes / (double) encodedBytes : 0.0,
+           (encodedBytes > headers) ? (double) (rawBytes - headers) / (double) (encodedBytes - headers) : 0.0);
+    printf("time:             encode %.1f ns/sample, decode %.1f ns/sample, %u repeats, %u errors\n",
+           timed ? (double) encode_ns / (double) timed : 0.0, timed ? (double) decode_ns / (double) timed : 0.0,
+           (unsigned) repeats, (unsigned) errors);
+
+    free(record.data);
+    return (errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,210 @@
+/**
+ * \brief Checks the table-driven calculateCRC() of ads131m0x.c against a
+ * bitwise reference, and compares their speed.
+ *
+ * The polynomial is the one ads131m0x.c was built with: the Makefile builds
+ * this test twice, as build/crc_test_ccitt and, with CRC_ANSI defined,
+ * build/crc_test_ansi. Each case draws a random length (0 to 255 bytes, the
+ * range of calculateCRC()'s byte count), random data and a random seed, and
+ * also continues a CRC across two calls, as readData() does with its frames.
+ * The run ends with a non-zero exit status on any mismatch.
+ *
+ * The benchmark then times both routines on the bytes of a data frame that
+ * readData() checks (five 24-bit words and the CRC) and on the longest
+ * buffer, and reports nanoseconds per byte.
+ *
+ * Usage: crc_test [-n cases] [-s seed] [-r repeats]
+ *   -n  random cases to check (default 100000)
+ *   -s  seed of the random cases (default 1)
+ *   -r  times each buffer is run through the benchmark (default 200000)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ads131m0x.h"
+
+
+
+//****************************************************************************
+//
+// Internal macros
+//
+//****************************************************************************
+
+#if defined CRC_ANSI
+#define CRC_NAME                "ANSI"
+#define CRC_POLYNOMIAL          ((uint16_t) 0x8005)     // x^16 + x^15 + x^2 + 1
+#else
+#define CRC_NAME                "CCITT"
+#define CRC_POLYNOMIAL          ((uint16_t) 0x1021)     // x^16 + x^12 + x^5 + 1
+#endif
+
+/* Bytes of an ADS131M04 data frame checked by readData() at the default word length */
+#define FRAME_CRC_BYTES         (5u * 3u + 2u)
+
+#define MAX_BYTES               (255u)
+
+
+
+//****************************************************************************
+//
+// Internal variables
+//
+//****************************************************************************
+
+// Keeps the benchmark loops from being optimized away
+static volatile uint16_t    sink;
+
+
+
+//*****************************************************************************
+//
+//! Bitwise CRC, one bit per step, as calculateCRC() was before it used a
+//! lookup table.
+//
+//*****************************************************************************
+static uint16_t bitwiseCRC(const uint8_t dataBytes[], uint8_t numberBytes, uint16_t initialValue)
+{
+    uint16_t crc = initialValue;
+    uint8_t byteIndex;
+
+    for (byteIndex = 0; byteIndex < numberBytes; byteIndex++)
+    {
+        uint8_t bitIndex;
+
+        for (bitIndex = 0x80u; bitIndex > 0; bitIndex >>= 1)
+        {
+            bool dataMSb = (dataBytes[byteIndex] & bitIndex) != 0;
+            bool crcMSb = (crc & 0x8000u) != 0;
+
+            crc = (uint16_t) (crc << 1);
+            if (dataMSb ^ crcMSb) { crc ^= CRC_POLYNOMIAL; }
+        }
+    }
+    return crc;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the monotonic clock in nanoseconds.
+//
+//*****************************************************************************
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the time per byte of a CRC routine on a buffer, in nanoseconds.
+//
+//*****************************************************************************
+static double timeCRC(uint16_t (*crc)(const uint8_t[], uint8_t, uint16_t), const uint8_t *data, uint8_t length,
+                      uint32_t repeats)
+{
+    uint64_t start_ns = nowNs();
+    uint16_t value = 0xFFFF;
+    uint32_t n;
+
+    for (n = 0; n < repeats; n++)
+    {
+        value = crc(data, length, value);
+    }
+    sink = value;
+
+    return (double) (nowNs() - start_ns) / ((double) repeats * length);
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    uint32_t cases = 100000;
+    unsigned int seed = 1;
+    uint32_t repeats = 200000;
+    int option;
+
+    while ((option = getopt(argc, argv, "n:s:r:")) != -1)
+    {
+        switch (option)
+        {
+            case 'n':   cases = (uint32_t) strtoul(optarg, NULL, 0);                       break;
+            case 's':   seed = (unsigned int) strtoul(optarg, NULL, 0);                    break;
+            case 'r':   repeats = (uint32_t) strtoul(optarg, NULL, 0);                     break;
+            default:
+                fprintf(stderr, "usage: %s [-n cases] [-s seed] [-r repeats]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (repeats < 1) { repeats = 1; }
+
+    static uint8_t data[MAX_BYTES];
+    uint32_t errors = 0;
+    uint32_t n;
+    uint16_t i;
+
+    // The check values of the two CRC-16 variants with seed 0xFFFF
+    const uint8_t check[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    const uint16_t checkValue = (CRC_POLYNOMIAL == 0x1021) ? 0x29B1 : 0xAEE7;
+    if ((bitwiseCRC(check, sizeof(check), 0xFFFF) != checkValue) ||
+        (calculateCRC(check, sizeof(check), 0xFFFF) != checkValue))
+    {
+        fprintf(stderr, "\"123456789\": bitwise 0x%04X, table 0x%04X, expected 0x%04X\n",
+                (unsigned) bitwiseCRC(check, sizeof(check), 0xFFFF),
+                (unsigned) calculateCRC(check, sizeof(check), 0xFFFF), (unsigned) checkValue);
+        errors++;
+    }
+
+    for (n = 0; n < cases; n++)
+    {
+        uint8_t length = (uint8_t) (rand_r(&seed) % (MAX_BYTES + 1));
+        uint8_t split = length ? (uint8_t) (rand_r(&seed) % (length + 1u)) : 0;
+        uint16_t initialValue = (n == 0) ? 0xFFFF : (uint16_t) rand_r(&seed);
+
+        for (i = 0; i < length; i++) { data[i] = (uint8_t) rand_r(&seed); }
+
+        uint16_t expected = bitwiseCRC(data, length, initialValue);
+        uint16_t table = calculateCRC(data, length, initialValue);
+        uint16_t chained = calculateCRC(&data[split], (uint8_t) (length - split),
+                                        calculateCRC(data, split, initialValue));
+
+        if ((table != expected) || (chained != expected))
+        {
+            if (errors < 5)
+            {
+                fprintf(stderr, "case %u: %u bytes, seed 0x%04X: table 0x%04X, split at %u 0x%04X, expected 0x%04X\n",
+                        (unsigned) n, (unsigned) length, (unsigned) initialValue, (unsigned) table,
+                        (unsigned) split, (unsigned) chained, (unsigned) expected);
+            }
+            errors++;
+        }
+    }
+
+    printf("CRC-16 %-6s       %u random cases, %u errors\n", CRC_NAME ":", (unsigned) cases, (unsigned) errors);
+
+    for (i = 0; i < MAX_BYTES; i++) { data[i] = (uint8_t) rand_r(&seed); }
+
+    const uint8_t lengths[] = { FRAME_CRC_BYTES, MAX_BYTES };
+    for (i = 0; i < sizeof(lengths); i++)
+    {
+        double bitwise_ns = timeCRC(bitwiseCRC, data, lengths[i], repeats);
+        double table_ns = timeCRC(calculateCRC, data, lengths[i], repeats);
+
+        printf("%3u bytes:        bitwise %.2f ns/byte, table %.2f ns/byte (%.1fx)\n", (unsigned) lengths[i],
+               bitwise_ns, table_ns, (table_ns > 0.0) ? bitwise_ns / table_ns : 0.0);
+    }
+
+    return (errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,351 @@
+/**
+ * \brief Simulated HAL for the host build (see hal_sim.h).
+ *
+ * SPI bytes and /CS go to the ADS131M04 model. A DRDY "interrupt" is a call to
+ * modelConvert(): by default conversions are produced as fast as the caller
+ * reads them; in real-time mode waitForDRDYinterrupt() sleeps until the
+ * conversion is due at the model's data rate (or the synthetic /DRDY rate),
+ * and a caller that falls behind loses the conversions it was too late for,
+ * as it would on the device. The cycle counter counts nanoseconds.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <time.h>
+
+#include "hal_sim.h"
+#include "ads131m04_model.h"
+
+
+
+//****************************************************************************
+//
+// Internal macros
+//
+//****************************************************************************
+
+/* Last part of a real-time wait that is spent polling the clock */
+#define SPIN_WAIT_NS        (200000u)
+
+
+
+//****************************************************************************
+//
+// Internal variables
+//
+//****************************************************************************
+
+static bool         csState = HIGH;
+static bool         syncResetState = LOW;
+static bool         flag_nDRDY_INTERRUPT = false;
+static uint32_t     drdyInterruptCount = 0;
+static uint32_t     drdyTimestamp = 0;
+static uint64_t     drdyTime = 0;
+static uint32_t     frameCount = 0;
+
+static bool         realTime = false;
+static uint64_t     startTime_ns = 0;
+static uint32_t     startConversion = 0;
+static uint32_t     syntheticRate_Hz = 0;
+
+
+
+//*****************************************************************************
+//
+//! Returns the monotonic clock in nanoseconds.
+//!
+//! \fn uint64_t halSimGetTime_ns(void)
+//!
+//! \return Time in nanoseconds.
+//
+//*****************************************************************************
+uint64_t halSimGetTime_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t) now.tv_sec * 1000000000u) + (uint64_t) now.tv_nsec;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the number of SPI frames (/CS low periods) so far.
+//!
+//! \fn uint32_t halSimGetFrameCount(void)
+//!
+//! \return Frame count.
+//
+//*****************************************************************************
+uint32_t halSimGetFrameCount(void)
+{
+    return frameCount;
+}
+
+
+
+//*****************************************************************************
+//
+//! Paces DRDY at the model's data rate instead of running flat out.
+//!
+//! \fn void halSimSetRealTime(bool enable)
+//!
+//! \param enable true to sleep until each conversion is due.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void halSimSetRealTime(bool enable)
+{
+    realTime        = enable;
+    startTime_ns    = halSimGetTime_ns();
+    startConversion = modelGetConversionCount();
+}
+
+
+
+//*****************************************************************************
+//
+//! Resets the model and runs the driver start-up sequence.
+//!
+//! \fn void InitADC(void)
+//!
+//! \return None.
+//
+//*****************************************************************************
+void InitADC(void)
+{
+    modelReset();
+    adcStartup();
+}
+
+
+
+//*****************************************************************************
+//
+//! Delays are not needed by the model; they return immediately.
+//
+//*****************************************************************************
+void delay_ms(const uint32_t delay_time_ms)
+{
+    (void) delay_time_ms;
+}
+
+void delay_us(const uint32_t delay_time_us)
+{
+    (void) delay_time_us;
+}
+
+
+
+//*****************************************************************************
+//
+//! GPIO functions, mapped to the model pins.
+//
+//*****************************************************************************
+bool getCS(void)
+{
+    return csState;
+}
+
+bool getSYNC_RESET(void)
+{
+    return syncResetState;
+}
+
+void setCS(const bool state)
+{
+    if (!state && csState) { frameCount++; }
+    csState = state;
+    modelSetCS(state);
+}
+
+void setSYNC_RESET(const bool state)
+{
+    syncResetState = state;
+}
+
+void toggleSYNC(void)
+{
+    // A short nSYNC pulse only realigns conversions, which the model does not time
+    setSYNC_RESET(LOW);
+    setSYNC_RESET(HIGH);
+}
+
+void toggleRESET(void)
+{
+    setSYNC_RESET(LOW);
+    modelReset();
+    setSYNC_RESET(HIGH);
+}
+
+
+
+//*****************************************************************************
+//
+//! Waits for the next conversion.
+//!
+//! \fn bool waitForDRDYinterrupt(const uint32_t timeout_ms)
+//!
+//! \param timeout_ms not used; the model never stalls unless in standby.
+//!
+//! \return true if a conversion is ready, false if the device is in standby.
+//
+//*****************************************************************************
+bool waitForDRDYinterrupt(const uint32_t timeout_ms)
+{
+    (void) timeout_ms;
+
+    if (flag_nDRDY_INTERRUPT)
+    {
+        flag_nDRDY_INTERRUPT = false;
+        return true;
+    }
+
+    uint64_t due = halSimGetTime_ns();
+
+    if (realTime)
+    {
+        double rate = syntheticRate_Hz ? (double) syntheticRate_Hz : modelGetDataRate();
+        uint32_t n = modelGetConversionCount() - startConversion;
+        uint64_t now = due;
+        due = startTime_ns + (uint64_t) ((double) n * 1e9 / rate);
+
+        if (due > now)
+        {
+            // Sleep most of the wait, then spin: nanosleep() overshoots by tens of microseconds
+            if ((due - now) > SPIN_WAIT_NS)
+            {
+                struct timespec delay;
+                delay.tv_sec = (time_t) ((due - now - SPIN_WAIT_NS) / 1000000000u);
+                delay.tv_nsec = (long) ((due - now - SPIN_WAIT_NS) % 1000000000u);
+                nanosleep(&delay, NULL);
+            }
+            while (halSimGetTime_ns() < due) { }
+        }
+        else
+        {
+            // Conversions that completed since were overwritten before anyone read them
+            uint32_t missed = (uint32_t) ((double) (now - due) * rate / 1e9);
+            while (missed--)
+            {
+                if (!modelConvert()) { return false; }
+                drdyInterruptCount++;
+            }
+            due = startTime_ns + (uint64_t) ((double) (modelGetConversionCount() - startConversion) * 1e9 / rate);
+        }
+    }
+
+    if (!modelConvert()) { return false; }
+
+    drdyTimestamp = (uint32_t) due;
+    drdyTime = due;
+    drdyInterruptCount++;
+    return true;
+}
+
+void set_flag_nDRDY_INTERRUPT(bool value)
+{
+    flag_nDRDY_INTERRUPT = value;
+}
+
+uint32_t getDRDYinterruptCount(void)
+{
+    return drdyInterruptCount;
+}
+
+uint32_t getDRDYtimestamp(void)
+{
+    return drdyTimestamp;
+}
+
+
+
+//*****************************************************************************
+//
+//! Paces DRDY at a fixed rate instead of the model's data rate.
+//!
+//! \fn bool setSyntheticDRDYrate(const uint32_t rate_Hz)
+//!
+//! \param rate_Hz conversions per second, or 0 for the model's data rate.
+//!
+//! A non-zero rate also turns on real-time mode (see halSimSetRealTime()).
+//!
+//! \return false; the simulation always has a timer.
+//
+//*****************************************************************************
+bool setSyntheticDRDYrate(const uint32_t rate_Hz)
+{
+    syntheticRate_Hz = rate_Hz;
+    halSimSetRealTime(realTime || (rate_Hz != 0));
+    return false;
+}
+
+
+
+//*****************************************************************************
+//
+//! Cycle counter, mapped to the monotonic clock.
+//
+//*****************************************************************************
+uint32_t getCycleCount(void)
+{
+    return (uint32_t) halSimGetTime_ns();
+}
+
+uint32_t getCycleFrequency(void)
+{
+    return 1000000000u;
+}
+
+
+
+//*****************************************************************************
+//
+//! Timestamp timer, mapped to the monotonic clock. In real-time mode, DRDY
+//! times are the scheduled conversion times, without wake-up jitter.
+//
+//*****************************************************************************
+uint64_t getDRDYtime(uint32_t *sequence)
+{
+    *sequence = drdyInterruptCount - 1;
+    return drdyTime;
+}
+
+uint64_t getTimestamp(void)
+{
+    return halSimGetTime_ns();
+}
+
+uint32_t getTimestampFrequency(void)
+{
+    return 1000000000u;
+}
+
+
+
+//*****************************************************************************
+//
+//! SPI functions, clocked through the model.
+//
+//*****************************************************************************
+void spiSendReceiveArrays(const uint8_t dataTx[], uint8_t dataRx[], const uint8_t byteLength)
+{
+    assert(dataTx && dataRx);
+
+    setCS(LOW);
+
+    int i;
+    for (i = 0; i < byteLength; i++)
+    {
+        dataRx[i] = spiSendReceiveByte(dataTx[i]);
+    }
+
+    setCS(HIGH);
+}
+
+uint8_t spiSendReceiveByte(const uint8_t dataTx)
+{
+    return modelTransferByte(dataTx);
+}
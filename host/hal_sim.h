@@ -0,0 +1,28 @@
+/**
+ * \brief Controls for the simulated HAL used by the host build.
+ *
+ * hal_sim.c implements every function declared in hal.h on top of the
+ * ADS131M04 model, so ads131m0x.c and the stream modules build unchanged.
+ */
+
+#ifndef HAL_SIM_H_
+#define HAL_SIM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal.h"
+
+
+//****************************************************************************
+//
+// Function prototypes
+//
+//****************************************************************************
+
+void        halSimSetRealTime(bool enable);
+uint64_t    halSimGetTime_ns(void);
+uint32_t    halSimGetFrameCount(void);
+
+
+#endif /* HAL_SIM_H_ */
@@ -0,0 +1,217 @@
+/**
+ * \brief Decoder of the compressed stream packets (see stream_decoder.h).
+ */
+
+#include <string.h>
+
+#include "stream_decoder.h"
+
+
+
+//****************************************************************************
+//
+// Internal data structures
+//
+//****************************************************************************
+
+typedef struct
+{
+    const uint8_t  *src;
+    const uint8_t  *end;
+    uint32_t        bits;           // Bits not read yet, in the low count bits
+    uint32_t        count;
+    bool            overrun;        // A read went past end
+} bit_reader;
+
+
+
+//****************************************************************************
+//
+// Internal function prototypes
+//
+//****************************************************************************
+
+static uint32_t getBits(bit_reader *reader, uint32_t count);
+static bool     decodeChannel(bit_reader *reader, uint8_t *codes, uint16_t count, uint16_t stride);
+static void     putCode(uint8_t *dst, int32_t code);
+
+
+
+//*****************************************************************************
+//
+//! Converts a packet of the stream to the raw layout.
+//!
+//! \fn uint16_t streamDecodePacket(const uint8_t *packet, uint16_t length, uint8_t *raw)
+//!
+//! \param packet packet as received.
+//! \param length number of bytes received.
+//! \param raw destination of the STREAM_ENCODING_RAW packet, header included;
+//! STREAM_MAX_PACKET_BYTES long.
+//!
+//! \return Size of the raw packet, or 0 if the packet is malformed.
+//
+//*****************************************************************************
+uint16_t streamDecodePacket(const uint8_t *packet, uint16_t length, uint8_t *raw)
+{
+    uint16_t count;
+    uint16_t recordBytes;
+    uint32_t rawBytes;
+    uint8_t channels = 0;
+    uint8_t channel;
+    uint16_t i;
+    bit_reader reader;
+
+    if ((length < STREAM_HEADER_BYTES) || (streamPacketBytes(packet) != length)) { return 0; }
+
+    if (packet[22] == STREAM_ENCODING_RAW)
+    {
+        memcpy(raw, packet, length);
+        return length;
+    }
+
+    count = (uint16_t) (packet[2] | (packet[3] << 8));
+    for (channel = 0; channel < 8; channel++)
+    {
+        if (packet[1] & (1u << channel)) { channels++; }
+    }
+    recordBytes = STREAM_RECORD_BYTES(channels);
+    rawBytes = STREAM_HEADER_BYTES + ((uint32_t) count * recordBytes);
+    if (rawBytes > STREAM_MAX_PACKET_BYTES) { return 0; }
+
+    reader.src = &packet[STREAM_HEADER_BYTES];
+    reader.end = &packet[length];
+    reader.bits = 0;
+    reader.count = 0;
+    reader.overrun = false;
+
+    // Status words: the first one, then a flag per record
+    uint16_t status = (uint16_t) getBits(&reader, 16);
+    for (i = 0; i < count; i++)
+    {
+        if ((i > 0) && getBits(&reader, 1))
+        {
+            status = (uint16_t) getBits(&reader, 16);
+        }
+        raw[STREAM_HEADER_BYTES + (i * recordBytes)] = (uint8_t) status;
+        raw[STREAM_HEADER_BYTES + (i * recordBytes) + 1] = (uint8_t) (status >> 8);
+    }
+
+    uint8_t *codes = &raw[STREAM_HEADER_BYTES + 2];
+    for (channel = 0; channel < 8; channel++)
+    {
+        if (!(packet[1] & (1u << channel))) { continue; }
+
+        if (!decodeChannel(&reader, codes, count, recordBytes)) { return 0; }
+        codes += STREAM_CODE_BYTES;
+    }
+    if (reader.overrun) { return 0; }
+
+    memcpy(raw, packet, STREAM_HEADER_BYTES);
+    raw[22] = STREAM_ENCODING_RAW;
+    raw[24] = (uint8_t) rawBytes;
+    raw[25] = (uint8_t) (rawBytes >> 8);
+    return (uint16_t) rawBytes;
+}
+
+
+
+//****************************************************************************
+//
+// Internal functions
+//
+//****************************************************************************
+
+
+//*****************************************************************************
+//
+//! Reads count bits, at most 24, from a bit stream; past its end, reads
+//! zeros and flags the overrun.
+//
+//*****************************************************************************
+static uint32_t getBits(bit_reader *reader, uint32_t count)
+{
+    while (reader->count < count)
+    {
+        uint8_t byte = 0;
+
+        if (reader->src < reader->end)  { byte = *reader->src++; }
+        else                            { reader->overrun = true; }
+
+        reader->bits = (reader->bits << 8) | byte;
+        reader->count += 8;
+    }
+
+    reader->count -= count;
+    return (reader->bits >> reader->count) & ((1u << count) - 1u);
+}
+
+
+
+//*****************************************************************************
+//
+//! Reads the codes of one channel, the reverse of encodeChannel() in
+//! adc_stream.c, into the records of a raw packet.
+//!
+//! \return false if the channel header is invalid.
+//
+//*****************************************************************************
+static bool decodeChannel(bit_reader *reader, uint8_t *codes, uint16_t count, uint16_t stride)
+{
+    uint32_t order = getBits(reader, 2);
+    uint32_t parameter = getBits(reader, 5);
+    int32_t x1 = 0;
+    int32_t x2 = 0;
+    int32_t x;
+    uint16_t i;
+
+    if ((order > STREAM_RICE_MAX_ORDER) || (parameter > STREAM_RICE_MAX_PARAMETER)) { return false; }
+
+    for (i = 0; (i < count) && !reader->overrun; i++)
+    {
+        if (i < order)
+        {
+            x = ((int32_t) (getBits(reader, 24) << 8)) >> 8;
+        }
+        else
+        {
+            uint32_t quotient = 0;
+            uint32_t folded;
+
+            while ((quotient < STREAM_RICE_ESCAPE_QUOTIENT) && getBits(reader, 1) && !reader->overrun)
+            {
+                quotient++;
+            }
+            if (quotient < STREAM_RICE_ESCAPE_QUOTIENT)
+            {
+                folded = (quotient << parameter) | getBits(reader, parameter);
+            }
+            else
+            {
+                folded = getBits(reader, STREAM_RICE_ESCAPE_BITS / 2) << (STREAM_RICE_ESCAPE_BITS / 2);
+                folded |= getBits(reader, STREAM_RICE_ESCAPE_BITS / 2);
+            }
+
+            int32_t residual = (int32_t) (folded >> 1) ^ -(int32_t) (folded & 1u);
+            x = residual + ((order == 0) ? 0 : ((order == 1) ? x1 : ((2 * x1) - x2)));
+        }
+
+        putCode(&codes[i * stride], x);
+        x2 = x1;
+        x1 = x;
+    }
+    return true;
+}
+
+
+
+//*****************************************************************************
+//
+//! Writes the low 24 bits of a code in little-endian order.
+//
+//*****************************************************************************
+static void putCode(uint8_t *dst, int32_t code)
+{
+    dst[0] = (uint8_t) code;
+    dst[1] = (uint8_t) (code >> 8);
+    dst[2] = (uint8_t) (code >> 16);
+}
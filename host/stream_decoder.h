@@ -0,0 +1,28 @@
+/**
+ * \brief Decoder of the compressed stream packets (STREAM_ENCODING_RICE, see
+ * adc_stream.h) for the host tools.
+ *
+ * streamDecodePacket() turns any packet of the stream back into the
+ * STREAM_ENCODING_RAW layout, so that the tools read records from one layout
+ * only. The firmware only encodes and does not build this file.
+ */
+
+#ifndef STREAM_DECODER_H_
+#define STREAM_DECODER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "adc_stream.h"
+
+
+//****************************************************************************
+//
+// Function prototypes
+//
+//****************************************************************************
+
+uint16_t    streamDecodePacket(const uint8_t *packet, uint16_t length, uint8_t *raw);
+
+
+#endif /* STREAM_DECODER_H_ */
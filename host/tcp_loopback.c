@@ -0,0 +1,519 @@
+/**
+ * \brief Checks the framing of the raw TCP stream (see tcp_stream.h) over a
+ * loopback connection on a workstation.
+ *
+ * The simulated device is read and its conversions packed as the firmware
+ * does (see adc_sim.c), and the packets are written to a TCP connection on
+ * 127.0.0.1 the way a client task does: copied back to back into a buffer of
+ * -w bytes, which is written when it is full, or at once with -N, or once it
+ * is TCP_STREAM_COALESCE_MS old. A second thread reads the connection in
+ * pieces of random size, splits the byte stream into packets with
+ * streamPacketBytes() and checks each header and the sequence numbers.
+ *
+ * The run exits with a non-zero status if the reader found a malformed
+ * header, a truncated packet or a sequence gap the loss counters do not
+ * account for, or did not get every byte written.
+ *
+ * With -c, the program only reads: it connects to a device (or anything else
+ * serving the stream) and checks what it receives until -n conversions or
+ * the end of the connection.
+ *
+ * Usage: tcp_loopback [-n conversions] [-d steps] [-w bytes] [-N] [-s sndbuf] [-r read_bytes]
+ *                     [-c address[:port]]
+ *   -n  number of conversions to stream (default 100000)
+ *   -d  link mode steps down before the run, as in adc_sim (default 0)
+ *   -w  bytes collected per write (default TCP_STREAM_DEFAULT_SEND_BYTES, 1460)
+ *   -N  write partial buffers at once and set TCP_NODELAY
+ *   -s  SO_SNDBUF of the sending socket (default: the system's)
+ *   -r  largest read() of the reader; reads are 1 to this many bytes (default 4096)
+ *   -c  read from a device instead (default port TCP_STREAM_PORT, 5001)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "ads131m0x.h"
+#include "adc_control.h"
+#include "adc_stream.h"
+#include "sample_ring.h"
+#include "hal_sim.h"
+
+
+
+//****************************************************************************
+//
+// Internal macros
+//
+//****************************************************************************
+
+/* Values of tcp_stream.h, which needs TI-RTOS */
+#define TCP_STREAM_PORT                 "5001"
+#define TCP_STREAM_DEFAULT_SEND_BYTES   (1460)
+#define TCP_STREAM_MAX_SEND_BYTES       (2048)
+#define TCP_STREAM_COALESCE_MS          (20)
+
+
+
+//****************************************************************************
+//
+// Internal data structures
+//
+//****************************************************************************
+
+typedef struct
+{
+    int         socket;
+    uint32_t    readBytes;          // Largest read()
+    uint32_t    conversions;        // Stop after this many conversions; 0 to read until the end
+
+    // Results
+    uint64_t    bytes;
+    uint32_t    packets;
+    uint32_t    records;
+    uint64_t    covered;            // Sequence numbers covered by the packets
+    uint32_t    skipped;            // Sequence numbers skipped between packets
+    uint32_t    framingErrors;
+    uint8_t     decimation;         // Of the last packet
+} stream_reader;
+
+typedef struct
+{
+    int         socket;
+    uint8_t     buffer[TCP_STREAM_MAX_SEND_BYTES];
+    uint16_t    length;
+    uint16_t    sendBytes;
+    bool        noDelay;
+    uint64_t    startTime_ns;       // When the first packet in buffer was copied
+    uint64_t    bytes;
+    uint32_t    packets;
+    uint32_t    writes;
+} stream_writer;
+
+
+
+//*****************************************************************************
+//
+//! Reads the stream from a connection and checks it, packet by packet.
+//
+//*****************************************************************************
+static void *readStream(void *argument)
+{
+    stream_reader *reader = (stream_reader *) argument;
+    static uint8_t buffer[2 * STREAM_MAX_PACKET_BYTES];
+    uint32_t buffered = 0;
+    uint32_t nextSequence = 0;
+    bool sequenceSeen = false;
+    bool lost = false;
+    unsigned int seed = 1;
+
+    while ((reader->conversions == 0) || (reader->covered < reader->conversions))
+    {
+        // Random read sizes split packets and headers at every possible offset
+        uint32_t size = 1 + ((uint32_t) rand_r(&seed) % reader->readBytes);
+        if (size > (sizeof(buffer) - buffered)) { size = sizeof(buffer) - buffered; }
+
+        ssize_t received = read(reader->socket, &buffer[buffered], size);
+        if (received <= 0) { break; }
+        buffered += (uint32_t) received;
+        reader->bytes += (uint64_t) received;
+
+        while (buffered >= STREAM_HEADER_BYTES)
+        {
+            uint16_t length = streamPacketBytes(buffer);
+            if (length == 0)
+            {
+                fprintf(stderr, "packet %u: bad header %02X %02X %02X %02X\n", (unsigned) reader->packets,
+                        buffer[0], buffer[1], buffer[2], buffer[3]);
+                reader->framingErrors++;
+                lost = true;
+            }
+            if (lost)
+            {
+                // Resynchronizing is a client's business; drain the rest so the writer can finish
+                buffered = 0;
+                break;
+            }
+            if (buffered < length) { break; }
+
+            uint16_t count = (uint16_t) (buffer[2] | (buffer[3] << 8));
+            uint32_t sequence = (uint32_t) buffer[4] | ((uint32_t) buffer[5] << 8) |
+                                ((uint32_t) buffer[6] << 16) | ((uint32_t) buffer[7] << 24);
+            uint8_t decimation = buffer[21];
+            uint32_t next = streamRecordSequence(sequence, count, decimation);
+
+            if (sequenceSeen) { reader->skipped += sequence - nextSequence; }
+            nextSequence = next;
+            sequenceSeen = true;
+
+            reader->packets++;
+            reader->records += count;
+            reader->covered += next - sequence;
+            reader->decimation = decimation;
+
+            buffered -= length;
+            memmove(buffer, &buffer[length], buffered);
+        }
+    }
+
+    if (buffered > 0)
+    {
+        fprintf(stderr, "%u bytes of a truncated packet at the end of the stream\n", (unsigned) buffered);
+        reader->framingErrors++;
+    }
+    return NULL;
+}
+
+
+
+//*****************************************************************************
+//
+//! Writes the buffer of the writer to its connection.
+//
+//*****************************************************************************
+static void writeBuffer(stream_writer *writer)
+{
+    uint16_t offset = 0;
+
+    while (offset < writer->length)
+    {
+        ssize_t sent = write(writer->socket, &writer->buffer[offset], writer->length - offset);
+        if (sent <= 0)
+        {
+            perror("write");
+            exit(1);
+        }
+        offset += (uint16_t) sent;
+    }
+
+    writer->bytes += writer->length;
+    writer->writes++;
+    writer->length = 0;
+}
+
+
+
+//*****************************************************************************
+//
+//! Copies a finished batch into the buffer of the writer, as a client task
+//! does for a TCP client, and empties the batch.
+//
+//*****************************************************************************
+static void sendBatch(stream_writer *writer, stream_batch *batch)
+{
+    if (batch->count == 0) { return; }
+
+    if ((writer->length + batch->length) > sizeof(writer->buffer))
+    {
+        writeBuffer(writer);
+    }
+    if (writer->length == 0) { writer->startTime_ns = halSimGetTime_ns(); }
+
+    memcpy(&writer->buffer[writer->length], batch->buffer, batch->length);
+    writer->length += batch->length;
+    writer->packets++;
+
+    if (writer->length >= writer->sendBytes)
+    {
+        writeBuffer(writer);
+    }
+    streamBatchReset(batch);
+}
+
+
+
+//*****************************************************************************
+//
+//! Moves the record formed by the decimator into the batch, as packRecord()
+//! in empty_min.c does.
+//
+//*****************************************************************************
+static void packRecord(stream_writer *writer, stream_decimator *decimator, stream_batch *batch, uint32_t now_ms)
+{
+    stream_record packed;
+
+    if (!streamDecimatorTake(decimator, &packed)) { return; }
+
+    if (!streamBatchAccepts(batch, &packed))
+    {
+        sendBatch(writer, batch);
+    }
+    streamBatchAdd(batch, &packed, now_ms);
+
+    if (streamBatchFlushDue(batch, now_ms))
+    {
+        sendBatch(writer, batch);
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Connects to a stream server.
+//!
+//! \return The socket, or -1.
+//
+//*****************************************************************************
+static int connectTo(const char *address)
+{
+    char host[256];
+    const char *port = TCP_STREAM_PORT;
+    struct addrinfo hints;
+    struct addrinfo *found;
+    int fd = -1;
+
+    snprintf(host, sizeof(host), "%s", address);
+    char *colon = strrchr(host, ':');
+    if (colon)
+    {
+        *colon = '\0';
+        port = colon + 1;
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &found) != 0)
+    {
+        fprintf(stderr, "%s: unknown address\n", address);
+        return -1;
+    }
+
+    fd = socket(found->ai_family, found->ai_socktype, found->ai_protocol);
+    if ((fd >= 0) && (connect(fd, found->ai_addr, found->ai_addrlen) < 0))
+    {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(found);
+
+    if (fd < 0) { perror(address); }
+    return fd;
+}
+
+
+
+//*****************************************************************************
+//
+//! Opens a loopback connection.
+//!
+//! \return true with the two ends in sender and receiver.
+//
+//*****************************************************************************
+static bool openLoopback(int *sender, int *receiver)
+{
+    struct sockaddr_in address;
+    socklen_t length = sizeof(address);
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+
+    if ((server < 0) || (bind(server, (struct sockaddr *) &address, sizeof(address)) < 0) ||
+        (listen(server, 1) < 0) || (getsockname(server, (struct sockaddr *) &address, &length) < 0))
+    {
+        perror("loopback server");
+        return false;
+    }
+
+    *receiver = socket(AF_INET, SOCK_STREAM, 0);
+    if ((*receiver < 0) || (connect(*receiver, (struct sockaddr *) &address, sizeof(address)) < 0))
+    {
+        perror("loopback connect");
+        return false;
+    }
+
+    *sender = accept(server, NULL, NULL);
+    close(server);
+    if (*sender < 0)
+    {
+        perror("loopback accept");
+        return false;
+    }
+    return true;
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    uint32_t conversions = 100000;
+    uint32_t linkSteps = 0;
+    long sendBytes = TCP_STREAM_DEFAULT_SEND_BYTES;
+    bool noDelay = false;
+    int sendBuffer = 0;
+    uint32_t readBytes = 4096;
+    const char *device = NULL;
+    int option;
+
+    while ((option = getopt(argc, argv, "n:d:w:Ns:r:c:")) != -1)
+    {
+        switch (option)
+        {
+            case 'n':   conversions = (uint32_t) strtoul(optarg, NULL, 0);                 break;
+            case 'd':   linkSteps = (uint32_t) strtoul(optarg, NULL, 0);                   break;
+            case 'w':   sendBytes = strtol(optarg, NULL, 0);                               break;
+            case 'N':   noDelay = true;                                                     break;
+            case 's':   sendBuffer = (int) strtol(optarg, NULL, 0);                         break;
+            case 'r':   readBytes = (uint32_t) strtoul(optarg, NULL, 0);                   break;
+            case 'c':   device = optarg;                                                    break;
+            default:
+                fprintf(stderr, "usage: %s [-n conversions] [-d steps] [-w bytes] [-N] [-s sndbuf] [-r read_bytes]"
+                                " [-c address[:port]]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (sendBytes < 1)                          { sendBytes = 1; }
+    if (sendBytes > TCP_STREAM_MAX_SEND_BYTES)  { sendBytes = TCP_STREAM_MAX_SEND_BYTES; }
+    if (readBytes < 1)                          { readBytes = 1; }
+
+    stream_reader reader;
+    memset(&reader, 0, sizeof(reader));
+    reader.readBytes = readBytes;
+
+    // Reader only: check what a device sends
+    if (device)
+    {
+        reader.socket = connectTo(device);
+        if (reader.socket < 0) { return 2; }
+        reader.conversions = conversions;
+
+        uint64_t start_ns = halSimGetTime_ns();
+        readStream(&reader);
+        double elapsed = (double) (halSimGetTime_ns() - start_ns) / 1e9;
+        close(reader.socket);
+
+        printf("received:         %u packets, %u records (%llu bytes) in %.3f s, decimation %u\n",
+               (unsigned) reader.packets, (unsigned) reader.records, (unsigned long long) reader.bytes, elapsed,
+               (unsigned) reader.decimation);
+        printf("sequence:         %llu covered, %u skipped between packets, framing errors %u\n",
+               (unsigned long long) reader.covered, (unsigned) reader.skipped, (unsigned) reader.framingErrors);
+        return (reader.framingErrors == 0) ? 0 : 1;
+    }
+
+    static stream_writer writer;
+    pthread_t readerThread;
+
+    if (!openLoopback(&writer.socket, &reader.socket)) { return 2; }
+    if (sendBuffer && (setsockopt(writer.socket, SOL_SOCKET, SO_SNDBUF, &sendBuffer, sizeof(sendBuffer)) < 0))
+    {
+        perror("SO_SNDBUF");
+    }
+    int flag = noDelay ? 1 : 0;
+    if (setsockopt(writer.socket, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag)) < 0)
+    {
+        perror("TCP_NODELAY");
+    }
+    writer.sendBytes = (uint16_t) sendBytes;
+    writer.noDelay = noDelay;
+
+    if (pthread_create(&readerThread, NULL, readStream, &reader) != 0)
+    {
+        fprintf(stderr, "cannot start the reader\n");
+        return 2;
+    }
+
+    // The pipeline of adc_sim, without its checks of the conversions
+    InitADC();
+    adcControlInit();
+    sampleRingReset();
+
+    stream_link_stats badLink = { 1000, 0, 1 };
+    while (linkSteps--) { streamAdaptToLink(&badLink); }
+
+    static stream_batch batch;
+    stream_decimator decimator;
+    sample_record record;
+    uint32_t n;
+
+    streamBatchReset(&batch);
+    streamDecimatorReset(&decimator);
+
+    uint64_t start_ns = halSimGetTime_ns();
+
+    for (n = 0; n < conversions; n++)
+    {
+        if (!waitForDRDYinterrupt(100)) { break; }
+
+        record.timestamp = getDRDYtime(&record.sequence);
+        streamTrackSequence(record.sequence);
+        if (readData(&record.data))
+        {
+            streamCountCrcError();
+            continue;
+        }
+        sampleRingPush(&record);
+
+        uint32_t now_ms = (uint32_t) ((halSimGetTime_ns() - start_ns) / 1000000u);
+        while (sampleRingPop(&record))
+        {
+            if (!streamDecimatorAccepts(&decimator, &record))
+            {
+                packRecord(&writer, &decimator, &batch, now_ms);
+            }
+            streamDecimatorAdd(&decimator, &record);
+            if (streamDecimatorComplete(&decimator))
+            {
+                packRecord(&writer, &decimator, &batch, now_ms);
+            }
+        }
+
+        // The client task's queue is empty now
+        if ((writer.length > 0) &&
+            (writer.noDelay || ((halSimGetTime_ns() - writer.startTime_ns) >= (TCP_STREAM_COALESCE_MS * 1000000ull))))
+        {
+            writeBuffer(&writer);
+        }
+    }
+    packRecord(&writer, &decimator, &batch, 0);
+    sendBatch(&writer, &batch);
+    writeBuffer(&writer);
+
+    shutdown(writer.socket, SHUT_WR);
+    pthread_join(readerThread, NULL);
+    double elapsed = (double) (halSimGetTime_ns() - start_ns) / 1e9;
+    close(writer.socket);
+    close(reader.socket);
+
+    stream_loss_stats loss;
+    streamGetLossStats(&loss);
+    uint32_t lost = streamLossTotal(&loss);
+    bool sequenceError = (reader.skipped > lost) || ((streamGetDecimation() == 1) && (reader.skipped != lost));
+    if (sequenceError)
+    {
+        fprintf(stderr, "%u sequence numbers skipped between packets, %u lost\n", (unsigned) reader.skipped,
+                (unsigned) lost);
+    }
+    if ((reader.bytes != writer.bytes) || (reader.packets != writer.packets))
+    {
+        fprintf(stderr, "%u packets (%llu bytes) written, %u (%llu bytes) read\n", (unsigned) writer.packets,
+                (unsigned long long) writer.bytes, (unsigned) reader.packets, (unsigned long long) reader.bytes);
+        reader.framingErrors++;
+    }
+
+    printf("conversions:      %u, link mode %u, decimation %u\n", (unsigned) n, (unsigned) streamGetMode(),
+           (unsigned) streamGetDecimation());
+    printf("written:          %u packets in %u writes of up to %u bytes (%llu bytes), %s\n", (unsigned) writer.packets,
+           (unsigned) writer.writes, (unsigned) writer.sendBytes, (unsigned long long) writer.bytes,
+           writer.noDelay ? "nodelay" : "delay");
+    printf("read:             %u packets, %u records (%llu bytes) in reads of 1 to %u bytes\n", (unsigned) reader.packets,
+           (unsigned) reader.records, (unsigned long long) reader.bytes, (unsigned) reader.readBytes);
+    printf("sequence:         %llu covered, %u skipped between packets, %u lost, framing errors %u\n",
+           (unsigned long long) reader.covered, (unsigned) reader.skipped, (unsigned) lost,
+           (unsigned) reader.framingErrors);
+    printf("throughput:       %.0f conversions/s, %.2f MB/s\n", (double) n / elapsed,
+           (double) writer.bytes / elapsed / 1e6);
+
+    return ((reader.framingErrors == 0) && !sequenceError) ? 0 : 1;
+}
@@ -0,0 +1,790 @@
+/**
+ * \brief Receives the UDP stream (see udp_stream.h) on a workstation, puts
+ * the datagrams back in order, counts what was lost and writes the stream
+ * to a file.
+ *
+ * Datagrams are held in a window of -w packets, sorted by sequence number.
+ * The oldest one is written as soon as it is the next expected, or when the
+ * window is full, or when no datagram has come for REORDER_TIMEOUT_MS: a
+ * datagram still missing by then is counted as lost, and if it comes later
+ * it is discarded as late. Gaps in the sequence numbers between the packets
+ * written give the conversions lost, on the network or in the device.
+ *
+ * The output file (-o) gets the packets in order, back to back, which is
+ * the format of the raw TCP stream (see tcp_stream.h); with -f csv, it gets
+ * one line per record instead: sequence number, timestamp in nanoseconds,
+ * status word and the codes of the enabled channels. Compressed packets
+ * (STREAM_ENCODING_RICE) are written as received, or decoded for CSV, and a
+ * datagram that does not decode counts as malformed.
+ *
+ * With -S, the program checks itself over the loopback interface: a second
+ * thread runs the simulated pipeline (see adc_sim.c) and sends each packet
+ * as one datagram, dropping -x per mille of them and holding some back by
+ * -j datagrams, compressed with -z. The run exits with a non-zero status if the conversions
+ * counted as lost are not exactly those of the dropped and late datagrams
+ * and of the pipeline's own losses, if a datagram was malformed, or if one
+ * came too late although -j is below the window.
+ *
+ * Usage: udp_receiver [-p port] [-g group] [-w window] [-o file] [-f raw|csv] [-n conversions]
+ *                     [-t idle_s] [-S] [-x drop_permille] [-j jitter] [-d steps] [-z]
+ *   -p  port to listen on (default UDP_STREAM_DEFAULT_PORT, 5002)
+ *   -g  multicast group to join, e.g. 239.1.2.3
+ *   -w  datagrams held to reorder (default 32, at most MAX_WINDOW)
+ *   -o  file to write the stream to, "-" for the standard output
+ *   -f  raw packets (default) or CSV records
+ *   -n  stop once this many conversions are covered (default: Ctrl-C); with -S,
+ *       conversions to send (default 100000)
+ *   -t  stop after this many seconds without datagrams, once some have come
+ *       (default: never)
+ *   -S  check over loopback with the simulated device
+ *   -x  with -S, datagrams dropped per 1000 (default 10)
+ *   -j  with -S, datagrams a held-back datagram is sent after (default 3)
+ *   -d  with -S, link mode steps down before the run, as in adc_sim (default 0)
+ *   -z  with -S, send STREAM_ENCODING_RICE packets
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE     // struct ip_mreq
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "ads131m0x.h"
+#include "adc_control.h"
+#include "adc_stream.h"
+#include "sample_ring.h"
+#include "hal_sim.h"
+#include "stream_decoder.h"
+
+
+
+//****************************************************************************
+//
+// Internal macros
+//
+//****************************************************************************
+
+/* Value of udp_stream.h, which needs TI-RTOS */
+#define UDP_STREAM_DEFAULT_PORT     (5002)
+
+/* Largest reorder window, in datagrams */
+#define MAX_WINDOW                  (256)
+
+/* Time without datagrams after which the window is written out */
+#define REORDER_TIMEOUT_MS          (100)
+
+/* Receive buffer asked for, so bursts are not dropped by the kernel */
+#define RECEIVE_BUFFER_BYTES        (4 * 1024 * 1024)
+
+/* Sequence number a comes before b, across the wrap */
+#define SEQUENCE_BEFORE(a, b)       ((int32_t) ((a) - (b)) < 0)
+
+
+
+//****************************************************************************
+//
+// Internal data structures
+//
+//****************************************************************************
+
+typedef struct
+{
+    uint32_t    sequence;           // Of the first record
+    uint32_t    next;               // Expected first sequence number of the next packet
+    uint16_t    length;
+    uint8_t     data[STREAM_MAX_PACKET_BYTES];
+} held_packet;
+
+typedef struct
+{
+    held_packet held[MAX_WINDOW];   // Datagrams waiting to be written, in arrival order
+    uint16_t    count;
+    uint16_t    window;
+    bool        started;            // A packet was written and expected is valid
+    uint32_t    expected;
+    bool        seen;               // A datagram was received and highest is valid
+    uint32_t    highest;            // Largest first sequence number received
+
+    FILE       *out;
+    bool        csv;
+    uint8_t     csvMask;            // Channels of the last CSV column header, 0 before the first
+
+    // Results
+    uint32_t    datagrams;
+    uint64_t    bytes;
+    uint32_t    malformed;
+    uint32_t    compressed;         // Datagrams of STREAM_ENCODING_RICE packets
+    uint32_t    late;               // Datagrams that came after their place was written, or twice
+    uint64_t    lateCovered;        // Sequence numbers of those datagrams
+    uint32_t    reordered;          // Datagrams that came after a later one
+    uint32_t    packets;            // Packets written
+    uint32_t    records;
+    uint64_t    covered;            // Sequence numbers covered by the packets written
+    uint64_t    lost;               // Sequence numbers missing between them
+    uint32_t    gaps;
+    uint8_t     mode;               // Link mode and decimation of the last packet
+    uint8_t     decimation;
+} stream_receiver;
+
+typedef struct
+{
+    int         socket;
+    struct sockaddr_in destination;
+    uint32_t    conversions;
+    uint32_t    linkSteps;
+    uint32_t    dropPermille;
+    uint32_t    jitter;
+    unsigned int seed;
+
+    held_packet previous;           // Last packet, sent or dropped once the next one is made
+    bool        hasPrevious;
+    bool        first;
+    held_packet late;               // Packet held back
+    uint32_t    lateCountdown;      // Datagrams to send before it; 0 when none is held
+
+    // Results
+    uint32_t    sent;
+    uint32_t    dropped;
+    uint64_t    droppedCovered;     // Sequence numbers of the dropped packets
+    uint32_t    heldBack;
+    uint32_t    lost;               // streamLossTotal() at the end of the run
+    volatile bool done;
+} stream_sender;
+
+
+
+//****************************************************************************
+//
+// Internal variables
+//
+//****************************************************************************
+
+static volatile sig_atomic_t    interrupted = 0;
+
+
+
+//*****************************************************************************
+//
+//! Reads the little-endian field of a header.
+//
+//*****************************************************************************
+static uint32_t getLE(const uint8_t *bytes, uint16_t size)
+{
+    uint32_t value = 0;
+
+    while (size--) { value = (value << 8) | bytes[size]; }
+    return value;
+}
+
+
+
+//*****************************************************************************
+//
+//! Writes the records of a packet as CSV lines.
+//
+//*****************************************************************************
+static void writeCsv(stream_receiver *receiver, const uint8_t *data, uint16_t length)
+{
+    static uint8_t packet[STREAM_MAX_PACKET_BYTES];
+
+    if (streamDecodePacket(data, length, packet) == 0) { return; }
+
+    uint8_t mask = packet[1];
+    uint16_t count = (uint16_t) getLE(&packet[2], 2);
+    uint32_t sequence = getLE(&packet[4], 4);
+    uint64_t first = (uint64_t) getLE(&packet[8], 4) | ((uint64_t) getLE(&packet[12], 4) << 32);
+    uint32_t span = getLE(&packet[16], 4);
+    uint8_t decimation = packet[21];
+    const uint8_t *record = &packet[STREAM_HEADER_BYTES];
+    uint16_t i;
+    uint8_t channel;
+
+    if (mask != receiver->csvMask)
+    {
+        fprintf(receiver->out, "sequence,time_ns,status");
+        for (channel = 0; channel < 8; channel++)
+        {
+            if (mask & (1u << channel)) { fprintf(receiver->out, ",ch%u", (unsigned) channel); }
+        }
+        fprintf(receiver->out, "\n");
+        receiver->csvMask = mask;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        uint64_t time_ns = first + ((count > 1) ? ((uint64_t) span * i) / (count - 1u) : 0);
+
+        fprintf(receiver->out, "%u,%llu,0x%04X", (unsigned) streamRecordSequence(sequence, i, decimation),
+                (unsigned long long) time_ns, (unsigned) getLE(record, 2));
+        record += 2;
+
+        for (channel = 0; channel < 8; channel++)
+        {
+            if (!(mask & (1u << channel))) { continue; }
+
+            int32_t code = (int32_t) (getLE(record, STREAM_CODE_BYTES) << 8) >> 8;
+            fprintf(receiver->out, ",%d", (int) code);
+            record += STREAM_CODE_BYTES;
+        }
+        fprintf(receiver->out, "\n");
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Writes out the held datagram with the lowest sequence number, counting
+//! the sequence numbers missing before it.
+//
+//*****************************************************************************
+static void writeOldest(stream_receiver *receiver)
+{
+    uint16_t oldest = 0;
+    uint16_t n;
+
+    for (n = 1; n < receiver->count; n++)
+    {
+        if (SEQUENCE_BEFORE(receiver->held[n].sequence, receiver->held[oldest].sequence)) { oldest = n; }
+    }
+
+    held_packet *packet = &receiver->held[oldest];
+
+    if (receiver->started && (packet->sequence != receiver->expected))
+    {
+        receiver->lost += packet->sequence - receiver->expected;
+        receiver->gaps++;
+    }
+    receiver->started = true;
+    receiver->expected = packet->next;
+
+    receiver->packets++;
+    receiver->records += (uint16_t) getLE(&packet->data[2], 2);
+    receiver->covered += packet->next - packet->sequence;
+    receiver->mode = packet->data[20];
+    receiver->decimation = packet->data[21];
+
+    if (receiver->out && receiver->csv)
+    {
+        writeCsv(receiver, packet->data, packet->length);
+    }
+    else if (receiver->out)
+    {
+        fwrite(packet->data, 1, packet->length, receiver->out);
+    }
+
+    // The order of the held datagrams does not matter
+    receiver->count--;
+    if (oldest != receiver->count)
+    {
+        memcpy(packet, &receiver->held[receiver->count], sizeof(*packet));
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Takes one datagram into the window, and writes out the datagrams that
+//! can be.
+//
+//*****************************************************************************
+static void receiveDatagram(stream_receiver *receiver, const uint8_t *data, uint16_t length)
+{
+    uint16_t n;
+
+    receiver->datagrams++;
+    receiver->bytes += length;
+
+    static uint8_t decoded[STREAM_MAX_PACKET_BYTES];
+
+    if ((length < STREAM_HEADER_BYTES) || (streamPacketBytes(data) != length) ||
+        (streamDecodePacket(data, length, decoded) == 0))
+    {
+        receiver->malformed++;
+        return;
+    }
+    if (data[22] == STREAM_ENCODING_RICE) { receiver->compressed++; }
+
+    uint32_t sequence = getLE(&data[4], 4);
+    uint32_t next = streamRecordSequence(sequence, (uint16_t) getLE(&data[2], 2), data[21]);
+
+    if (receiver->started && SEQUENCE_BEFORE(sequence, receiver->expected))
+    {
+        receiver->late++;
+        receiver->lateCovered += next - sequence;
+        return;
+    }
+    for (n = 0; n < receiver->count; n++)
+    {
+        if (receiver->held[n].sequence == sequence)
+        {
+            receiver->late++;
+            return;
+        }
+    }
+
+    if (receiver->seen && SEQUENCE_BEFORE(sequence, receiver->highest))
+    {
+        receiver->reordered++;
+    }
+    else
+    {
+        receiver->highest = sequence;
+        receiver->seen = true;
+    }
+
+    held_packet *packet = &receiver->held[receiver->count++];
+    packet->sequence = sequence;
+    packet->next = next;
+    packet->length = length;
+    memcpy(packet->data, data, length);
+
+    // Write what is in order; before the first packet, wait for a full window
+    while (receiver->count > 0)
+    {
+        bool inOrder = false;
+
+        for (n = 0; receiver->started && (n < receiver->count); n++)
+        {
+            if (receiver->held[n].sequence == receiver->expected) { inOrder = true; }
+        }
+        if (!inOrder && (receiver->count < receiver->window)) { break; }
+
+        writeOldest(receiver);
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Receives datagrams until -n conversions are covered, the sender is done,
+//! the stream has stopped for idle_s seconds or the program is interrupted,
+//! then writes out the window.
+//
+//*****************************************************************************
+static void receiveStream(stream_receiver *receiver, int socket, uint64_t conversions, uint32_t idle_s,
+                          const stream_sender *sender)
+{
+    static uint8_t buffer[65536];
+    uint32_t idle_ms = 0;
+
+    while (!interrupted && ((conversions == 0) || (receiver->covered < conversions)))
+    {
+        ssize_t received = recv(socket, buffer, sizeof(buffer), 0);
+
+        if (received >= 0)
+        {
+            receiveDatagram(receiver, buffer, (uint16_t) ((received > 0xFFFF) ? 0xFFFF : received));
+            idle_ms = 0;
+            continue;
+        }
+        if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+        {
+            if (errno != EINTR) { perror("recv"); }
+            continue;
+        }
+
+        // Whatever is missing by now is lost
+        while (receiver->count > 0) { writeOldest(receiver); }
+
+        if (sender && sender->done) { break; }
+        if (receiver->datagrams > 0) { idle_ms += REORDER_TIMEOUT_MS; }
+        if (idle_s && (idle_ms >= (idle_s * 1000u))) { break; }
+    }
+
+    while (receiver->count > 0) { writeOldest(receiver); }
+}
+
+
+
+//*****************************************************************************
+//
+//! Sends one datagram of the self-check, holding one back now and then.
+//
+//*****************************************************************************
+static void sendDatagram(stream_sender *sender, const held_packet *packet)
+{
+    if ((sender->lateCountdown == 0) && (sender->jitter > 0) && ((rand_r(&sender->seed) % 8) == 0))
+    {
+        memcpy(&sender->late, packet, sizeof(*packet));
+        sender->lateCountdown = sender->jitter;
+        sender->heldBack++;
+        return;
+    }
+
+    if (sendto(sender->socket, packet->data, packet->length, 0, (struct sockaddr *) &sender->destination,
+               sizeof(sender->destination)) < 0)
+    {
+        perror("sendto");
+    }
+    sender->sent++;
+
+    if ((sender->lateCountdown > 0) && (--sender->lateCountdown == 0))
+    {
+        sendto(sender->socket, sender->late.data, sender->late.length, 0,
+               (struct sockaddr *) &sender->destination, sizeof(sender->destination));
+        sender->sent++;
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Hands a finished batch to the network, and empties the batch. The packet
+//! before it is sent or dropped now; the first and the last packets are
+//! never dropped, so every drop leaves a gap the receiver can see.
+//
+//*****************************************************************************
+static void sendBatch(stream_sender *sender, stream_batch *batch)
+{
+    if (batch->count == 0) { return; }
+
+    if (sender->hasPrevious)
+    {
+        held_packet *previous = &sender->previous;
+
+        if (!sender->first && ((uint32_t) (rand_r(&sender->seed) % 1000) < sender->dropPermille))
+        {
+            sender->dropped++;
+            sender->droppedCovered += previous->next - previous->sequence;
+        }
+        else
+        {
+            sendDatagram(sender, previous);
+        }
+        sender->first = false;
+    }
+
+    streamBatchEncode(batch);
+    sender->previous.sequence = getLE(&batch->buffer[4], 4);
+    sender->previous.next = streamRecordSequence(sender->previous.sequence, batch->count, batch->buffer[21]);
+    sender->previous.length = batch->length;
+    memcpy(sender->previous.data, batch->buffer, batch->length);
+    sender->hasPrevious = true;
+
+    streamBatchReset(batch);
+}
+
+
+
+//*****************************************************************************
+//
+//! Moves the record formed by the decimator into the batch, as packRecord()
+//! in empty_min.c does.
+//
+//*****************************************************************************
+static void packRecord(stream_sender *sender, stream_decimator *decimator, stream_batch *batch, uint32_t now_ms)
+{
+    stream_record packed;
+
+    if (!streamDecimatorTake(decimator, &packed)) { return; }
+
+    if (!streamBatchAccepts(batch, &packed))
+    {
+        sendBatch(sender, batch);
+    }
+    streamBatchAdd(batch, &packed, now_ms);
+
+    if (streamBatchFlushDue(batch, now_ms))
+    {
+        sendBatch(sender, batch);
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Runs the simulated pipeline of the self-check and sends its packets.
+//
+//*****************************************************************************
+static void *sendStream(void *argument)
+{
+    stream_sender *sender = (stream_sender *) argument;
+    static stream_batch batch;
+    stream_decimator decimator;
+    sample_record record;
+    uint32_t n;
+
+    InitADC();
+    adcControlInit();
+    sampleRingReset();
+
+    stream_link_stats badLink = { 1000, 0, 1 };
+    while (sender->linkSteps--) { streamAdaptToLink(&badLink); }
+
+    streamBatchReset(&batch);
+    streamDecimatorReset(&decimator);
+    sender->first = true;
+
+    uint64_t start_ns = halSimGetTime_ns();
+
+    for (n = 0; n < sender->conversions; n++)
+    {
+        if (!waitForDRDYinterrupt(100)) { break; }
+
+        record.timestamp = getDRDYtime(&record.sequence);
+        streamTrackSequence(record.sequence);
+        if (readData(&record.data))
+        {
+            streamCountCrcError();
+            continue;
+        }
+        sampleRingPush(&record);
+
+        uint32_t now_ms = (uint32_t) ((halSimGetTime_ns() - start_ns) / 1000000u);
+        while (sampleRingPop(&record))
+        {
+            if (!streamDecimatorAccepts(&decimator, &record))
+            {
+                packRecord(sender, &decimator, &batch, now_ms);
+            }
+            streamDecimatorAdd(&decimator, &record);
+            if (streamDecimatorComplete(&decimator))
+            {
+                packRecord(sender, &decimator, &batch, now_ms);
+            }
+        }
+    }
+    packRecord(sender, &decimator, &batch, 0);
+    sendBatch(sender, &batch);
+
+    // The last packet, then the one held back if it is still waiting
+    sender->jitter = 0;
+    if (sender->hasPrevious) { sendDatagram(sender, &sender->previous); }
+    if (sender->lateCountdown > 0)
+    {
+        sendto(sender->socket, sender->late.data, sender->late.length, 0,
+               (struct sockaddr *) &sender->destination, sizeof(sender->destination));
+        sender->sent++;
+    }
+
+    stream_loss_stats loss;
+    streamGetLossStats(&loss);
+    sender->lost = streamLossTotal(&loss);
+    sender->done = true;
+    return NULL;
+}
+
+
+
+//*****************************************************************************
+//
+//! Opens the receiving socket, joining a multicast group if one is given.
+//!
+//! \return The socket, or -1.
+//
+//*****************************************************************************
+static int openReceiver(uint16_t port, const char *group, struct sockaddr_in *bound)
+{
+    struct sockaddr_in address;
+    struct timeval timeout = { 0, REORDER_TIMEOUT_MS * 1000 };
+    int size = RECEIVE_BUFFER_BYTES;
+    int reuse = 1;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *) &address, sizeof(address)) < 0)
+    {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+
+    if (group)
+    {
+        struct ip_mreq membership;
+
+        memset(&membership, 0, sizeof(membership));
+        membership.imr_interface.s_addr = htonl(INADDR_ANY);
+        if ((inet_pton(AF_INET, group, &membership.imr_multiaddr) != 1) ||
+            (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) < 0))
+        {
+            fprintf(stderr, "%s: cannot join the multicast group\n", group);
+            close(fd);
+            return -1;
+        }
+    }
+
+    socklen_t length = sizeof(*bound);
+    getsockname(fd, (struct sockaddr *) bound, &length);
+    return fd;
+}
+
+
+
+static void onInterrupt(int signal)
+{
+    (void) signal;
+    interrupted = 1;
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    long port = UDP_STREAM_DEFAULT_PORT;
+    const char *group = NULL;
+    long window = 32;
+    const char *output = NULL;
+    bool csv = false;
+    uint32_t conversions = 0;
+    uint32_t idle_s = 0;
+    bool selfCheck = false;
+    uint32_t dropPermille = 10;
+    uint32_t jitter = 3;
+    uint32_t linkSteps = 0;
+    int option;
+
+    while ((option = getopt(argc, argv, "p:g:w:o:f:n:t:Sx:j:d:z")) != -1)
+    {
+        switch (option)
+        {
+            case 'p':   port = strtol(optarg, NULL, 0);                                     break;
+            case 'g':   group = optarg;                                                     break;
+            case 'w':   window = strtol(optarg, NULL, 0);                                   break;
+            case 'o':   output = optarg;                                                    break;
+            case 'f':   csv = !strcmp(optarg, "csv");                                       break;
+            case 'n':   conversions = (uint32_t) strtoul(optarg, NULL, 0);                 break;
+            case 't':   idle_s = (uint32_t) strtoul(optarg, NULL, 0);                      break;
+            case 'S':   selfCheck = true;                                                   break;
+            case 'x':   dropPermille = (uint32_t) strtoul(optarg, NULL, 0);                break;
+            case 'j':   jitter = (uint32_t) strtoul(optarg, NULL, 0);                      break;
+            case 'd':   linkSteps = (uint32_t) strtoul(optarg, NULL, 0);                   break;
+            case 'z':   streamSetEncoding(STREAM_ENCODING_RICE);                            break;
+            default:
+                fprintf(stderr, "usage: %s [-p port] [-g group] [-w window] [-o file] [-f raw|csv] [-n conversions]"
+                                " [-t idle_s] [-S] [-x drop_permille] [-j jitter] [-d steps] [-z]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (window < 1)             { window = 1; }
+    if (window > MAX_WINDOW)    { window = MAX_WINDOW; }
+    if ((port < 0) || (port > 0xFFFF))
+    {
+        fprintf(stderr, "%ld: bad port\n", port);
+        return 2;
+    }
+
+    static stream_receiver receiver;
+    receiver.window = (uint16_t) window;
+    receiver.csv = csv;
+    if (output)
+    {
+        receiver.out = strcmp(output, "-") ? fopen(output, "wb") : stdout;
+        if (!receiver.out)
+        {
+            perror(output);
+            return 2;
+        }
+    }
+
+    struct sockaddr_in bound;
+    int fd = openReceiver(selfCheck ? 0 : (uint16_t) port, group, &bound);
+    if (fd < 0) { return 2; }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onInterrupt;
+    sigaction(SIGINT, &action, NULL);
+
+    if (!selfCheck)
+    {
+        fprintf(stderr, "listening on port %u%s%s\n", (unsigned) ntohs(bound.sin_port), group ? ", group " : "",
+                group ? group : "");
+    }
+
+    static stream_sender sender;
+    pthread_t senderThread;
+
+    if (selfCheck)
+    {
+        sender.socket = socket(AF_INET, SOCK_DGRAM, 0);
+        sender.destination.sin_family = AF_INET;
+        sender.destination.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        sender.destination.sin_port = bound.sin_port;
+        sender.conversions = conversions ? conversions : 100000;
+        sender.linkSteps = linkSteps;
+        sender.dropPermille = dropPermille;
+        sender.jitter = jitter;
+        sender.seed = 1;
+        conversions = 0;
+
+        if ((sender.socket < 0) || (pthread_create(&senderThread, NULL, sendStream, &sender) != 0))
+        {
+            fprintf(stderr, "cannot start the sender\n");
+            return 2;
+        }
+    }
+
+    uint64_t start_ns = halSimGetTime_ns();
+    receiveStream(&receiver, fd, conversions, idle_s, selfCheck ? &sender : NULL);
+    double elapsed = (double) (halSimGetTime_ns() - start_ns) / 1e9;
+    close(fd);
+
+    if (receiver.out && (receiver.out != stdout)) { fclose(receiver.out); }
+
+    printf("received:         %u datagrams (%llu bytes, %u compressed) in %.3f s, %u malformed, %u late or repeated\n",
+           (unsigned) receiver.datagrams, (unsigned long long) receiver.bytes, (unsigned) receiver.compressed, elapsed,
+           (unsigned) receiver.malformed, (unsigned) receiver.late);
+    printf("written:          %u packets, %u records, %u came out of order (window %u)\n", (unsigned) receiver.packets,
+           (unsigned) receiver.records, (unsigned) receiver.reordered, (unsigned) receiver.window);
+    printf("sequence:         %llu covered, %llu lost in %u gaps, link mode %u, decimation %u\n",
+           (unsigned long long) receiver.covered, (unsigned long long) receiver.lost, (unsigned) receiver.gaps,
+           (unsigned) receiver.mode, (unsigned) receiver.decimation);
+
+    if (!selfCheck)
+    {
+        return (receiver.malformed == 0) ? 0 : 1;
+    }
+
+    pthread_join(senderThread, NULL);
+    close(sender.socket);
+
+    // Late datagrams were counted as lost when their place was written. Decimated
+    // records hide the conversions lost after the start of a group
+    uint64_t expectedLost = sender.droppedCovered + receiver.lateCovered + sender.lost;
+    bool lossError = (streamGetDecimation() == 1) ? (receiver.lost != expectedLost)
+                                                  : (receiver.lost > expectedLost);
+    bool lateError = (jitter < receiver.window) && (receiver.late != 0);
+
+    printf("sent:             %u datagrams, %u dropped (%llu sequence numbers), %u held back by %u, %u lost in the "
+           "pipeline\n", (unsigned) sender.sent, (unsigned) sender.dropped, (unsigned long long) sender.droppedCovered,
+           (unsigned) sender.heldBack, (unsigned) jitter, (unsigned) sender.lost);
+
+    if (lossError)
+    {
+        fprintf(stderr, "%llu sequence numbers lost, %llu expected\n", (unsigned long long) receiver.lost,
+                (unsigned long long) expectedLost);
+    }
+    if (receiver.datagrams != sender.sent)
+    {
+        fprintf(stderr, "%u datagrams sent, %u received\n", (unsigned) sender.sent, (unsigned) receiver.datagrams);
+    }
+
+    return ((receiver.malformed == 0) && !lossError && !lateError && (receiver.datagrams == sender.sent)) ? 0 : 1;
+}
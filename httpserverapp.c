@@ -72,6 +72,13 @@
 #include "timer_if.h"
 #include "gpio_if.h"
 #include "httpserverapp.h"
+#include "adc_control.h"
+#include "adc_stream.h"
+#include "benchmark.h"
+#include "log_ring.h"
+#include "tcp_stream.h"
+#include "udp_stream.h"
+#include "ws_clients.h"
 
 typedef struct
 {
@@ -94,9 +101,17 @@ typedef enum{
 ****************************************************************************/
 char *startcounter = "start";
 char *stopcounter = "stop";
+char *batchcommand = "batch";
+char *ratecommand = "rate";
+char *channelscommand = "channels";
+char *benchcommand = "bench";
+char *statscommand = "stats";
+char *subscribecommand = "subscribe";
+char *tcpcommand = "tcp";
+char *udpcommand = "udp";
+char *encodingcommand = "encoding";
 UINT8 g_success = 0;
 int g_close = 0;
-UINT16 g_uConnection;
 static volatile unsigned long g_ulBase;
 static OsiSyncObj_t g_CounterSyncObj;
 OsiMsgQ_t g_recvQueue;
@@ -105,6 +120,238 @@ extern Semaphore_Handle httpServerInitCompleteSemaphore;
 
 void InitializeAppVariables();
 
+/*!
+ *  \brief                  Logs that a client command was ignored. The command text is not logged: it
+ *                          is in the receive buffer, which is reused before the log is printed.
+ *
+ *  \return                 none.
+ *
+ */
+static void IgnoreMalformedCommand(void)
+{
+    LOG_PRINT("Ignoring malformed command\r\n");
+}
+
+/*!
+ *  \brief                  Applies a text command received from a websocket client.
+ *
+ *                          Supported commands:
+ *                          "batch <records> <latency_ms>" - sets the stream flush policy
+ *                                                           (0 records = sized from the data rate).
+ *                          "rate <osr> <hr|lp|vlp>"       - sets the ADC oversampling ratio and power mode.
+ *                                                           LP and VLP are rejected at an 8.192 MHz CLKIN.
+ *                          "channels <mask>"              - enables the channels set in mask (bit n =
+ *                                                           channel n, decimal or 0x hex).
+ *                          "bench <rate_Hz>"              - (ENABLE_BENCHMARK only) restarts the benchmark
+ *                                                           with a synthetic DRDY rate (0 = nDRDY pin).
+ *                          "stats"                        - (ENABLE_BENCHMARK only) sends the benchmark
+ *                                                           report back as "bench: " text frames.
+ *                          "subscribe <data|reports|all|none>"
+ *                                                         - sets what the sending client receives:
+ *                                                           conversions, "loss:"/"bench:" reports, or both.
+ *                          "tcp <send_bytes> <nodelay|delay>"
+ *                                                         - sets the bytes collected per send to the raw TCP
+ *                                                           clients, and whether partial buffers wait for more
+ *                                                           packets (see tcp_stream.h).
+ *                          "udp <a.b.c.d> [port]"         - sends the stream as UDP datagrams to a unicast or
+ *                                                           multicast address (see udp_stream.h).
+ *                          "udp off"                      - stops the UDP stream.
+ *                          "encoding <raw|rice>"          - sends the records as they are, or compressed
+ *                                                           where that makes packets smaller (see
+ *                                                           adc_stream.h).
+ *
+ *  \param[in] uConnection  Websocket Client Id of the sender.
+ *  \param[in] *command     Null-terminated command string.
+ *
+ *  \return                 none.
+ *
+ */
+static void HandleClientCommand(UINT16 uConnection, const char *command)
+{
+    size_t length = strlen(subscribecommand);
+
+    if (!strncmp(command, subscribecommand, length) && (command[length] == ' '))
+    {
+        const char *topic = &command[length + 1];
+        UINT8 subscription;
+
+        if (!strcmp(topic, "data"))         { subscription = WS_SUBSCRIBE_DATA; }
+        else if (!strcmp(topic, "reports")) { subscription = WS_SUBSCRIBE_REPORTS; }
+        else if (!strcmp(topic, "all"))     { subscription = WS_SUBSCRIBE_ALL; }
+        else if (!strcmp(topic, "none"))    { subscription = WS_SUBSCRIBE_NONE; }
+        else
+        {
+            IgnoreMalformedCommand();
+            return;
+        }
+
+        wsClientSubscribe(uConnection, subscription);
+        return;
+    }
+
+    length = strlen(batchcommand);
+
+    if (!strncmp(command, batchcommand, length) && (command[length] == ' '))
+    {
+        char *end;
+        unsigned long records = strtoul(&command[length], &end, 10);
+        unsigned long latency = strtoul(end, &end, 10);
+
+        if (*end != '\0')
+        {
+            IgnoreMalformedCommand();
+            return;
+        }
+
+        streamSetFlushPolicy((UINT16)(records > 0xFFFF ? 0xFFFF : records), (UINT32)latency);
+        LOG_PRINT("Batch policy: %u records, %u ms\r\n", streamGetBatchRecords(), streamGetBatchLatency());
+        return;
+    }
+
+    length = strlen(tcpcommand);
+    if (!strncmp(command, tcpcommand, length) && (command[length] == ' '))
+    {
+        char *end;
+        unsigned long sendBytes = strtoul(&command[length], &end, 10);
+        bool noDelay;
+
+        if (!strcmp(end, " nodelay"))       { noDelay = true; }
+        else if (!strcmp(end, " delay"))    { noDelay = false; }
+        else
+        {
+            IgnoreMalformedCommand();
+            return;
+        }
+
+        tcpStreamSetOptions((UINT16)(sendBytes > 0xFFFF ? 0xFFFF : sendBytes), noDelay);
+        LOG_PRINT("TCP stream: %u bytes per send, %s\r\n", tcpStreamGetSendBytes(),
+                  tcpStreamGetNoDelay() ? "nodelay" : "delay");
+        return;
+    }
+
+    length = strlen(udpcommand);
+    if (!strncmp(command, udpcommand, length) && (command[length] == ' '))
+    {
+        const char *field = &command[length + 1];
+        char *end = NULL;
+        unsigned long octet;
+        unsigned long port = UDP_STREAM_DEFAULT_PORT;
+        UINT32 address = 0;
+        int n;
+
+        if (!strcmp(field, "off"))
+        {
+            udpStreamStop();
+            return;
+        }
+
+        for (n = 0; n < 4; n++)
+        {
+            octet = strtoul(field, &end, 10);
+            if ((end == field) || (octet > 255) || ((n < 3) && (*end != '.')))
+            {
+                IgnoreMalformedCommand();
+                return;
+            }
+            address = (address << 8) | octet;
+            field = end + 1;
+        }
+        if (*end == ' ')
+        {
+            port = strtoul(end + 1, &end, 10);
+        }
+        if ((*end != '\0') || (port == 0) || (port > 0xFFFF))
+        {
+            IgnoreMalformedCommand();
+            return;
+        }
+
+        udpStreamStart(address, (UINT16) port);
+        return;
+    }
+
+    length = strlen(encodingcommand);
+    if (!strncmp(command, encodingcommand, length) && (command[length] == ' '))
+    {
+        const char *encoding = &command[length + 1];
+
+        if (!strcmp(encoding, "raw"))       { streamSetEncoding(STREAM_ENCODING_RAW); }
+        else if (!strcmp(encoding, "rice")) { streamSetEncoding(STREAM_ENCODING_RICE); }
+        else
+        {
+            IgnoreMalformedCommand();
+            return;
+        }
+
+        LOG_PRINT("Stream encoding: %s\r\n", (streamGetEncoding() == STREAM_ENCODING_RICE) ? "rice" : "raw");
+        return;
+    }
+
+    length = strlen(ratecommand);
+    if (!strncmp(command, ratecommand, length) && (command[length] == ' '))
+    {
+        char *end;
+        unsigned long osr = strtoul(&command[length], &end, 10);
+        UINT16 powerMode;
+
+        if (!strcmp(end, " hr"))        { powerMode = CLOCK_PWR_HR; }
+        else if (!strcmp(end, " lp"))   { powerMode = CLOCK_PWR_LP; }
+        else if (!strcmp(end, " vlp"))  { powerMode = CLOCK_PWR_VLP; }
+        else
+        {
+            IgnoreMalformedCommand();
+            return;
+        }
+
+        // Applied by the acquisition task, which owns the SPI bus
+        adcControlRequestDataRate((UINT16)(osr > 0xFFFF ? 0xFFFF : osr), powerMode);
+        return;
+    }
+
+    length = strlen(channelscommand);
+    if (!strncmp(command, channelscommand, length) && (command[length] == ' '))
+    {
+        char *end;
+        unsigned long mask = strtoul(&command[length], &end, 0);
+
+        if ((*end != '\0') || (mask == 0) || (mask & ~(unsigned long)ALL_CHANNELS_MASK))
+        {
+            IgnoreMalformedCommand();
+            return;
+        }
+
+        // Applied by the acquisition task, which owns the SPI bus
+        adcControlRequestChannelMask((UINT8)mask);
+        return;
+    }
+
+#ifdef ENABLE_BENCHMARK
+    length = strlen(benchcommand);
+    if (!strncmp(command, benchcommand, length) && (command[length] == ' '))
+    {
+        char *end;
+        unsigned long rate = strtoul(&command[length], &end, 10);
+
+        if (*end != '\0')
+        {
+            IgnoreMalformedCommand();
+            return;
+        }
+
+        // Applied by the acquisition task, which owns the DRDY source
+        adcControlRequestDrdyRate((UINT32)rate);
+        return;
+    }
+
+    if (!strcmp(command, statscommand))
+    {
+        // Published by the sender task to the clients subscribed to reports
+        benchRequestReport();
+        return;
+    }
+#endif
+}
+
 void WebSocketCloseSessionHandler(void)
 {
 	g_close = 1;
@@ -133,12 +380,12 @@ void WebSocketRecvEventHandler(UINT16 uConnection, char *ReadBuffer)
 
     // Notify that HTTP server initialization is complete
     Semaphore_post(httpServerInitCompleteSemaphore);
-    g_uConnection = msg.connection;
+
+    HandleClientCommand(msg.connection, msg.buffer);
 
 #if 0
     if (!strcmp(msg.buffer,startcounter))
     {
-        g_uConnection = msg.connection;
         // Signal to Counter task to start counter
         osi_SyncObjSignal(&g_CounterSyncObj);
     }
@@ -165,6 +412,9 @@ void WebSocketRecvEventHandler(UINT16 uConnection, char *ReadBuffer)
 void WebSocketHandshakeEventHandler(UINT16 uConnection)
 {
 	g_success = 1;
+
+	// Data and reports are fanned out to every client in the table
+	wsClientOpen(uConnection);
 }
 
 //****************************************************************************
@@ -0,0 +1,215 @@
+/**
+ * \brief Deferred logging through a lock-free ring of unformatted messages
+ * (see log_ring.h).
+ */
+
+#include <stdio.h>
+
+#include "log_ring.h"
+
+
+
+//****************************************************************************
+//
+// Internal macros
+//
+//****************************************************************************
+
+#if (LOG_RING_SIZE & (LOG_RING_SIZE - 1))
+#error "LOG_RING_SIZE must be a power of two"
+#endif
+
+#define LOG_INDEX(n)        ((n) & (LOG_RING_SIZE - 1))
+#define LOG_LAP(n)          ((n) & ~(LOG_RING_SIZE - 1))
+
+/* Orders the record contents against the flag that publishes or releases it */
+#if defined(__TI_COMPILER_VERSION__)
+#define LOG_BARRIER()       __asm(" dmb")
+#elif defined(__GNUC__)
+#define LOG_BARRIER()       __sync_synchronize()
+#endif
+
+
+
+//****************************************************************************
+//
+// Internal data structures
+//
+//****************************************************************************
+
+typedef struct
+{
+    /* LOG_LAP() of the position that uses the record next while it is free,
+     * plus one once its message is published; starts out free at lap 0 */
+    volatile uint32_t   lap;
+    const char         *format;
+    uint32_t            args[LOG_MAX_ARGS];
+} log_record;
+
+
+
+//****************************************************************************
+//
+// Internal variables
+//
+//****************************************************************************
+
+static log_record           ring[LOG_RING_SIZE];
+
+// Next position to reserve, shared by all producers
+static volatile uint32_t    reserve = 0;
+
+// Next position to format; written by the draining task only
+static uint32_t             drain = 0;
+
+// Messages dropped because the ring was full
+static volatile uint32_t    dropped = 0;
+
+
+
+//****************************************************************************
+//
+// Internal function prototypes
+//
+//****************************************************************************
+
+static bool compareAndSwap(volatile uint32_t *word, uint32_t expected, uint32_t desired);
+
+
+
+//*****************************************************************************
+//
+//! Queues a message. Producer side; use LOG_PRINT() instead.
+//!
+//! \fn void logPush(const char *format, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+//!
+//! \param format printf-style format string; must stay valid until drained.
+//! \param arg0 ... arg3 argument words, in the order the format uses them.
+//!
+//! Safe to call from any task or interrupt handler.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void logPush(const char *format, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+    log_record *record;
+    uint32_t position;
+
+    // Claim the next free position; retry if another producer claimed it first
+    while (1)
+    {
+        position = reserve;
+        record = &ring[LOG_INDEX(position)];
+
+        int32_t state = (int32_t) (record->lap - LOG_LAP(position));
+        if (state < 0)
+        {
+            // Still holds a message of the previous lap: the ring is full
+            uint32_t count;
+            do { count = dropped; } while (!compareAndSwap(&dropped, count, count + 1));
+            return;
+        }
+        if ((state == 0) && compareAndSwap(&reserve, position, position + 1))
+        {
+            break;
+        }
+    }
+
+    record->format  = format;
+    record->args[0] = arg0;
+    record->args[1] = arg1;
+    record->args[2] = arg2;
+    record->args[3] = arg3;
+
+    // Publish the message only after it has been written
+    LOG_BARRIER();
+    record->lap = LOG_LAP(position) + 1;
+}
+
+
+
+//*****************************************************************************
+//
+//! Formats the oldest queued message. Consumer side.
+//!
+//! \fn bool logRingFormat(char *buffer, uint16_t size)
+//!
+//! \param buffer destination of the null-terminated message.
+//! \param size size of buffer; LOG_LINE_BYTES is enough for the messages of
+//! this application, longer ones are truncated.
+//!
+//! NOTE: Call from a single task only.
+//!
+//! \return true if a message was formatted, false if none is ready.
+//
+//*****************************************************************************
+bool logRingFormat(char *buffer, uint16_t size)
+{
+    log_record *record = &ring[LOG_INDEX(drain)];
+    uint32_t args[LOG_MAX_ARGS];
+    const char *format;
+
+    // Messages are formatted in order, so one still being written holds up the rest
+    if (record->lap != (LOG_LAP(drain) + 1)) { return false; }
+
+    // Read the message only after its publication has been observed
+    LOG_BARRIER();
+    format  = record->format;
+    args[0] = record->args[0];
+    args[1] = record->args[1];
+    args[2] = record->args[2];
+    args[3] = record->args[3];
+
+    // Release the record to the producers of the next lap
+    LOG_BARRIER();
+    record->lap = LOG_LAP(drain) + LOG_RING_SIZE;
+    drain++;
+
+    snprintf(buffer, size, format, args[0], args[1], args[2], args[3]);
+    return true;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the number of messages dropped because the ring was full.
+//!
+//! \fn uint32_t logRingDropped(void)
+//!
+//! \return Messages dropped since start-up.
+//
+//*****************************************************************************
+uint32_t logRingDropped(void)
+{
+    return dropped;
+}
+
+
+
+//****************************************************************************
+//
+// Internal functions
+//
+//****************************************************************************
+
+
+//*****************************************************************************
+//
+//! Replaces a word with desired if it still holds expected, atomically with
+//! respect to other tasks and interrupts.
+//!
+//! \return true if the word was replaced.
+//
+//*****************************************************************************
+static bool compareAndSwap(volatile uint32_t *word, uint32_t expected, uint32_t desired)
+{
+#if defined(__TI_COMPILER_VERSION__)
+    // The store fails if the word was written or an exception was taken since the load
+    if (__ldrex((void *) word) != expected) { return false; }
+    return (__strex(desired, (void *) word) == 0);
+#else
+    return __sync_bool_compare_and_swap(word, expected, desired);
+#endif
+}
@@ -0,0 +1,69 @@
+/**
+ * \brief Deferred logging through a lock-free ring of unformatted messages.
+ *
+ * LOG_PRINT() stores a pointer to the format string and up to LOG_MAX_ARGS
+ * argument words in a fixed-size record; it does not format, allocate or
+ * touch the UART, so it can be called from any task or interrupt handler on
+ * the acquisition path. A low-priority task later formats the records with
+ * logRingFormat() and writes them to the console.
+ *
+ * Producers reserve a record with an exclusive load/store on the reserve
+ * index and publish it through a per-record flag, so any number of tasks and
+ * interrupts can log concurrently without disabling interrupts. When the ring
+ * is full, new messages are dropped and counted.
+ *
+ * NOTE: Arguments are stored as 32-bit words and read back when the message
+ * is formatted. Use integer conversions (%d, %u, %x, %c) and %s only with
+ * strings that are never modified or freed, such as string literals.
+ */
+
+#ifndef LOG_RING_H_
+#define LOG_RING_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+//****************************************************************************
+//
+// Constants
+//
+//****************************************************************************
+
+/* Number of records in the ring; must be a power of two */
+#define LOG_RING_SIZE               (64U)
+
+/* Arguments stored with each message */
+#define LOG_MAX_ARGS                (4U)
+
+/* Longest formatted message, including the terminator */
+#define LOG_LINE_BYTES              (128U)
+
+
+
+//****************************************************************************
+//
+// Logging macro
+//
+//****************************************************************************
+
+/* LOG_PRINT(format, ...) queues a message with up to LOG_MAX_ARGS arguments;
+ * missing arguments are passed as 0 and ignored by the format */
+#define LOG_PRINT(...)                          LOG_PRINT_ARGS(__VA_ARGS__, 0, 0, 0, 0, 0)
+#define LOG_PRINT_ARGS(format, a, b, c, d, ...) logPush((format), (uint32_t) (a), (uint32_t) (b), \
+                                                        (uint32_t) (c), (uint32_t) (d))
+
+
+
+//****************************************************************************
+//
+// Function prototypes
+//
+//****************************************************************************
+
+void        logPush(const char *format, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3);
+bool        logRingFormat(char *buffer, uint16_t size);
+uint32_t    logRingDropped(void);
+
+
+#endif /* LOG_RING_H_ */
@@ -0,0 +1,170 @@
+/**
+ * \brief Single-producer/single-consumer ring of ADC conversions (see sample_ring.h).
+ */
+
+#include "sample_ring.h"
+
+
+
+//****************************************************************************
+//
+// Internal macros
+//
+//****************************************************************************
+
+#if (SAMPLE_RING_SIZE & (SAMPLE_RING_SIZE - 1))
+#error "SAMPLE_RING_SIZE must be a power of two"
+#endif
+
+#define RING_INDEX(n)       ((n) & (SAMPLE_RING_SIZE - 1))
+
+/* Orders the record copy against the index update that publishes it */
+#if defined(__TI_COMPILER_VERSION__)
+#define RING_BARRIER()      __asm(" dmb")
+#elif defined(__GNUC__)
+#define RING_BARRIER()      __sync_synchronize()
+#endif
+
+
+
+//****************************************************************************
+//
+// Internal variables
+//
+//****************************************************************************
+
+static sample_record        ring[SAMPLE_RING_SIZE];
+
+// Free-running indices; head is written by the producer only, tail by the consumer only
+static volatile uint32_t    head = 0;
+static volatile uint32_t    tail = 0;
+
+// Statistics; written by the producer only
+static volatile uint32_t    pushed = 0;
+static volatile uint32_t    overflows = 0;
+static volatile uint32_t    highWater = 0;
+
+
+
+//*****************************************************************************
+//
+//! Empties the ring and clears its statistics.
+//!
+//! \fn void sampleRingReset(void)
+//!
+//! NOTE: Must not be called while the producer or consumer is running.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void sampleRingReset(void)
+{
+    head = 0;
+    tail = 0;
+    pushed = 0;
+    overflows = 0;
+    highWater = 0;
+}
+
+
+
+//*****************************************************************************
+//
+//! Appends a record to the ring. Producer side.
+//!
+//! \fn bool sampleRingPush(const sample_record *record)
+//!
+//! \param record pointer to the record to copy into the ring.
+//!
+//! \return true if the record was stored, false if the ring was full and the
+//! record was dropped.
+//
+//*****************************************************************************
+bool sampleRingPush(const sample_record *record)
+{
+    uint32_t h = head;
+    uint32_t fill = h - tail;
+
+    if (fill >= SAMPLE_RING_SIZE)
+    {
+        overflows++;
+        return false;
+    }
+
+    ring[RING_INDEX(h)] = *record;
+
+    // Publish the record only after it has been written
+    RING_BARRIER();
+    head = h + 1;
+
+    pushed++;
+    if (fill + 1 > highWater) { highWater = fill + 1; }
+
+    return true;
+}
+
+
+
+//*****************************************************************************
+//
+//! Removes the oldest record from the ring. Consumer side.
+//!
+//! \fn bool sampleRingPop(sample_record *record)
+//!
+//! \param record pointer to storage for the removed record.
+//!
+//! \return true if a record was removed, false if the ring was empty.
+//
+//*****************************************************************************
+bool sampleRingPop(sample_record *record)
+{
+    uint32_t t = tail;
+
+    if (head == t) { return false; }
+
+    // Read the record only after its publication has been observed
+    RING_BARRIER();
+    *record = ring[RING_INDEX(t)];
+
+    // Release the slot only after the record has been copied out
+    RING_BARRIER();
+    tail = t + 1;
+
+    return true;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the number of records waiting in the ring.
+//!
+//! \fn uint32_t sampleRingCount(void)
+//!
+//! \return Number of records.
+//
+//*****************************************************************************
+uint32_t sampleRingCount(void)
+{
+    return head - tail;
+}
+
+
+
+//*****************************************************************************
+//
+//! Copies the ring statistics.
+//!
+//! \fn void sampleRingGetStats(sample_ring_stats *stats)
+//!
+//! \param stats pointer to storage for the statistics.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void sampleRingGetStats(sample_ring_stats *stats)
+{
+    stats->pushed       = pushed;
+    stats->overflows    = overflows;
+    stats->highWater    = highWater;
+}
@@ -0,0 +1,68 @@
+/**
+ * \brief Single-producer/single-consumer ring of ADC conversions.
+ *
+ * The acquisition task pushes one record per conversion and the sender task
+ * pops them. Neither side blocks or disables interrupts: the producer only
+ * writes the head index and the consumer only writes the tail index, so both
+ * can run concurrently as long as there is exactly one of each.
+ *
+ * When the ring is full, new conversions are dropped and counted, so network
+ * stalls show up as overflow statistics instead of late SPI reads.
+ */
+
+#ifndef SAMPLE_RING_H_
+#define SAMPLE_RING_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ads131m0x.h"
+
+
+//****************************************************************************
+//
+// Constants
+//
+//****************************************************************************
+
+/* Number of records in the ring; must be a power of two */
+#define SAMPLE_RING_SIZE            (512U)
+
+
+
+//****************************************************************************
+//
+// Data structures
+//
+//****************************************************************************
+
+typedef struct
+{
+    uint64_t            timestamp;      // /DRDY time in getTimestamp() ticks
+    uint32_t            sequence;       // Conversion sequence number
+    adc_channel_data    data;           // Conversion result
+} sample_record;
+
+typedef struct
+{
+    uint32_t pushed;                    // Records accepted since reset
+    uint32_t overflows;                 // Records dropped because the ring was full
+    uint32_t highWater;                 // Largest fill level observed
+} sample_ring_stats;
+
+
+
+//****************************************************************************
+//
+// Function prototypes
+//
+//****************************************************************************
+
+void        sampleRingReset(void);
+bool        sampleRingPush(const sample_record *record);
+bool        sampleRingPop(sample_record *record);
+uint32_t    sampleRingCount(void);
+void        sampleRingGetStats(sample_ring_stats *stats);
+
+
+#endif /* SAMPLE_RING_H_ */
@@ -0,0 +1,104 @@
+/**
+ * \brief Priorities and stack sizes of the application tasks.
+ *
+ * The tasks are layered so that nothing on the network side can delay a
+ * conversion read:
+ *
+ *   ADC_TASK_PRIORITY          acquisition: reads each conversion after /DRDY
+ *                              and queues it in the sample ring; never blocks
+ *                              on anything but the DRDY semaphore.
+ *   SPAWN_TASK_PRIORITY        SimpleLink spawn task (set by the SDK's
+ *                              common.h): runs the Wi-Fi driver's callbacks.
+ *   WS_CLIENT_TASK_PRIORITY    one task per client slot: sends the frames
+ *                              queued for the client (see ws_clients.h), and
+ *                              blocks while the network is busy, letting the
+ *                              sender run.
+ *   SENDER_TASK_PRIORITY       processing: scales and packs the queued
+ *                              conversions and publishes them to the clients.
+ *   HTTP_SERVER_TASK_PRIORITY  HTTP and WebSocket server, client commands.
+ *   TCP_SERVER_TASK_PRIORITY   raw TCP stream server: accepts connections and
+ *                              hands them to the client tasks (see
+ *                              tcp_stream.h).
+ *   HOUSEKEEPING_TASK_PRIORITY deferred log output and stack usage reports.
+ *
+ * TI-RTOS runs the highest ready task, and Task.numPriorities in empty_min.cfg
+ * sets the number of priority levels.
+ *
+ * Each stack size is in bytes. The housekeeping task reports how much of each
+ * stack has been used.
+ */
+
+#ifndef TASK_CONFIG_H_
+#define TASK_CONFIG_H_
+
+
+//****************************************************************************
+//
+// Task priorities
+//
+//****************************************************************************
+
+#define ADC_TASK_PRIORITY           (12)
+#define WS_CLIENT_TASK_PRIORITY     (3)
+#define SENDER_TASK_PRIORITY        (2)
+#define HTTP_SERVER_TASK_PRIORITY   (1)
+#define TCP_SERVER_TASK_PRIORITY    (1)
+#define HOUSEKEEPING_TASK_PRIORITY  (1)
+
+/* Must match Task.numPriorities in empty_min.cfg */
+#define TASK_PRIORITY_LEVELS        (16)
+
+
+
+//****************************************************************************
+//
+// Task stack sizes
+//
+//****************************************************************************
+
+#define ADC_STACK_SIZE              (2048)
+#define WS_CLIENT_STACK_SIZE        (1024)
+#define SENDER_STACK_SIZE           (2048)
+#define HTTP_SERVER_STACK_SIZE      (2048)
+#define TCP_SERVER_STACK_SIZE       (1024)
+#define HOUSEKEEPING_STACK_SIZE     (1024)
+
+
+
+//****************************************************************************
+//
+// Housekeeping
+//
+//****************************************************************************
+
+/* Period of the housekeeping task, which prints the deferred log messages */
+#define HOUSEKEEPING_PERIOD_MS      (20)
+
+/* Time between two checks of the stack high-water marks. A check reports
+ * every stack whose mark went up since the last one */
+#define STACK_CHECK_INTERVAL_MS     (10000)
+
+
+
+//****************************************************************************
+//
+// Checks
+//
+//****************************************************************************
+
+#if (ADC_TASK_PRIORITY >= TASK_PRIORITY_LEVELS)
+#error "ADC_TASK_PRIORITY is above the highest task priority"
+#endif
+
+#if (ADC_TASK_PRIORITY <= WS_CLIENT_TASK_PRIORITY) || (ADC_TASK_PRIORITY <= SENDER_TASK_PRIORITY) || (ADC_TASK_PRIORITY <= HTTP_SERVER_TASK_PRIORITY) || \
+    (ADC_TASK_PRIORITY <= TCP_SERVER_TASK_PRIORITY) || (ADC_TASK_PRIORITY <= HOUSEKEEPING_TASK_PRIORITY)
+#error "The acquisition task must have the highest priority"
+#endif
+
+/* Only when included after the SDK's common.h */
+#if defined(SPAWN_TASK_PRIORITY) && (ADC_TASK_PRIORITY <= SPAWN_TASK_PRIORITY)
+#error "The acquisition task must preempt the SimpleLink spawn task"
+#endif
+
+
+#endif /* TASK_CONFIG_H_ */
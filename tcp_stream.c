@@ -0,0 +1,254 @@
+/**
+ * \brief Raw TCP stream server (see tcp_stream.h).
+ */
+
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/knl/Task.h>
+#include <ti/sysbios/knl/Semaphore.h>
+
+#include "simplelink.h"
+#include "common.h"
+
+#include "log_ring.h"
+#include "tcp_stream.h"
+#include "ws_clients.h"
+
+
+
+//****************************************************************************
+//
+// Internal variables
+//
+//****************************************************************************
+
+// Options of the client tasks' send buffers (see tcpStreamSetOptions())
+static volatile uint16_t    sendBytesSetting    = TCP_STREAM_DEFAULT_SEND_BYTES;
+static volatile bool        noDelaySetting      = TCP_STREAM_DEFAULT_NODELAY;
+
+extern volatile unsigned long   g_ulStatus;     /* SimpleLink Status */
+extern Semaphore_Handle         httpServerInitCompleteSemaphore;
+
+
+
+//****************************************************************************
+//
+// Internal function prototypes
+//
+//****************************************************************************
+
+static int16_t  openServer(void);
+
+
+
+//*****************************************************************************
+//
+//! Sets how the client tasks hand the stream to the TCP connections.
+//!
+//! \fn void tcpStreamSetOptions(uint16_t sendBytes, bool noDelay)
+//!
+//! \param sendBytes bytes collected before each sl_Send(), clamped to 1 to
+//! TCP_STREAM_MAX_SEND_BYTES; a packet larger than that is sent on its own.
+//! \param noDelay true to send a partial buffer as soon as the client has no
+//! more packets queued, false to wait up to TCP_STREAM_COALESCE_MS for more.
+//!
+//! Takes effect with the next packet.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void tcpStreamSetOptions(uint16_t sendBytes, bool noDelay)
+{
+    if (sendBytes < 1)                          { sendBytes = 1; }
+    if (sendBytes > TCP_STREAM_MAX_SEND_BYTES)  { sendBytes = TCP_STREAM_MAX_SEND_BYTES; }
+
+    sendBytesSetting = sendBytes;
+    noDelaySetting = noDelay;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the number of bytes collected before each sl_Send().
+//!
+//! \fn uint16_t tcpStreamGetSendBytes(void)
+//!
+//! \return Bytes per send.
+//
+//*****************************************************************************
+uint16_t tcpStreamGetSendBytes(void)
+{
+    return sendBytesSetting;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns whether partial buffers are sent without waiting for more packets.
+//!
+//! \fn bool tcpStreamGetNoDelay(void)
+//!
+//! \return true if coalescing is off.
+//
+//*****************************************************************************
+bool tcpStreamGetNoDelay(void)
+{
+    return noDelaySetting;
+}
+
+
+
+//*****************************************************************************
+//
+//! Writes data to a TCP connection.
+//!
+//! \fn bool tcpStreamSend(int16_t socket, const uint8_t *data, uint16_t length)
+//!
+//! \param socket connected socket.
+//! \param data bytes to write.
+//! \param length number of bytes.
+//!
+//! Blocks until the network processor has taken every byte.
+//!
+//! \return true if all the data was written, false if the connection failed.
+//
+//*****************************************************************************
+bool tcpStreamSend(int16_t socket, const uint8_t *data, uint16_t length)
+{
+    int16_t sent;
+
+    while (length > 0)
+    {
+        sent = sl_Send(socket, data, (int16_t) length, 0);
+        if (sent <= 0) { return false; }
+
+        data += sent;
+        length -= (uint16_t) sent;
+    }
+    return true;
+}
+
+
+
+//*****************************************************************************
+//
+//! Closes a TCP connection.
+//!
+//! \fn void tcpStreamClose(int16_t socket)
+//!
+//! \param socket connected socket.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void tcpStreamClose(int16_t socket)
+{
+    sl_Close(socket);
+}
+
+
+
+//****************************************************************************
+//
+//! Executes the TCP server task, which accepts the stream connections.
+//!
+//! \param a0 Not used in the current implementation.
+//! \param a1 Not used in the current implementation.
+//!
+//! The task waits for the device to join a network, listens on
+//! TCP_STREAM_PORT and hands each connection to a free client slot (see
+//! wsClientOpenTcp()). Connections beyond WS_MAX_TCP_CLIENTS are closed at
+//! once.
+//!
+//! \return None. (Function does not exit unless externally terminated.)
+//
+//****************************************************************************
+Void tcpServerTask(UArg a0, UArg a1)
+{
+    SlSockAddrIn_t address;
+    SlSocklen_t addressLength;
+    SlSockKeepalive_t keepAlive;
+    int16_t server;
+    int16_t client;
+
+    // Sockets can only be opened once the device has an IP address
+    while (!IS_CONNECTED(g_ulStatus) || !IS_IP_ACQUIRED(g_ulStatus))
+    {
+        Task_sleep(TCP_STREAM_RETRY_MS);
+    }
+
+    while ((server = openServer()) < 0)
+    {
+        LOG_PRINT("Error: Cannot listen on TCP port %u (%d)\r\n", TCP_STREAM_PORT, server);
+        Task_sleep(TCP_STREAM_RETRY_MS);
+    }
+    LOG_PRINT("TCP stream on port %u\r\n", TCP_STREAM_PORT);
+
+    while (1)
+    {
+        addressLength = sizeof(address);
+        client = sl_Accept(server, (SlSockAddr_t *) &address, &addressLength);
+        if (client < 0)
+        {
+            LOG_PRINT("Error: TCP accept failed (%d)\r\n", client);
+            Task_sleep(TCP_STREAM_RETRY_MS);
+            continue;
+        }
+
+        // Detect peers that went away without closing, so their slot is freed
+        keepAlive.KeepaliveEnabled = 1;
+        sl_SetSockOpt(client, SL_SOL_SOCKET, SL_SO_KEEPALIVE, &keepAlive, sizeof(keepAlive));
+
+        if (!wsClientOpenTcp(client))
+        {
+            sl_Close(client);
+            continue;
+        }
+
+        // Starts the acquisition, as the first websocket message does
+        Semaphore_post(httpServerInitCompleteSemaphore);
+    }
+}
+
+
+
+//****************************************************************************
+//
+// Internal functions
+//
+//****************************************************************************
+
+
+//*****************************************************************************
+//
+//! Opens the listening socket.
+//!
+//! \return The socket, or a negative SimpleLink error code.
+//
+//*****************************************************************************
+static int16_t openServer(void)
+{
+    SlSockAddrIn_t address;
+    int16_t server;
+    int16_t status;
+
+    server = sl_Socket(SL_AF_INET, SL_SOCK_STREAM, SL_IPPROTO_TCP);
+    if (server < 0) { return server; }
+
+    address.sin_family = SL_AF_INET;
+    address.sin_port = sl_Htons(TCP_STREAM_PORT);
+    address.sin_addr.s_addr = SL_INADDR_ANY;
+
+    status = sl_Bind(server, (SlSockAddr_t *) &address, sizeof(address));
+    if (status >= 0)
+    {
+        status = sl_Listen(server, TCP_STREAM_BACKLOG);
+    }
+    if (status < 0)
+    {
+        sl_Close(server);
+        return status;
+    }
+    return server;
+}
@@ -0,0 +1,94 @@
+/**
+ * \brief Raw TCP server streaming the binary sample format (see adc_stream.h)
+ * without the WebSocket framing of the HTTP server library.
+ *
+ * tcpServerTask() listens on TCP_STREAM_PORT with the SimpleLink socket API
+ * once the device has an IP address, and adds every connection it accepts to
+ * the client table (see wsClientOpenTcp()), subscribed to data only. The
+ * client task of the slot then writes the packets to the socket back to
+ * back: the stream is the concatenation of the packets, and a reader finds
+ * the end of each packet from its header (see streamPacketBytes()). With
+ * STREAM_TEXT_FORMAT, each CSV line is followed by '\n' instead.
+ *
+ * SimpleLink sockets have no send buffer size or Nagle option, so both are
+ * done by the client task: it copies consecutive packets into a buffer and
+ * hands the buffer to sl_Send() once it holds the configured number of bytes
+ * (see tcpStreamSetOptions()). Without delay, a partial buffer is sent as soon
+ * as the client's queue is empty; with delay, it waits up to
+ * TCP_STREAM_COALESCE_MS for more packets, like Nagle's algorithm does.
+ *
+ * TCP clients do not send commands; use a websocket client to configure the
+ * stream. The first connection starts the acquisition like the first
+ * websocket message does.
+ */
+
+#ifndef TCP_STREAM_H_
+#define TCP_STREAM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <xdc/std.h>
+
+#include "adc_stream.h"
+
+
+//****************************************************************************
+//
+// Constants
+//
+//****************************************************************************
+
+/* Port the server listens on */
+#define TCP_STREAM_PORT                 (5001)
+
+/* Connections waiting to be accepted */
+#define TCP_STREAM_BACKLOG              (1)
+
+/* Bytes handed to sl_Send() at once: default (one TCP segment on Ethernet)
+ * and maximum, which must be above STREAM_MAX_PACKET_BYTES to hold a packet
+ * or a text line and its terminator */
+#define TCP_STREAM_DEFAULT_SEND_BYTES   ((uint16_t) 1460)
+#define TCP_STREAM_MAX_SEND_BYTES       (2048U)
+
+/* Longest time a partial buffer waits for more packets when delay is on */
+#define TCP_STREAM_COALESCE_MS          (20)
+
+/* Send partial buffers at once (true) or coalesce them (false) by default */
+#define TCP_STREAM_DEFAULT_NODELAY      (true)
+
+/* Time between two attempts to open the listening socket */
+#define TCP_STREAM_RETRY_MS             (1000)
+
+
+
+//****************************************************************************
+//
+// Checks
+//
+//****************************************************************************
+
+// bufferTcpFrame() in ws_clients.c copies every packet into one send buffer
+#if (TCP_STREAM_MAX_SEND_BYTES <= STREAM_MAX_PACKET_BYTES)
+#error "TCP_STREAM_MAX_SEND_BYTES must be above STREAM_MAX_PACKET_BYTES"
+#endif
+
+
+
+//****************************************************************************
+//
+// Function prototypes
+//
+//****************************************************************************
+
+void        tcpStreamSetOptions(uint16_t sendBytes, bool noDelay);
+uint16_t    tcpStreamGetSendBytes(void);
+bool        tcpStreamGetNoDelay(void);
+
+bool        tcpStreamSend(int16_t socket, const uint8_t *data, uint16_t length);
+void        tcpStreamClose(int16_t socket);
+
+Void        tcpServerTask(UArg a0, UArg a1);
+
+
+#endif /* TCP_STREAM_H_ */
@@ -0,0 +1,124 @@
+/**
+ * \brief UDP streaming to a unicast or multicast destination (see
+ * udp_stream.h).
+ */
+
+#include <ti/sysbios/knl/Task.h>
+
+#include "simplelink.h"
+
+#include "log_ring.h"
+#include "udp_stream.h"
+#include "ws_clients.h"
+
+
+
+//****************************************************************************
+//
+// Internal variables
+//
+//****************************************************************************
+
+// Opened by the first udpStreamStart() and kept for the next ones
+static int16_t          udpSocket = -1;
+
+// Destination of the datagrams; read by the client task
+static SlSockAddrIn_t   destination;
+
+// Whether the socket holds a client slot
+static bool             streaming = false;
+
+
+
+//*****************************************************************************
+//
+//! Starts sending the stream to a destination, or moves it to another one.
+//!
+//! \fn bool udpStreamStart(uint32_t address, uint16_t port)
+//!
+//! \param address IPv4 address in host byte order, unicast or multicast
+//! (224.0.0.0 to 239.255.255.255).
+//! \param port UDP port.
+//!
+//! \return true if the stream is being sent, false if no socket or client
+//! slot was available.
+//
+//*****************************************************************************
+bool udpStreamStart(uint32_t address, uint16_t port)
+{
+    UInt key;
+
+    if (udpSocket < 0)
+    {
+        udpSocket = sl_Socket(SL_AF_INET, SL_SOCK_DGRAM, SL_IPPROTO_UDP);
+        if (udpSocket < 0)
+        {
+            LOG_PRINT("Error: Cannot open the UDP socket (%d)\r\n", udpSocket);
+            return false;
+        }
+    }
+
+    // The client task sends at a higher priority, so it never sees half an update
+    key = Task_disable();
+    destination.sin_family = SL_AF_INET;
+    destination.sin_port = sl_Htons(port);
+    destination.sin_addr.s_addr = sl_Htonl(address);
+    Task_restore(key);
+
+    if (!streaming)
+    {
+        streaming = wsClientOpenUdp(udpSocket);
+    }
+    if (streaming)
+    {
+        LOG_PRINT("UDP stream to %u.%u.%u.%u", (address >> 24) & 0xFF, (address >> 16) & 0xFF,
+                  (address >> 8) & 0xFF, address & 0xFF);
+        LOG_PRINT(" port %u\r\n", port);
+    }
+    return streaming;
+}
+
+
+
+//*****************************************************************************
+//
+//! Stops sending the stream over UDP.
+//!
+//! \fn void udpStreamStop(void)
+//!
+//! The socket stays open for the next udpStreamStart().
+//!
+//! \return None.
+//
+//*****************************************************************************
+void udpStreamStop(void)
+{
+    if (!streaming) { return; }
+
+    wsClientCloseUdp(udpSocket);
+    streaming = false;
+    LOG_PRINT("UDP stream stopped\r\n");
+}
+
+
+
+//*****************************************************************************
+//
+//! Sends one datagram to the current destination. Client task side.
+//!
+//! \fn bool udpStreamSend(int16_t socket, const uint8_t *data, uint16_t length)
+//!
+//! \param socket socket from udpStreamStart().
+//! \param data datagram payload: one packet or text line.
+//! \param length number of bytes, at most UDP_STREAM_MAX_DATAGRAM_BYTES.
+//!
+//! \return true if the network processor took the datagram.
+//
+//*****************************************************************************
+bool udpStreamSend(int16_t socket, const uint8_t *data, uint16_t length)
+{
+    int16_t sent = sl_SendTo(socket, data, (int16_t) length, 0, (SlSockAddr_t *) &destination,
+                             sizeof(destination));
+
+    return (sent == (int16_t) length);
+}
@@ -0,0 +1,70 @@
+/**
+ * \brief UDP streaming of the binary sample format (see adc_stream.h) to a
+ * unicast or multicast destination.
+ *
+ * Each packet is sent as one datagram, so datagrams are self-describing:
+ * the header carries the format version, channel mask, sequence number,
+ * timestamps, link mode and decimation. A receiver detects lost and
+ * reordered datagrams from the sequence numbers, and nothing is ever
+ * retransmitted: a datagram lost over Wi-Fi delays none of the later ones.
+ * STREAM_MAX_PACKET_BYTES keeps every datagram within one 802.11 frame
+ * (UDP_STREAM_MAX_DATAGRAM_BYTES). With STREAM_TEXT_FORMAT, each CSV line
+ * is one datagram instead.
+ *
+ * udpStreamStart() takes a client slot (see wsClientOpenUdp()) subscribed to
+ * data; the slot's client task sends the datagrams with sl_SendTo(). The
+ * destination can be changed while streaming. A failed send loses that
+ * datagram only.
+ */
+
+#ifndef UDP_STREAM_H_
+#define UDP_STREAM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "adc_stream.h"
+
+
+//****************************************************************************
+//
+// Constants
+//
+//****************************************************************************
+
+/* Port used when the "udp" command gives none */
+#define UDP_STREAM_DEFAULT_PORT         ((uint16_t) 5002)
+
+/* Largest datagram that fits in one frame: the 1500-byte 802.11 and
+ * Ethernet MTU less the IPv4 and UDP headers. STREAM_MAX_PACKET_BYTES must
+ * not exceed it */
+#define UDP_STREAM_MAX_DATAGRAM_BYTES   (1472U)
+
+
+
+//****************************************************************************
+//
+// Checks
+//
+//****************************************************************************
+
+// Each packet is sent as one datagram, which must not be fragmented
+#if (STREAM_MAX_PACKET_BYTES > UDP_STREAM_MAX_DATAGRAM_BYTES)
+#error "STREAM_MAX_PACKET_BYTES must not exceed UDP_STREAM_MAX_DATAGRAM_BYTES"
+#endif
+
+
+
+//****************************************************************************
+//
+// Function prototypes
+//
+//****************************************************************************
+
+bool        udpStreamStart(uint32_t address, uint16_t port);
+void        udpStreamStop(void);
+
+bool        udpStreamSend(int16_t socket, const uint8_t *data, uint16_t length);
+
+
+#endif /* UDP_STREAM_H_ */
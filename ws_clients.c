@@ -0,0 +1,938 @@
+/**
+ * \brief Websocket client table and frame fan-out (see ws_clients.h).
+ */
+
+#include <string.h>
+
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/knl/Task.h>
+#include <ti/sysbios/knl/Semaphore.h>
+#include <ti/sysbios/knl/Clock.h>
+
+#include "simplelink.h"
+#include "HttpCore.h"
+#include "WebSockHandler.h"
+
+#include "hal.h"
+#include "log_ring.h"
+#include "tcp_stream.h"
+#include "udp_stream.h"
+#include "ws_clients.h"
+
+
+
+//****************************************************************************
+//
+// Internal macros
+//
+//****************************************************************************
+
+#if (WS_CLIENT_QUEUE_DEPTH & (WS_CLIENT_QUEUE_DEPTH - 1))
+#error "WS_CLIENT_QUEUE_DEPTH must be a power of two"
+#endif
+
+#define QUEUE_INDEX(n)      ((n) & (WS_CLIENT_QUEUE_DEPTH - 1))
+
+/* Orders the queue entry against the index update that publishes it */
+#if defined(__TI_COMPILER_VERSION__)
+#define QUEUE_BARRIER()     __asm(" dmb")
+#elif defined(__GNUC__)
+#define QUEUE_BARRIER()     __sync_synchronize()
+#endif
+
+#define WS_CLIENT_FREE      ((uint8_t) 0)
+#define WS_CLIENT_ACTIVE    ((uint8_t) 1)
+#define WS_CLIENT_CLOSING   ((uint8_t) 2)     // Released by its client task (see closeClient())
+
+/* Longest time addClient() waits for a closing slot to be released */
+#define WS_CLIENT_RELEASE_WAIT_MS   (100U)
+
+/* Transports, numbered in the order of their slots in clients[] */
+#define WS_TRANSPORT_WEBSOCKET  ((uint8_t) 0)
+#define WS_TRANSPORT_TCP        ((uint8_t) 1)
+#define WS_TRANSPORT_UDP        ((uint8_t) 2)
+#define WS_TRANSPORT_COUNT      (3U)
+
+
+
+//****************************************************************************
+//
+// Internal data structures
+//
+//****************************************************************************
+
+typedef struct
+{
+    volatile uint8_t    state;          // WS_CLIENT_FREE, WS_CLIENT_ACTIVE or WS_CLIENT_CLOSING
+    volatile uint8_t    subscription;   // WS_SUBSCRIBE_* bits
+    uint8_t             transport;      // WS_TRANSPORT_*, fixed for the slot
+    uint16_t            connection;     // HTTP server connection id, or socket of a TCP or UDP client
+
+    // Free-running indices; head is written by the publisher only, tail by the client task only
+    ws_frame           *queue[WS_CLIENT_QUEUE_DEPTH];
+    volatile uint32_t   head;
+    volatile uint32_t   tail;
+
+    Semaphore_Struct    frameReadySemStruct;
+    Semaphore_Handle    frameReady;     // Posted by the publisher after each frame queued
+
+    // Statistics of the current connection
+    uint32_t            sentFrames;     // Written by the client task
+    uint32_t            droppedFrames;  // Frames published while the queue was full; publisher
+    uint32_t            failedFrames;   // Frames whose send failed; client task
+    uint32_t            busyCycles;     // CPU cycles spent in sends of data frames; client task
+    uint16_t            failures;       // Consecutive failed sends; client task
+
+    // Totals at the previous wsClientsGetLinkStats() call
+    uint32_t            lastBusyCycles;
+    uint32_t            lastLostFrames;
+
+    // Frames copied for the next sl_Send() of a TCP client; client task
+    uint8_t            *tcpBuffer;      // TCP_STREAM_MAX_SEND_BYTES, in TCP slots only
+    uint16_t            tcpLength;
+    uint16_t            tcpFrames;
+    uint32_t            tcpConversions;
+    uint32_t            tcpStartTime;   // Clock ticks when the first frame was copied
+} ws_client;
+
+
+
+//****************************************************************************
+//
+// Internal variables
+//
+//****************************************************************************
+
+static ws_client    clients[WS_MAX_CLIENTS];
+static ws_frame     pool[WS_FRAME_POOL_SIZE];
+static uint8_t      tcpBuffers[WS_MAX_TCP_CLIENTS][TCP_STREAM_MAX_SEND_BYTES];
+
+// First slot of each transport in clients[], and the end of the table
+static const uint16_t firstSlot[WS_TRANSPORT_COUNT + 1] = {
+    0,
+    WS_MAX_WEBSOCKET_CLIENTS,
+    WS_MAX_WEBSOCKET_CLIENTS + WS_MAX_TCP_CLIENTS,
+    WS_MAX_CLIENTS
+};
+
+
+
+//****************************************************************************
+//
+// Internal function prototypes
+//
+//****************************************************************************
+
+static ws_client   *findClient(uint16_t connection);
+static ws_client   *addClient(uint8_t transport, uint16_t connection, uint8_t subscription);
+static void         removeClient(uint8_t transport, uint16_t connection);
+static void         closeClient(ws_client *client);
+static void         sendFrame(ws_client *client, ws_frame *frame);
+static void         bufferTcpFrame(ws_client *client, ws_frame *frame);
+static void         sendTcpBuffer(ws_client *client);
+static void         sendDatagram(ws_client *client, ws_frame *frame);
+static void         releaseFrame(ws_frame *frame);
+static void         countUndelivered(uint32_t conversions);
+
+
+
+//*****************************************************************************
+//
+//! Empties the client table and creates the semaphores of the client tasks.
+//!
+//! \fn void wsClientsInit(void)
+//!
+//! NOTE: Call before the client tasks and the publisher start.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void wsClientsInit(void)
+{
+    Semaphore_Params semParams;
+    uint8_t transport;
+    uint16_t n;
+
+    Semaphore_Params_init(&semParams);
+    semParams.mode = Semaphore_Mode_BINARY;
+
+    for (transport = 0; transport < WS_TRANSPORT_COUNT; transport++)
+    {
+        for (n = firstSlot[transport]; n < firstSlot[transport + 1]; n++)
+        {
+            clients[n].transport = transport;
+            clients[n].tcpBuffer = (transport == WS_TRANSPORT_TCP) ? tcpBuffers[n - firstSlot[transport]] : NULL;
+        }
+    }
+
+    for (n = 0; n < WS_MAX_CLIENTS; n++)
+    {
+        clients[n].state = WS_CLIENT_FREE;
+        clients[n].head = 0;
+        clients[n].tail = 0;
+        Semaphore_construct(&clients[n].frameReadySemStruct, 0, &semParams);
+        clients[n].frameReady = Semaphore_handle(&clients[n].frameReadySemStruct);
+    }
+
+    for (n = 0; n < WS_FRAME_POOL_SIZE; n++)
+    {
+        pool[n].references = 0;
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Adds a client once its websocket handshake has completed.
+//!
+//! \fn void wsClientOpen(uint16_t connection)
+//!
+//! \param connection HTTP server connection id of the client.
+//!
+//! The client subscribes to everything. A connection id that is already in
+//! the table belongs to a closed connection whose slot the server reused, so
+//! that entry is removed first.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void wsClientOpen(uint16_t connection)
+{
+    removeClient(WS_TRANSPORT_WEBSOCKET, connection);
+
+    if (addClient(WS_TRANSPORT_WEBSOCKET, connection, WS_SUBSCRIBE_ALL) == NULL)
+    {
+        LOG_PRINT("Websocket client %u not served: %u websocket clients already connected\r\n",
+                  connection, WS_MAX_WEBSOCKET_CLIENTS);
+        return;
+    }
+
+    LOG_PRINT("Websocket client %u connected\r\n", connection);
+}
+
+
+
+//*****************************************************************************
+//
+//! Adds a raw TCP client once its connection has been accepted.
+//!
+//! \fn bool wsClientOpenTcp(int16_t socket)
+//!
+//! \param socket connected socket; closed by the client task when a send
+//! fails.
+//!
+//! The client subscribes to data only.
+//!
+//! \return true if the client was added, false if every TCP slot is taken;
+//! the caller then closes the socket.
+//
+//*****************************************************************************
+bool wsClientOpenTcp(int16_t socket)
+{
+    if (addClient(WS_TRANSPORT_TCP, (uint16_t) socket, WS_SUBSCRIBE_DATA) == NULL)
+    {
+        LOG_PRINT("TCP client %u not served: %u TCP clients already connected\r\n",
+                  socket, WS_MAX_TCP_CLIENTS);
+        return false;
+    }
+
+    LOG_PRINT("TCP client %u connected\r\n", socket);
+    return true;
+}
+
+
+
+//*****************************************************************************
+//
+//! Adds the UDP stream as a client.
+//!
+//! \fn bool wsClientOpenUdp(int16_t socket)
+//!
+//! \param socket datagram socket; the client task sends to it with
+//! udpStreamSend().
+//!
+//! The client subscribes to data only.
+//!
+//! \return true if the client was added, false if every UDP slot is taken.
+//
+//*****************************************************************************
+bool wsClientOpenUdp(int16_t socket)
+{
+    if (addClient(WS_TRANSPORT_UDP, (uint16_t) socket, WS_SUBSCRIBE_DATA) == NULL)
+    {
+        LOG_PRINT("UDP stream not served: %u UDP clients already connected\r\n", WS_MAX_UDP_CLIENTS);
+        return false;
+    }
+    return true;
+}
+
+
+
+//*****************************************************************************
+//
+//! Removes the UDP stream from the client table.
+//!
+//! \fn void wsClientCloseUdp(int16_t socket)
+//!
+//! \param socket socket given to wsClientOpenUdp(); it stays open.
+//!
+//! No frame is queued for the client from here on. Its client task releases
+//! the frames still queued without sending them, and then the slot.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void wsClientCloseUdp(int16_t socket)
+{
+    removeClient(WS_TRANSPORT_UDP, (uint16_t) socket);
+}
+
+
+
+//*****************************************************************************
+//
+//! Sets the kinds of frames a client receives.
+//!
+//! \fn bool wsClientSubscribe(uint16_t connection, uint8_t subscription)
+//!
+//! \param connection HTTP server connection id of the client.
+//! \param subscription WS_SUBSCRIBE_* bits.
+//!
+//! \return true if the client is in the table.
+//
+//*****************************************************************************
+bool wsClientSubscribe(uint16_t connection, uint8_t subscription)
+{
+    ws_client *client = findClient(connection);
+
+    if (client == NULL) { return false; }
+
+    client->subscription = subscription;
+    return true;
+}
+
+
+
+//*****************************************************************************
+//
+//! Returns the number of clients in the table.
+//!
+//! \fn uint16_t wsClientCount(void)
+//!
+//! \return Connected clients.
+//
+//*****************************************************************************
+uint16_t wsClientCount(void)
+{
+    uint16_t count = 0;
+    uint16_t n;
+
+    for (n = 0; n < WS_MAX_CLIENTS; n++)
+    {
+        if (clients[n].state == WS_CLIENT_ACTIVE) { count++; }
+    }
+    return count;
+}
+
+
+
+//*****************************************************************************
+//
+//! Takes an empty frame from the pool. Publisher side.
+//!
+//! \fn ws_frame *wsFrameAcquire(uint8_t opcode)
+//!
+//! \param opcode STREAM_WS_OPCODE_BINARY or STREAM_WS_OPCODE_TEXT.
+//!
+//! The frame is held by the caller until it is passed to wsFramePublish().
+//! Its batch is reset, so binary frames can be filled with streamBatchAdd();
+//! text frames are written to batch.buffer and batch.length directly.
+//!
+//! NOTE: Call from a single task only. The pool is sized so that it cannot
+//! run out while the caller holds at most two frames.
+//!
+//! \return The frame, or NULL if the pool is empty.
+//
+//*****************************************************************************
+ws_frame *wsFrameAcquire(uint8_t opcode)
+{
+    uint16_t n;
+
+    // A frame without references is not used by any client task
+    for (n = 0; n < WS_FRAME_POOL_SIZE; n++)
+    {
+        if (pool[n].references == 0)
+        {
+            pool[n].references = 1;
+            pool[n].opcode = opcode;
+            streamBatchReset(&pool[n].batch);
+            return &pool[n];
+        }
+    }
+    return NULL;
+}
+
+
+
+//*****************************************************************************
+//
+//! Queues a frame for every client subscribed to it and gives up the
+//! caller's reference. Publisher side.
+//!
+//! \fn void wsFramePublish(ws_frame *frame, uint8_t subscription)
+//!
+//! \param frame frame from wsFrameAcquire(); must not be used afterwards.
+//! \param subscription kind of frame, one WS_SUBSCRIBE_* bit.
+//!
+//! A client whose queue is full does not get the frame, and the conversions
+//! in it count as send failures.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void wsFramePublish(ws_frame *frame, uint8_t subscription)
+{
+    ws_client *client;
+    UInt key;
+    uint16_t n;
+
+    for (n = 0; n < WS_MAX_CLIENTS; n++)
+    {
+        client = &clients[n];
+
+        // No task may mark the client closing between the check and the queueing
+        key = Task_disable();
+        if ((client->state != WS_CLIENT_ACTIVE) || !(client->subscription & subscription))
+        {
+            Task_restore(key);
+            continue;
+        }
+
+        if ((client->head - client->tail) >= WS_CLIENT_QUEUE_DEPTH)
+        {
+            Task_restore(key);
+            client->droppedFrames++;
+            countUndelivered(frame->batch.conversions);
+            continue;
+        }
+
+        frame->references++;
+        client->queue[QUEUE_INDEX(client->head)] = frame;
+        QUEUE_BARRIER();
+        client->head++;
+        Task_restore(key);
+
+        Semaphore_post(client->frameReady);
+    }
+
+    releaseFrame(frame);
+}
+
+
+
+//*****************************************************************************
+//
+//! Publishes a line of text as one text frame. Publisher side.
+//!
+//! \fn bool wsFramePublishText(const char *text, uint8_t subscription)
+//!
+//! \param text null-terminated line, truncated to STREAM_MAX_PACKET_BYTES.
+//! \param subscription kind of frame, one WS_SUBSCRIBE_* bit.
+//!
+//! \return true if the line was published, false if no frame was free.
+//
+//*****************************************************************************
+bool wsFramePublishText(const char *text, uint8_t subscription)
+{
+    ws_frame *frame = wsFrameAcquire(STREAM_WS_OPCODE_TEXT);
+    size_t length = strlen(text);
+
+    if (frame == NULL) { return false; }
+
+    if (length > sizeof(frame->batch.buffer)) { length = sizeof(frame->batch.buffer); }
+    memcpy(frame->batch.buffer, text, length);
+    frame->batch.length = (uint16_t) length;
+
+    wsFramePublish(frame, subscription);
+    return true;
+}
+
+
+
+//*****************************************************************************
+//
+//! Measures how well the clients subscribed to data keep up with the stream
+//! since the previous call. Publisher side.
+//!
+//! \fn void wsClientsGetLinkStats(stream_link_stats *link)
+//!
+//! \param link receives busy_us, the time the busiest client spent sending
+//! data frames, and lostFrames, the data frames dropped or not sent over all
+//! clients; interval_us is left to the caller.
+//!
+//! NOTE: Call from a single task only, at regular intervals.
+//!
+//! \return None.
+//
+//*****************************************************************************
+void wsClientsGetLinkStats(stream_link_stats *link)
+{
+    ws_client *client;
+    uint32_t busyCycles;
+    uint32_t lostFrames;
+    uint16_t n;
+
+    link->busy_us = 0;
+    link->lostFrames = 0;
+
+    for (n = 0; n < WS_MAX_CLIENTS; n++)
+    {
+        client = &clients[n];
+
+        // Snapshots of counters written by the client task; each is read once
+        busyCycles = client->busyCycles;
+        lostFrames = client->droppedFrames + client->failedFrames;
+
+        if ((client->state == WS_CLIENT_ACTIVE) && (client->subscription & WS_SUBSCRIBE_DATA))
+        {
+            uint32_t busy_us = (busyCycles - client->lastBusyCycles) / (CPU_CLOCK_HZ / 1000000U);
+
+            if (busy_us > link->busy_us) { link->busy_us = busy_us; }
+            link->lostFrames += lostFrames - client->lastLostFrames;
+        }
+
+        client->lastBusyCycles = busyCycles;
+        client->lastLostFrames = lostFrames;
+    }
+}
+
+
+
+//****************************************************************************
+//
+//! Executes a client task, which sends the frames queued for one client slot.
+//!
+//! \param a0 index of the client slot, below WS_MAX_CLIENTS.
+//! \param a1 Not used in the current implementation.
+//!
+//! The task is the only one that releases its slot (see closeClient()), so
+//! a new connection never gets the frames or the TCP buffer of the old one.
+//! Each frame for a UDP client is one datagram. Frames for a TCP
+//! client are collected and sent in buffers of tcpStreamGetSendBytes()
+//! bytes; a partial buffer is sent once the queue is empty, or after
+//! TCP_STREAM_COALESCE_MS with delay on.
+//!
+//! \return None. (Function does not exit unless externally terminated.)
+//
+//****************************************************************************
+Void wsClientTask(UArg a0, UArg a1)
+{
+    ws_client *client = &clients[a0];
+    ws_frame *frame;
+    UInt timeout;
+
+    while (1)
+    {
+        // Clock ticks are 1 ms (Clock.tickPeriod in empty_min.cfg)
+        timeout = (client->tcpLength > 0) ? TCP_STREAM_COALESCE_MS : BIOS_WAIT_FOREVER;
+        Semaphore_pend(client->frameReady, timeout);
+
+        while (client->tail != client->head)
+        {
+            // Read the entry only after its index update has been observed
+            QUEUE_BARRIER();
+            frame = client->queue[QUEUE_INDEX(client->tail)];
+            client->tail++;
+
+            if (client->state == WS_CLIENT_ACTIVE)
+            {
+                sendFrame(client, frame);
+            }
+            else
+            {
+                countUndelivered(frame->batch.conversions);
+            }
+            releaseFrame(frame);
+        }
+
+        if ((client->state == WS_CLIENT_ACTIVE) && (client->tcpLength > 0) &&
+            (tcpStreamGetNoDelay() || ((Clock_getTicks() - client->tcpStartTime) >= TCP_STREAM_COALESCE_MS)))
+        {
+            sendTcpBuffer(client);
+        }
+
+        // Removed by another task, or after a failed send
+        if (client->state == WS_CLIENT_CLOSING)
+        {
+            closeClient(client);
+        }
+    }
+}
+
+
+
+//****************************************************************************
+//
+// Internal functions
+//
+//****************************************************************************
+
+
+//*****************************************************************************
+//
+//! Returns the table entry of a connected client.
+//!
+//! \return The entry, or NULL if the connection is not in the table.
+//
+//*****************************************************************************
+static ws_client *findClient(uint16_t connection)
+{
+    uint16_t n;
+
+    for (n = 0; n < WS_MAX_CLIENTS; n++)
+    {
+        if ((clients[n].state == WS_CLIENT_ACTIVE) && (clients[n].transport == WS_TRANSPORT_WEBSOCKET) &&
+            (clients[n].connection == connection))
+        {
+            return &clients[n];
+        }
+    }
+    return NULL;
+}
+
+
+
+//*****************************************************************************
+//
+//! Takes a free slot of a transport and resets it for a new connection. If
+//! no slot of the transport is free but one is closing, waits up to WS_CLIENT_RELEASE_WAIT_MS for its client
+//! task to release it.
+//!
+//! NOTE: Call from a task below WS_CLIENT_TASK_PRIORITY.
+//!
+//! \return The entry, or NULL if every slot is taken.
+//
+//*****************************************************************************
+static ws_client *addClient(uint8_t transport, uint16_t connection, uint8_t subscription)
+{
+    ws_client *client;
+    uint32_t waited_ms;
+    bool closing;
+    UInt key;
+    uint16_t n;
+
+    for (waited_ms = 0; ; waited_ms++)
+    {
+        closing = false;
+
+        // Taken with task switching off, as the HTTP and TCP server tasks both add clients
+        key = Task_disable();
+        for (n = firstSlot[transport]; n < firstSlot[transport + 1]; n++)
+        {
+            client = &clients[n];
+            closing |= (client->state == WS_CLIENT_CLOSING);
+            if (client->state != WS_CLIENT_FREE) { continue; }
+
+            // The queue is empty: closeClient() drained it before it released
+            // the slot, and nothing is queued for a slot that is not active
+            client->connection = connection;
+            client->subscription = subscription;
+            client->sentFrames = 0;
+            client->droppedFrames = 0;
+            client->failedFrames = 0;
+            client->busyCycles = 0;
+            client->failures = 0;
+            client->lastBusyCycles = 0;
+            client->lastLostFrames = 0;
+
+            // Frames are queued for the client from here on
+            QUEUE_BARRIER();
+            client->state = WS_CLIENT_ACTIVE;
+            Task_restore(key);
+            return client;
+        }
+        Task_restore(key);
+
+        if (!closing || (waited_ms >= WS_CLIENT_RELEASE_WAIT_MS)) { return NULL; }
+
+        // Clock ticks are 1 ms (Clock.tickPeriod in empty_min.cfg)
+        Task_sleep(1);
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Stops queueing frames for an active client, if there is one, and wakes its
+//! client task, which releases the slot. Called by the tasks that do not own
+//! the slot.
+//
+//*****************************************************************************
+static void removeClient(uint8_t transport, uint16_t connection)
+{
+    ws_client *client = NULL;
+    UInt key;
+    uint16_t n;
+
+    // Matched and marked with task switching off, so the slot cannot change hands in between
+    key = Task_disable();
+    for (n = 0; (client == NULL) && (n < WS_MAX_CLIENTS); n++)
+    {
+        if ((clients[n].state == WS_CLIENT_ACTIVE) && (clients[n].transport == transport) &&
+            (clients[n].connection == connection))
+        {
+            client = &clients[n];
+            client->state = WS_CLIENT_CLOSING;
+        }
+    }
+    Task_restore(key);
+
+    if (client != NULL) { Semaphore_post(client->frameReady); }
+}
+
+
+
+//*****************************************************************************
+//
+//! Releases the slot of a closing client. Client task side.
+//!
+//! Nothing is queued for a closing client, so the frames still in its queue
+//! and TCP buffer are the last ones; they are released without being sent.
+//! A TCP connection is closed as well.
+//
+//*****************************************************************************
+static void closeClient(ws_client *client)
+{
+    static const char *const transportNames[] = { "Websocket", "TCP", "UDP" };
+    ws_frame *frame;
+
+    while (client->tail != client->head)
+    {
+        QUEUE_BARRIER();
+        frame = client->queue[QUEUE_INDEX(client->tail)];
+        client->tail++;
+        countUndelivered(frame->batch.conversions);
+        releaseFrame(frame);
+    }
+
+    if (client->tcpLength > 0)
+    {
+        client->failedFrames += client->tcpFrames;
+        countUndelivered(client->tcpConversions);
+        client->tcpLength = 0;
+        client->tcpFrames = 0;
+        client->tcpConversions = 0;
+    }
+
+    if (client->transport == WS_TRANSPORT_TCP)
+    {
+        tcpStreamClose((int16_t) client->connection);
+    }
+
+    LOG_PRINT("%s client %u removed: %u frames sent, %u lost\r\n", transportNames[client->transport],
+              client->connection, client->sentFrames, client->droppedFrames + client->failedFrames);
+
+    // The slot may be taken again once everything above is done
+    QUEUE_BARRIER();
+    client->state = WS_CLIENT_FREE;
+}
+
+
+
+//*****************************************************************************
+//
+//! Sends a frame to a client, and removes the client once too many sends in
+//! a row have failed.
+//
+//*****************************************************************************
+static void sendFrame(ws_client *client, ws_frame *frame)
+{
+    struct HttpBlob payload;
+    uint32_t start;
+    bool sent;
+
+    if (client->transport == WS_TRANSPORT_TCP)
+    {
+        bufferTcpFrame(client, frame);
+        return;
+    }
+    if (client->transport == WS_TRANSPORT_UDP)
+    {
+        sendDatagram(client, frame);
+        return;
+    }
+
+    payload.pData = (UINT8 *) frame->batch.buffer;
+    payload.uLength = frame->batch.length;
+
+    // Time spent blocked in the send measures how close the link is to its capacity
+    start = CYCLE_COUNT();
+    sent = sl_WebSocketSend(client->connection, payload, frame->opcode);
+    if (frame->batch.conversions != 0)
+    {
+        client->busyCycles += CYCLE_COUNT() - start;
+    }
+
+    if (sent)
+    {
+        client->sentFrames++;
+        client->failures = 0;
+        return;
+    }
+
+    client->failedFrames++;
+    countUndelivered(frame->batch.conversions);
+    if (++client->failures >= WS_CLIENT_MAX_FAILURES)
+    {
+        client->state = WS_CLIENT_CLOSING;
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Copies a frame into the send buffer of a TCP client, sending the buffer
+//! first if the frame does not fit and afterwards once it is full. Text lines
+//! are terminated with '\n'.
+//
+//*****************************************************************************
+static void bufferTcpFrame(ws_client *client, ws_frame *frame)
+{
+    uint16_t sendBytes = tcpStreamGetSendBytes();
+    uint16_t length = frame->batch.length;
+
+    if ((client->tcpLength + length + 1u) > TCP_STREAM_MAX_SEND_BYTES)
+    {
+        sendTcpBuffer(client);
+    }
+    if (client->state != WS_CLIENT_ACTIVE)
+    {
+        countUndelivered(frame->batch.conversions);
+        return;
+    }
+
+    if (client->tcpLength == 0) { client->tcpStartTime = Clock_getTicks(); }
+
+    memcpy(&client->tcpBuffer[client->tcpLength], frame->batch.buffer, length);
+    if (frame->opcode == STREAM_WS_OPCODE_TEXT)
+    {
+        client->tcpBuffer[client->tcpLength + length] = '\n';
+        length++;
+    }
+    client->tcpLength += length;
+    client->tcpFrames++;
+    client->tcpConversions += frame->batch.conversions;
+
+    if (client->tcpLength >= sendBytes)
+    {
+        sendTcpBuffer(client);
+    }
+}
+
+
+
+//*****************************************************************************
+//
+//! Sends the buffer of a TCP client, and closes and removes the client if
+//! the send fails.
+//
+//*****************************************************************************
+static void sendTcpBuffer(ws_client *client)
+{
+    uint32_t start;
+    bool sent;
+
+    if (client->tcpLength == 0) { return; }
+
+    start = CYCLE_COUNT();
+    sent = tcpStreamSend((int16_t) client->connection, client->tcpBuffer, client->tcpLength);
+    if (client->tcpConversions != 0)
+    {
+        client->busyCycles += CYCLE_COUNT() - start;
+    }
+
+    if (sent)
+    {
+        client->sentFrames += client->tcpFrames;
+    }
+    else
+    {
+        client->failedFrames += client->tcpFrames;
+        countUndelivered(client->tcpConversions);
+
+        // Unlike a websocket, a TCP connection that failed once stays failed
+        client->state = WS_CLIENT_CLOSING;
+    }
+
+    client->tcpLength = 0;
+    client->tcpFrames = 0;
+    client->tcpConversions = 0;
+}
+
+
+
+//*****************************************************************************
+//
+//! Sends a frame to the UDP client as one datagram. A failed send loses that
+//! frame only: the client stays in the table, and the receiver sees a gap in
+//! the sequence numbers.
+//
+//*****************************************************************************
+static void sendDatagram(ws_client *client, ws_frame *frame)
+{
+    uint32_t start = CYCLE_COUNT();
+    bool sent = udpStreamSend((int16_t) client->connection, frame->batch.buffer, frame->batch.length);
+
+    if (frame->batch.conversions != 0)
+    {
+        client->busyCycles += CYCLE_COUNT() - start;
+    }
+
+    if (sent)
+    {
+        client->sentFrames++;
+        return;
+    }
+
+    client->failedFrames++;
+    countUndelivered(frame->batch.conversions);
+}
+
+
+
+//*****************************************************************************
+//
+//! Drops one reference to a frame; the frame returns to the pool with the
+//! last one.
+//
+//*****************************************************************************
+static void releaseFrame(ws_frame *frame)
+{
+    // Released by the client tasks and the publisher, which run at different priorities
+    UInt key = Task_disable();
+    frame->references--;
+    Task_restore(key);
+}
+
+
+
+//*****************************************************************************
+//
+//! Counts the conversions of frames a client did not get as send failures.
+//! Only data frames carry conversions.
+//
+//*****************************************************************************
+static void countUndelivered(uint32_t conversions)
+{
+    UInt key;
+
+    if (conversions == 0) { return; }
+
+    // Counted by the client tasks and the publisher
+    key = Task_disable();
+    streamCountSendFailure(conversions);
+    Task_restore(key);
+}
@@ -0,0 +1,121 @@
+/**
+ * \brief Table of connected websocket clients and fan-out of the frames sent
+ * to them.
+ *
+ * A frame, binary batch or text line, is encoded once into a frame taken from
+ * a fixed pool and published to every client subscribed to its kind. Clients
+ * get a reference to the frame in their own queue rather than a copy, and the
+ * frame returns to the pool once the last client has sent it.
+ *
+ * Each client slot has its own task (wsClientTask()) that sends the frames of
+ * its queue. A client that cannot keep up fills its queue, and the frames
+ * published after that are dropped for that client only and counted as
+ * send failures (see streamCountSendFailure()). Neither the publisher nor the
+ * other clients wait for it.
+ *
+ * A client is added when its websocket handshake completes and subscribes to
+ * everything. It is removed after WS_CLIENT_MAX_FAILURES sends in a row fail,
+ * which is how a closed connection shows up: the HTTP server library does not
+ * say which connection was closed.
+ *
+ * Raw TCP connections (see tcp_stream.h) have client slots of their own. They
+ * get the data frames only, without websocket framing, and are closed and
+ * removed on the first failed send.
+ *
+ * The UDP stream (see udp_stream.h) has a slot as well, subscribed to data.
+ * Each frame is sent as one datagram, and a failed send loses that frame
+ * only; udpStreamStop() removes the client.
+ *
+ * Only the client task of a slot frees it. Other tasks that remove a client
+ * mark its slot closing, and the client task frees it once it is done with
+ * the old connection, so a new connection never gets the old one's frames.
+ *
+ * The client tasks time their sends of data frames, and wsClientsGetLinkStats()
+ * reports how busy the slowest client is and how many data frames were lost,
+ * which drives the adaptation of the stream to the link (streamAdaptToLink()).
+ */
+
+#ifndef WS_CLIENTS_H_
+#define WS_CLIENTS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <xdc/std.h>
+
+#include "adc_stream.h"
+
+
+//****************************************************************************
+//
+// Constants
+//
+//****************************************************************************
+
+/* Client slots of each transport, e.g. for a dashboard and a logger on
+ * websockets, a lab machine on raw TCP, and the UDP stream */
+#define WS_MAX_WEBSOCKET_CLIENTS    (2U)
+#define WS_MAX_TCP_CLIENTS          (1U)
+#define WS_MAX_UDP_CLIENTS          (1U)
+
+/* Client slots, and tasks sending to them */
+#define WS_MAX_CLIENTS              (WS_MAX_WEBSOCKET_CLIENTS + WS_MAX_TCP_CLIENTS + WS_MAX_UDP_CLIENTS)
+
+/* Frames waiting in the queue of a client; must be a power of two */
+#define WS_CLIENT_QUEUE_DEPTH       (4U)
+
+/* A client holds at most its queue plus the frame it is sending, and the
+ * publisher one batch being filled and one text line */
+#define WS_FRAME_POOL_SIZE          ((WS_MAX_CLIENTS * (WS_CLIENT_QUEUE_DEPTH + 1U)) + 2U)
+
+/* Consecutive failed sends after which a client is removed */
+#define WS_CLIENT_MAX_FAILURES      (3U)
+
+/* Subscriptions; a frame goes to the clients subscribed to its kind */
+#define WS_SUBSCRIBE_NONE           ((uint8_t) 0x00)
+#define WS_SUBSCRIBE_DATA           ((uint8_t) 0x01)    // Conversions: binary batches or CSV lines
+#define WS_SUBSCRIBE_REPORTS        ((uint8_t) 0x02)    // "loss:" and "bench:" text lines
+#define WS_SUBSCRIBE_ALL            (WS_SUBSCRIBE_DATA | WS_SUBSCRIBE_REPORTS)
+
+
+
+//****************************************************************************
+//
+// Data structures
+//
+//****************************************************************************
+
+typedef struct
+{
+    stream_batch        batch;          // Payload in batch.buffer[0, batch.length); batch.conversions
+                                        // conversions, 0 in report frames
+    uint8_t             opcode;         // STREAM_WS_OPCODE_BINARY or STREAM_WS_OPCODE_TEXT
+    volatile uint8_t    references;     // Publisher and client queues holding the frame
+} ws_frame;
+
+
+
+//****************************************************************************
+//
+// Function prototypes
+//
+//****************************************************************************
+
+void        wsClientsInit(void);
+void        wsClientOpen(uint16_t connection);
+bool        wsClientSubscribe(uint16_t connection, uint8_t subscription);
+uint16_t    wsClientCount(void);
+void        wsClientsGetLinkStats(stream_link_stats *link);
+
+bool        wsClientOpenTcp(int16_t socket);
+bool        wsClientOpenUdp(int16_t socket);
+void        wsClientCloseUdp(int16_t socket);
+
+ws_frame   *wsFrameAcquire(uint8_t opcode);
+void        wsFramePublish(ws_frame *frame, uint8_t subscription);
+bool        wsFramePublishText(const char *text, uint8_t subscription);
+
+Void        wsClientTask(UArg a0, UArg a1);
+
+
+#endif /* WS_CLIENTS_H_ */